@@ -0,0 +1,24 @@
+#Turns a SPIR-V binary into a header with a constexpr uint32_t array
+#usage: cmake -DINPUT=<file.spv> -DOUTPUT=<file.h> -DNAME=<array name> -P EmbedSpirv.cmake
+file(READ ${INPUT} SPIRV_HEX HEX)
+string(LENGTH "${SPIRV_HEX}" SPIRV_HEX_LENGTH)
+math(EXPR SPIRV_REMAINDER "${SPIRV_HEX_LENGTH} % 8")
+if(SPIRV_HEX_LENGTH EQUAL 0 OR NOT SPIRV_REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${INPUT} is not a SPIR-V binary")
+endif()
+#SPIR-V words are little endian, every 4 bytes become one word
+string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1," SPIRV_WORDS "${SPIRV_HEX}")
+string(REPEAT "0x[0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f]," 8 SPIRV_LINE)
+string(REGEX REPLACE "(${SPIRV_LINE})" "\\1\n\t" SPIRV_WORDS "${SPIRV_WORDS}")
+file(WRITE ${OUTPUT}.tmp
+"//generated from ${INPUT} by cmake/EmbedSpirv.cmake, do not edit
+#pragma once
+#include <cstdint>
+
+constexpr uint32_t ${NAME}[] = {
+\t${SPIRV_WORDS}
+};
+")
+#unchanged output keeps everything that includes it from rebuilding
+file(COPY_FILE ${OUTPUT}.tmp ${OUTPUT} ONLY_IF_DIFFERENT)
+file(REMOVE ${OUTPUT}.tmp)
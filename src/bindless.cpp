@@ -0,0 +1,146 @@
+#include "bindless.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+void BindlessDescriptors::Init(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, const Capacity& requested)
+{
+	this->device = &device;
+	auto properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+	const auto& limits = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+	capacity.sampledImages	= std::min({requested.sampledImages, limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages});
+	capacity.samplers		= std::min({requested.samplers, limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+	capacity.storageBuffers	= std::min({requested.storageBuffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+	images.capacity		= capacity.sampledImages;
+	samplers.capacity	= capacity.samplers;
+	buffers.capacity	= capacity.storageBuffers;
+
+	constexpr vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
+	std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {
+		vk::DescriptorSetLayoutBinding(IMAGE_BINDING, vk::DescriptorType::eSampledImage, capacity.sampledImages, stages),
+		vk::DescriptorSetLayoutBinding(SAMPLER_BINDING, vk::DescriptorType::eSampler, capacity.samplers, stages),
+		vk::DescriptorSetLayoutBinding(BUFFER_BINDING, vk::DescriptorType::eStorageBuffer, capacity.storageBuffers, stages)};
+	//empty slots are never read, registering a resource must not wait for frames in flight
+	constexpr vk::DescriptorBindingFlags bindingFlag = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+														vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+	std::array<vk::DescriptorBindingFlags, 3> bindingFlags = {bindingFlag, bindingFlag, bindingFlag};
+	vk::DescriptorSetLayoutBindingFlagsCreateInfo flagsInfo;
+	flagsInfo.bindingCount	= static_cast<uint32_t>(bindingFlags.size());
+	flagsInfo.pBindingFlags	= bindingFlags.data();
+	vk::DescriptorSetLayoutCreateInfo layoutInfo;
+	layoutInfo.pNext		= &flagsInfo;
+	layoutInfo.flags		= vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+	layoutInfo.bindingCount	= static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings	= bindings.data();
+	setLayout = vk::raii::DescriptorSetLayout(device, layoutInfo);
+
+	std::array<vk::DescriptorPoolSize, 3> poolSizes = {
+		vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, capacity.sampledImages),
+		vk::DescriptorPoolSize(vk::DescriptorType::eSampler, capacity.samplers),
+		vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, capacity.storageBuffers)};
+	vk::DescriptorPoolCreateInfo poolInfo;
+	poolInfo.flags			= vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet | vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+	poolInfo.maxSets		= 1;
+	poolInfo.poolSizeCount	= static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes		= poolSizes.data();
+	descriptorPool = vk::raii::DescriptorPool(device, poolInfo);
+
+	vk::DescriptorSetAllocateInfo allocInfo;
+	allocInfo.descriptorPool		= descriptorPool;
+	allocInfo.descriptorSetCount	= 1;
+	allocInfo.pSetLayouts			= &*setLayout;
+	descriptorSet = std::move(vk::raii::DescriptorSets(device, allocInfo).front());
+}
+
+uint32_t BindlessDescriptors::AllocateSlot(SlotAllocator& slots, const char* kind)
+{
+	if(!slots.freed.empty())
+	{
+		uint32_t index = slots.freed.back();
+		slots.freed.pop_back();
+		return index;
+	}
+	if(slots.next >= slots.capacity)
+		throw std::runtime_error(std::string("bindless: out of ") + kind + " slots");
+	return slots.next++;
+}
+
+void BindlessDescriptors::FreeSlot(SlotAllocator& slots, uint32_t index)
+{
+	assert(index < slots.next);
+	slots.freed.push_back(index);
+}
+
+uint32_t BindlessDescriptors::RegisterImage(vk::ImageView view, vk::ImageLayout layout)
+{
+	std::lock_guard lock(mutex);
+	uint32_t index = AllocateSlot(images, "sampled image");
+	vk::DescriptorImageInfo imageInfo(nullptr, view, layout);
+	vk::WriteDescriptorSet write;
+	write.dstSet			= descriptorSet;
+	write.dstBinding		= IMAGE_BINDING;
+	write.dstArrayElement	= index;
+	write.descriptorCount	= 1;
+	write.descriptorType	= vk::DescriptorType::eSampledImage;
+	write.pImageInfo		= &imageInfo;
+	device->updateDescriptorSets(write, {});
+	return index;
+}
+
+uint32_t BindlessDescriptors::RegisterSampler(vk::Sampler sampler)
+{
+	std::lock_guard lock(mutex);
+	uint32_t index = AllocateSlot(samplers, "sampler");
+	vk::DescriptorImageInfo imageInfo(sampler, nullptr, vk::ImageLayout::eUndefined);
+	vk::WriteDescriptorSet write;
+	write.dstSet			= descriptorSet;
+	write.dstBinding		= SAMPLER_BINDING;
+	write.dstArrayElement	= index;
+	write.descriptorCount	= 1;
+	write.descriptorType	= vk::DescriptorType::eSampler;
+	write.pImageInfo		= &imageInfo;
+	device->updateDescriptorSets(write, {});
+	return index;
+}
+
+uint32_t BindlessDescriptors::RegisterStorageBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range)
+{
+	std::lock_guard lock(mutex);
+	uint32_t index = AllocateSlot(buffers, "storage buffer");
+	vk::DescriptorBufferInfo bufferInfo(buffer, offset, range);
+	vk::WriteDescriptorSet write;
+	write.dstSet			= descriptorSet;
+	write.dstBinding		= BUFFER_BINDING;
+	write.dstArrayElement	= index;
+	write.descriptorCount	= 1;
+	write.descriptorType	= vk::DescriptorType::eStorageBuffer;
+	write.pBufferInfo		= &bufferInfo;
+	device->updateDescriptorSets(write, {});
+	return index;
+}
+
+void BindlessDescriptors::ReleaseImage(uint32_t index)
+{
+	std::lock_guard lock(mutex);
+	FreeSlot(images, index);
+}
+
+void BindlessDescriptors::ReleaseSampler(uint32_t index)
+{
+	std::lock_guard lock(mutex);
+	FreeSlot(samplers, index);
+}
+
+void BindlessDescriptors::ReleaseStorageBuffer(uint32_t index)
+{
+	std::lock_guard lock(mutex);
+	FreeSlot(buffers, index);
+}
+
+void BindlessDescriptors::Bind(const vk::raii::CommandBuffer& commandBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout layout, uint32_t setIndex) const
+{
+	commandBuffer.bindDescriptorSets(bindPoint, layout, setIndex, *descriptorSet, {});
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+//One global update-after-bind descriptor set holding every sampled image, sampler and
+//storage buffer. Shaders index the arrays with indices passed through push constants,
+//so the set is bound once per command buffer and never per draw.
+//Register*/Release* are thread safe; slots may be written while the set is in use.
+class BindlessDescriptors
+{
+	public:
+		static constexpr uint32_t INVALID_INDEX	= ~0u;
+		static constexpr uint32_t IMAGE_BINDING		= 0;
+		static constexpr uint32_t SAMPLER_BINDING	= 1;
+		static constexpr uint32_t BUFFER_BINDING	= 2;
+
+		struct Capacity
+		{
+			uint32_t	sampledImages	= 16384;
+			uint32_t	samplers		= 256;
+			uint32_t	storageBuffers	= 4096;
+		};
+		//capacities are clamped to the device's update-after-bind limits
+		void Init(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, const Capacity& capacity = {});
+		uint32_t RegisterImage(vk::ImageView view, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+		uint32_t RegisterSampler(vk::Sampler sampler);
+		uint32_t RegisterStorageBuffer(vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE);
+		//the GPU must be done with the slot, retire it through the frame timeline first
+		void ReleaseImage(uint32_t index);
+		void ReleaseSampler(uint32_t index);
+		void ReleaseStorageBuffer(uint32_t index);
+		vk::DescriptorSetLayout SetLayout() const { return *setLayout; }
+		vk::DescriptorSet Set() const { return *descriptorSet; }
+		void Bind(const vk::raii::CommandBuffer& commandBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout layout, uint32_t setIndex = 0) const;
+		const Capacity& Capacities() const { return capacity; }
+	private:
+		struct SlotAllocator
+		{
+			uint32_t				capacity = 0;
+			uint32_t				next = 0;
+			std::vector<uint32_t>	freed;
+		};
+		uint32_t AllocateSlot(SlotAllocator& slots, const char* kind);
+		void FreeSlot(SlotAllocator& slots, uint32_t index);
+
+		const vk::raii::Device*			device = nullptr;
+		Capacity						capacity;
+		vk::raii::DescriptorSetLayout	setLayout = nullptr;
+		vk::raii::DescriptorPool		descriptorPool = nullptr;
+		vk::raii::DescriptorSet			descriptorSet = nullptr;
+		std::mutex						mutex;
+		SlotAllocator					images;
+		SlotAllocator					samplers;
+		SlotAllocator					buffers;
+};
@@ -0,0 +1,115 @@
+#include "command_recorder.h"
+
+#include <algorithm>
+#include <exception>
+#include <future>
+
+#include "trace.h"
+
+void CommandRecorder::Init(const vk::raii::Device& device, uint32_t queueFamily, uint32_t frameSlots, size_t workerCount)
+{
+	this->device = &device;
+	slots.clear();
+	slots.resize(frameSlots);
+	for(auto& slot : slots)
+	{
+		slot.primary = CreatePool(queueFamily);
+		vk::CommandBufferAllocateInfo allocInfo;
+		allocInfo.commandPool			= slot.primary.pool;
+		allocInfo.level					= vk::CommandBufferLevel::ePrimary;
+		allocInfo.commandBufferCount	= 1;
+		slot.primary.buffers.push_back(std::make_unique<vk::raii::CommandBuffer>(std::move(vk::raii::CommandBuffers(device, allocInfo).front())));
+		//the calling thread records a chunk as well
+		for(size_t i = 0; i < workerCount + 1; i++)
+			slot.workers.push_back(CreatePool(queueFamily));
+	}
+	threadPool = workerCount > 0 ? std::make_unique<ThreadPool>(workerCount) : nullptr;
+}
+
+CommandRecorder::Pool CommandRecorder::CreatePool(uint32_t queueFamily) const
+{
+	//no eResetCommandBuffer, buffers are only ever reset through their pool
+	vk::CommandPoolCreateInfo poolInfo;
+	poolInfo.flags				= vk::CommandPoolCreateFlagBits::eTransient;
+	poolInfo.queueFamilyIndex	= queueFamily;
+	Pool pool;
+	pool.pool = vk::raii::CommandPool(*device, poolInfo);
+	return pool;
+}
+
+void CommandRecorder::BeginFrame(uint32_t frameSlot)
+{
+	currentSlot = frameSlot;
+	FrameSlot& slot = slots[frameSlot];
+	slot.primary.pool.reset();
+	for(auto& pool : slot.workers)
+	{
+		if(pool.used == 0)
+			continue;
+		pool.pool.reset();
+		pool.used = 0;
+	}
+}
+
+const vk::raii::CommandBuffer& CommandRecorder::NextSecondary(Pool& pool) const
+{
+	if(pool.used == pool.buffers.size())
+	{
+		vk::CommandBufferAllocateInfo allocInfo;
+		allocInfo.commandPool			= pool.pool;
+		allocInfo.level					= vk::CommandBufferLevel::eSecondary;
+		allocInfo.commandBufferCount	= 1;
+		pool.buffers.push_back(std::make_unique<vk::raii::CommandBuffer>(std::move(vk::raii::CommandBuffers(*device, allocInfo).front())));
+	}
+	return *pool.buffers[pool.used++];
+}
+
+std::vector<vk::CommandBuffer> CommandRecorder::RecordSecondaries(size_t itemCount, const vk::CommandBufferInheritanceInfo& inheritance, const RecordFunction& record)
+{
+	FrameSlot& slot = slots[currentSlot];
+	size_t chunkCount = std::clamp<size_t>(itemCount / MIN_ITEMS_PER_CHUNK, 1, slot.workers.size());
+	size_t chunkSize = (itemCount + chunkCount - 1) / chunkCount;
+	std::vector<vk::CommandBuffer> secondaries(chunkCount);
+
+	auto recordChunk = [&, this](size_t chunk){
+		TRACE_ZONE("RecordSecondary");
+		//every chunk owns one pool, so no two threads ever touch the same pool
+		const vk::raii::CommandBuffer& commandBuffer = NextSecondary(slot.workers[chunk]);
+		vk::CommandBufferBeginInfo beginInfo;
+		beginInfo.flags				= vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+		beginInfo.pInheritanceInfo	= &inheritance;
+		commandBuffer.begin(beginInfo);
+		size_t begin = chunk * chunkSize;
+		record(commandBuffer, begin, std::min(begin + chunkSize, itemCount));
+		commandBuffer.end();
+		secondaries[chunk] = *commandBuffer;
+	};
+	std::vector<std::future<void>> futures;
+	for(size_t chunk = 1; chunk < chunkCount; chunk++)
+		futures.push_back(threadPool->Submit([&recordChunk, chunk](){ recordChunk(chunk); }));
+	//the workers reference this frame's locals, wait for all of them even if a chunk failed
+	std::exception_ptr error;
+	try
+	{
+		recordChunk(0);
+	}
+	catch(...)
+	{
+		error = std::current_exception();
+	}
+	for(auto& future : futures)
+	{
+		try
+		{
+			future.get();
+		}
+		catch(...)
+		{
+			if(!error)
+				error = std::current_exception();
+		}
+	}
+	if(error)
+		std::rethrow_exception(error);
+	return secondaries;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "thread_pool.h"
+
+//Command pools per frame in flight: one for the primary buffer and one per recording thread.
+//A slot's pools are reset as a whole in BeginFrame, individual buffers are never reset.
+class CommandRecorder
+{
+	public:
+		//records items [begin, end) of the frame's draw list into a secondary buffer
+		using RecordFunction = std::function<void(const vk::raii::CommandBuffer& commandBuffer, size_t begin, size_t end)>;
+
+		void Init(const vk::raii::Device& device, uint32_t queueFamily, uint32_t frameSlots, size_t workerCount);
+		//the GPU has to be done with frameSlot
+		void BeginFrame(uint32_t frameSlot);
+		const vk::raii::CommandBuffer& Primary() const { return *slots[currentSlot].primary.buffers.front(); }
+		//splits itemCount items across the calling thread and the workers, each on its own pool;
+		//returns secondary buffers in draw list order for executeCommands
+		std::vector<vk::CommandBuffer> RecordSecondaries(size_t itemCount, const vk::CommandBufferInheritanceInfo& inheritance, const RecordFunction& record);
+		//chunks never get smaller than this, tiny draw lists are not worth a thread hop
+		static constexpr size_t MIN_ITEMS_PER_CHUNK = 256;
+		size_t ThreadCount() const { return slots.empty() ? 0 : slots.front().workers.size(); }
+	private:
+		struct Pool
+		{
+			vk::raii::CommandPool									pool = nullptr;
+			std::vector<std::unique_ptr<vk::raii::CommandBuffer>>	buffers;
+			size_t													used = 0;
+		};
+		struct FrameSlot
+		{
+			Pool				primary;
+			//index 0 belongs to the calling thread
+			std::vector<Pool>	workers;
+		};
+		Pool CreatePool(uint32_t queueFamily) const;
+		const vk::raii::CommandBuffer& NextSecondary(Pool& pool) const;
+
+		const vk::raii::Device*		device = nullptr;
+		std::vector<FrameSlot>		slots;
+		uint32_t					currentSlot = 0;
+		//declared last, joined before the pools go away
+		std::unique_ptr<ThreadPool>	threadPool;
+};
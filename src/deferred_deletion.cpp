@@ -0,0 +1,23 @@
+#include "deferred_deletion.h"
+
+DeferredDeletionQueue::~DeferredDeletionQueue()
+{
+	Flush();
+}
+
+void DeferredDeletionQueue::Collect(uint64_t completedValue)
+{
+	//reset in push order first, erase_if would destroy in whatever order it moves entries
+	for(auto& entry : entries)
+		if(entry.retireValue <= completedValue)
+			entry.object.reset();
+	std::erase_if(entries, [](const Entry& entry){ return !entry.object; });
+}
+
+void DeferredDeletionQueue::Flush()
+{
+	//destroy in push order, views before the swapchain that owns their images
+	for(auto& entry : entries)
+		entry.object.reset();
+	entries.clear();
+}
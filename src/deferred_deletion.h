@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//Keeps GPU objects alive until the timeline value of the last frame that used them has completed
+class DeferredDeletionQueue
+{
+	public:
+		DeferredDeletionQueue() = default;
+		~DeferredDeletionQueue();
+		DeferredDeletionQueue(const DeferredDeletionQueue&) = delete;
+		DeferredDeletionQueue& operator=(const DeferredDeletionQueue&) = delete;
+
+		//takes ownership, the object is destroyed once retireValue is reached
+		template<typename T>
+		void Push(uint64_t retireValue, T&& object)
+		{
+			static_assert(!std::is_lvalue_reference_v<T>, "move the object into the queue");
+			//shared_ptr<void> keeps the typed deleter
+			entries.push_back({retireValue, std::make_shared<std::decay_t<T>>(std::move(object))});
+		}
+		//destroys every entry whose value the GPU has passed
+		void Collect(uint64_t completedValue);
+		//device has to be idle
+		void Flush();
+		bool Empty() const { return entries.empty(); }
+		size_t Size() const { return entries.size(); }
+	private:
+		struct Entry
+		{
+			uint64_t				retireValue;
+			std::shared_ptr<void>	object;
+		};
+		std::vector<Entry>	entries;
+};
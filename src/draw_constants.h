@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+#include <vulkan/vulkan_raii.hpp>
+#include <glm/glm.hpp>
+
+#include "bindless.h"
+
+//matches FrameData in shader.slang
+struct FrameData
+{
+	glm::mat4	transform	= glm::mat4(1.0f);
+	glm::vec4	tint		= glm::vec4(1.0f);
+	float		time		= 0.0f;
+	//read by the GPU driven cull pass only
+	uint32_t	instanceCount	= 0;
+	float		padding[2]	= {};
+};
+
+//matches DrawConstants in shader.slang, the only per draw state
+struct DrawConstants
+{
+	vk::DeviceAddress	frameData		= 0;
+	//PackedVertex array of the mesh being drawn (ImDrawVert for the HUD), 0 for the built in triangle
+	vk::DeviceAddress	vertices		= 0;
+	uint32_t			textureIndex	= BindlessDescriptors::INVALID_INDEX;
+	uint32_t			samplerIndex	= 0;
+};
+//bounding radius of the built in triangle around its origin, its corners are at most sqrt(0.5) away
+constexpr float TRIANGLE_RADIUS = 0.7072f;
+constexpr vk::ShaderStageFlags DRAW_CONSTANT_STAGES = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
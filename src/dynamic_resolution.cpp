@@ -0,0 +1,74 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//weight of the newest GPU time in the moving average
+	constexpr double SMOOTHING = 0.2;
+	//timings arrive frames in flight late and the average needs a few more to follow a change
+	constexpr uint32_t SETTLE_FRAMES = 8;
+	//within this fraction of the budget the scale stays put
+	constexpr double DEADBAND = 0.05;
+	//largest relative scale change per step
+	constexpr float MAX_STEP = 0.1f;
+	//render sizes snap to this many pixels, tiny scale moves would only churn the viewport
+	constexpr uint32_t EXTENT_ALIGNMENT = 8;
+
+	uint32_t Scaled(uint32_t size, float scale, uint32_t limit)
+	{
+		uint32_t scaled = static_cast<uint32_t>(std::lround(size * scale / EXTENT_ALIGNMENT)) * EXTENT_ALIGNMENT;
+		return std::clamp(scaled, 1u, limit);
+	}
+}
+
+void DynamicResolution::Init(const DynamicResolutionConfig& config)
+{
+	this->config	= config;
+	scale			= IsEnabled() ? config.maxScale : 1.0f;
+	stats			= {};
+	stats.minScale	= scale;
+	stats.maxScale	= scale;
+}
+
+vk::Extent2D DynamicResolution::TargetExtent(vk::Extent2D output) const
+{
+	float maxScale = IsEnabled() ? config.maxScale : 1.0f;
+	return {static_cast<uint32_t>(std::ceil(output.width * maxScale)), static_cast<uint32_t>(std::ceil(output.height * maxScale))};
+}
+
+vk::Extent2D DynamicResolution::RenderExtent(vk::Extent2D output) const
+{
+	vk::Extent2D target = TargetExtent(output);
+	return {Scaled(output.width, scale, target.width), Scaled(output.height, scale, target.height)};
+}
+
+void DynamicResolution::AddGpuFrame(double ms)
+{
+	if(!IsEnabled())
+		return;
+	stats.frames++;
+	stats.scaleSum	+= scale;
+	smoothedMs		= smoothedMs == 0.0 ? ms : smoothedMs + SMOOTHING * (ms - smoothedMs);
+	if(++framesSinceChange < SETTLE_FRAMES || smoothedMs <= 0.0)
+		return;
+	double ratio = config.gpuBudgetMs / smoothedMs;
+	if(std::abs(ratio - 1.0) < DEADBAND)
+		return;
+	float target = std::clamp(scale * static_cast<float>(std::sqrt(ratio)), scale * (1.0f - MAX_STEP), scale * (1.0f + MAX_STEP));
+	target = std::clamp(target, config.minScale, config.maxScale);
+	if(target == scale)
+		return;
+	scale				= target;
+	framesSinceChange	= 0;
+	stats.changes++;
+	stats.minScale		= std::min(stats.minScale, scale);
+	stats.maxScale		= std::max(stats.maxScale, scale);
+}
+
+void DynamicResolution::PrintStats(std::ostream& out) const
+{
+	out << "dynamic resolution: scale avg " << (stats.frames > 0 ? stats.scaleSum / stats.frames : scale) << ", range " << stats.minScale
+		<< " - " << stats.maxScale << ", " << stats.changes << " changes over " << stats.frames << " frames (budget " << config.gpuBudgetMs << " ms)" << std::endl;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+
+#include <vulkan/vulkan_raii.hpp>
+
+struct DynamicResolutionConfig
+{
+	//GPU time the scene may take per frame, 0 = always render at the output size
+	double	gpuBudgetMs	= 0.0;
+	//render scale bounds per axis, above 1 supersamples
+	float	minScale	= 0.5f;
+	float	maxScale	= 1.0f;
+};
+
+struct DynamicResolutionStats
+{
+	uint64_t	frames		= 0;
+	uint64_t	changes		= 0;
+	double		scaleSum	= 0.0;
+	float		minScale	= 0.0f;
+	float		maxScale	= 0.0f;
+};
+
+//Picks the scene's render scale from measured GPU time. GPU time is taken to grow with the
+//pixel count, so the scale moves by the square root of budget over smoothed time, in bounded
+//steps and only once the previous change has reached the measurements. The scene target is
+//sized for the maximum scale once, each frame renders into a sub-region of it.
+class DynamicResolution
+{
+	public:
+		void Init(const DynamicResolutionConfig& config);
+		bool IsEnabled() const { return config.gpuBudgetMs > 0.0; }
+		float Scale() const { return scale; }
+		//size of the scene targets for this output, fixed while the output keeps its size
+		vk::Extent2D TargetExtent(vk::Extent2D output) const;
+		//this frame's render size, within TargetExtent
+		vk::Extent2D RenderExtent(vk::Extent2D output) const;
+		//GPU time of one frame's scene passes, in frame order
+		void AddGpuFrame(double ms);
+		const DynamicResolutionStats& Stats() const { return stats; }
+		void PrintStats(std::ostream& out) const;
+	private:
+		DynamicResolutionConfig	config;
+		float					scale = 1.0f;
+		double					smoothedMs = 0.0;
+		uint32_t				framesSinceChange = 0;
+		DynamicResolutionStats	stats;
+};
@@ -0,0 +1,220 @@
+#include "frame_capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "trace.h"
+
+namespace
+{
+	constexpr uint32_t BYTES_PER_PIXEL = 4;
+	//zlib level for the PNGs, the default 8 is several times slower for a few percent smaller files
+	constexpr int PNG_COMPRESSION_LEVEL = 1;
+
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+void FrameCapture::Init(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, GpuAllocator& allocator,
+						vk::Format format, uint32_t framesInFlight, const FrameCaptureConfig& config)
+{
+	this->device		= &device;
+	this->allocator		= &allocator;
+	this->config		= config;
+	nonCoherentAtomSize	= physicalDevice.getProperties().limits.nonCoherentAtomSize;
+	switch(format)
+	{
+		case vk::Format::eB8G8R8A8Srgb:
+		case vk::Format::eB8G8R8A8Unorm:
+			swizzle = true;
+			break;
+		case vk::Format::eR8G8B8A8Srgb:
+		case vk::Format::eR8G8B8A8Unorm:
+			swizzle = false;
+			break;
+		default:
+			throw std::runtime_error("capture: unsupported color format " + vk::to_string(format));
+	}
+	size_t threads = 1;
+	if(config.format == CaptureFormat::Raw)
+	{
+		rawFile.open(config.path, std::ios::binary | std::ios::trunc);
+		if(!rawFile.is_open())
+			throw std::runtime_error("capture: failed to open " + config.path);
+	}
+	else
+	{
+		threads = config.encodeThreads != 0 ? config.encodeThreads : ThreadPool::DefaultThreadCount();
+		stbi_write_png_compression_level = PNG_COMPRESSION_LEVEL;
+	}
+	//every frame in flight plus one buffer per encoder, one more so a frame never waits on the GPU
+	slots = std::vector<Slot>(framesInFlight + threads + 1);
+	//one writer keeps raw frames in order
+	pool = std::make_unique<ThreadPool>(threads);
+}
+
+uint32_t FrameCapture::Acquire(vk::Extent2D extent, uint64_t frameNumber)
+{
+	TRACE_ZONE("FrameCapture::Acquire");
+	std::unique_lock lock(mutex);
+	auto free = [this](){ return std::ranges::find(slots, SlotState::Free, &Slot::state); };
+	auto slot = free();
+	if(slot == slots.end())
+	{
+		if(config.dropWhenBusy)
+		{
+			stats.dropped++;
+			return NO_SLOT;
+		}
+		//the encoders fall behind, the frame waits for them rather than the GPU
+		auto start = std::chrono::steady_clock::now();
+		slotFreed.wait(lock, [&](){ slot = free(); return slot != slots.end(); });
+		stats.waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	vk::DeviceSize size = AlignUp(vk::DeviceSize(extent.width) * extent.height * BYTES_PER_PIXEL, nonCoherentAtomSize);
+	//free means neither the GPU nor an encoder uses it, a resize can replace it right away
+	if(slot->capacity < size)
+	{
+		vk::BufferCreateInfo bufferInfo;
+		bufferInfo.size			= size;
+		bufferInfo.usage		= vk::BufferUsageFlagBits::eTransferDst;
+		bufferInfo.sharingMode	= vk::SharingMode::eExclusive;
+		//cached memory, the encoders read every byte
+		slot->buffer	= allocator->CreateBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eHostVisible, vk::MemoryPropertyFlagBits::eHostCached);
+		slot->capacity	= size;
+		slot->coherent	= static_cast<bool>(allocator->MemoryProperties().memoryTypes[slot->buffer.Allocation().memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent);
+	}
+	slot->extent		= extent;
+	slot->frameNumber	= frameNumber;
+	slot->frameValue	= 0;
+	slot->state			= SlotState::Pending;
+	stats.captured++;
+	return static_cast<uint32_t>(slot - slots.begin());
+}
+
+BufferRange FrameCapture::Target(uint32_t slot) const
+{
+	const Slot& target = slots[slot];
+	return {*target.buffer, 0, vk::DeviceSize(target.extent.width) * target.extent.height * BYTES_PER_PIXEL};
+}
+
+void FrameCapture::RecordCopy(const vk::raii::CommandBuffer& commandBuffer, uint32_t slot, vk::Image image) const
+{
+	const Slot& target = slots[slot];
+	vk::BufferImageCopy region;
+	region.imageSubresource	= vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+	region.imageExtent		= vk::Extent3D{target.extent.width, target.extent.height, 1};
+	commandBuffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, *target.buffer, region);
+}
+
+void FrameCapture::Submitted(uint32_t slot, uint64_t frameValue)
+{
+	std::lock_guard lock(mutex);
+	slots[slot].frameValue = frameValue;
+}
+
+void FrameCapture::Collect(uint64_t completedValue)
+{
+	std::vector<Slot*> completed;
+	{
+		std::lock_guard lock(mutex);
+		for(Slot& slot : slots)
+		{
+			if(slot.state == SlotState::Pending && slot.frameValue != 0 && slot.frameValue <= completedValue)
+			{
+				slot.state = SlotState::Encoding;
+				completed.push_back(&slot);
+			}
+		}
+	}
+	//in frame order, the raw writer relies on it
+	std::ranges::sort(completed, {}, &Slot::frameValue);
+	for(Slot* slot : completed)
+	{
+		if(!slot->coherent)
+		{
+			vk::MappedMemoryRange range;
+			range.memory	= slot->buffer.Allocation().memory;
+			range.offset	= slot->buffer.Allocation().offset;
+			range.size		= slot->capacity;
+			device->invalidateMappedMemoryRanges(range);
+		}
+		pool->Submit([this, slot](){ Encode(*slot); });
+	}
+}
+
+void FrameCapture::Finish(uint64_t completedValue)
+{
+	Collect(completedValue);
+	std::unique_lock lock(mutex);
+	slotFreed.wait(lock, [this](){ return std::ranges::none_of(slots, [](const Slot& slot){ return slot.state == SlotState::Encoding; }); });
+	if(rawFile.is_open())
+		rawFile.flush();
+}
+
+void FrameCapture::Encode(Slot& slot)
+{
+	TRACE_ZONE("FrameCapture::Encode");
+	auto start = std::chrono::steady_clock::now();
+	//opaque RGBA8 whatever the target's channel order and alpha
+	thread_local std::vector<uint8_t> pixels;
+	size_t pixelCount = size_t(slot.extent.width) * slot.extent.height;
+	pixels.resize(pixelCount * BYTES_PER_PIXEL);
+	const auto* source = static_cast<const uint8_t*>(slot.buffer.Mapped());
+	size_t red	= swizzle ? 2 : 0;
+	size_t blue	= swizzle ? 0 : 2;
+	for(size_t i = 0; i < pixelCount; i++)
+	{
+		const uint8_t* in = source + i * BYTES_PER_PIXEL;
+		uint8_t* out = pixels.data() + i * BYTES_PER_PIXEL;
+		out[0] = in[red];
+		out[1] = in[1];
+		out[2] = in[blue];
+		out[3] = 0xff;
+	}
+	bool ok;
+	if(config.format == CaptureFormat::Raw)
+	{
+		rawFile.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+		ok = rawFile.good();
+	}
+	else
+	{
+		char suffix[32];
+		std::snprintf(suffix, sizeof(suffix), "_%06llu.png", static_cast<unsigned long long>(slot.frameNumber));
+		std::string path = config.path + suffix;
+		ok = stbi_write_png(path.c_str(), static_cast<int>(slot.extent.width), static_cast<int>(slot.extent.height), BYTES_PER_PIXEL,
+							pixels.data(), static_cast<int>(slot.extent.width * BYTES_PER_PIXEL)) != 0;
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	{
+		std::lock_guard lock(mutex);
+		(ok ? stats.written : stats.failed)++;
+		stats.encodeMs		+= ms;
+		stats.maxEncodeMs	= std::max(stats.maxEncodeMs, ms);
+		slot.state			= SlotState::Free;
+	}
+	slotFreed.notify_all();
+}
+
+FrameCaptureStats FrameCapture::Stats() const
+{
+	std::lock_guard lock(mutex);
+	return stats;
+}
+
+void FrameCapture::PrintStats(std::ostream& out) const
+{
+	FrameCaptureStats s = Stats();
+	uint64_t encoded = s.written + s.failed;
+	out << "capture: " << s.written << "/" << s.captured << " frames written, " << s.failed << " failed, " << s.dropped << " dropped, "
+		<< s.waitMs << " ms waiting for encoders, encode avg " << (encoded > 0 ? s.encodeMs / encoded : 0.0)
+		<< " ms, max " << s.maxEncodeMs << " ms (" << slots.size() << " buffers, " << pool->Size() << " workers)" << std::endl;
+}
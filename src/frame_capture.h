@@ -0,0 +1,103 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "gpu_allocator.h"
+#include "render_graph.h"
+#include "thread_pool.h"
+
+enum class CaptureFormat : uint8_t
+{
+	//one <path>_<frame>.png per frame
+	Png,
+	//RGBA8 frames back to back into one file or named pipe, e.g. for ffmpeg -f rawvideo
+	Raw
+};
+
+struct FrameCaptureConfig
+{
+	CaptureFormat	format			= CaptureFormat::Png;
+	std::string		path;
+	//PNG encode workers, 0 = half of the hardware threads; raw output always uses one writer
+	size_t			encodeThreads	= 0;
+	//skip frames while every readback buffer is busy instead of waiting for the encoders
+	bool			dropWhenBusy	= false;
+};
+
+struct FrameCaptureStats
+{
+	uint64_t	captured	= 0;
+	uint64_t	dropped		= 0;
+	uint64_t	written		= 0;
+	uint64_t	failed		= 0;
+	//render thread time spent waiting for a free readback buffer
+	double		waitMs		= 0.0;
+	double		encodeMs	= 0.0;
+	double		maxEncodeMs	= 0.0;
+};
+
+//Copies rendered frames into a ring of host visible readback buffers. A buffer is only read
+//once the timeline value of the frame that filled it has completed, then the encode workers
+//convert and write it and hand it back; the GPU is never waited on for a capture.
+class FrameCapture
+{
+	public:
+		static constexpr uint32_t NO_SLOT = ~0u;
+
+		//format is the color target's, 8 bit RGBA or BGRA
+		void Init(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, GpuAllocator& allocator,
+					vk::Format format, uint32_t framesInFlight, const FrameCaptureConfig& config);
+		bool IsEnabled() const { return pool != nullptr; }
+		//render thread: a readback buffer for this frame, NO_SLOT when the frame is skipped
+		uint32_t Acquire(vk::Extent2D extent, uint64_t frameNumber);
+		BufferRange Target(uint32_t slot) const;
+		//in a pass using the image as TransferSrc and Target(slot) as TransferDst
+		void RecordCopy(const vk::raii::CommandBuffer& commandBuffer, uint32_t slot, vk::Image image) const;
+		void Submitted(uint32_t slot, uint64_t frameValue);
+		//render thread: hands every buffer whose frame has completed to the encoders
+		void Collect(uint64_t completedValue);
+		//GPU idle: collects everything and waits for the encoders
+		void Finish(uint64_t completedValue);
+		FrameCaptureStats Stats() const;
+		void PrintStats(std::ostream& out) const;
+	private:
+		enum class SlotState : uint8_t
+		{
+			Free,
+			Pending,
+			Encoding
+		};
+		struct Slot
+		{
+			GpuBuffer		buffer;
+			vk::DeviceSize	capacity = 0;
+			bool			coherent = true;
+			vk::Extent2D	extent;
+			uint64_t		frameNumber = 0;
+			uint64_t		frameValue = 0;
+			SlotState		state = SlotState::Free;
+		};
+		void Encode(Slot& slot);
+
+		const vk::raii::Device*		device = nullptr;
+		GpuAllocator*				allocator = nullptr;
+		FrameCaptureConfig			config;
+		vk::DeviceSize				nonCoherentAtomSize = 1;
+		bool						swizzle = false;
+		std::vector<Slot>			slots;
+		//slot states and stats, the workers set buffers back to Free
+		mutable std::mutex			mutex;
+		std::condition_variable		slotFreed;
+		FrameCaptureStats			stats;
+		std::ofstream				rawFile;
+		//declared last: finishes the queued writes before the slots they read go away
+		std::unique_ptr<ThreadPool>	pool;
+};
@@ -0,0 +1,141 @@
+#include "frame_pacing.h"
+
+#include <algorithm>
+
+#include "trace.h"
+
+namespace
+{
+	//sleep_until overshoots by up to a scheduler tick, the last stretch is spun
+	constexpr auto SPIN_MARGIN = std::chrono::microseconds(1500);
+	//bounded waits let Retire and shutdown take the waiter off a swapchain, and keep acquire and
+	//present from queueing behind the waiter for long
+	constexpr uint64_t PRESENT_WAIT_SLICE_NS = 1'000'000;
+}
+
+void FrameLimiter::SetRate(uint32_t fps)
+{
+	period	= fps == 0 ? Clock::duration::zero() : std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+	next	= {};
+}
+
+void FrameLimiter::Wait()
+{
+	if(!IsEnabled())
+		return;
+	TRACE_ZONE("FrameLimiter::Wait");
+	auto now = Clock::now();
+	if(next > now)
+	{
+		if(next - now > SPIN_MARGIN)
+			std::this_thread::sleep_until(next - SPIN_MARGIN);
+		while(Clock::now() < next)
+			std::this_thread::yield();
+		sleptMs += std::chrono::duration<double, std::milli>(Clock::now() - now).count();
+	}
+	//more than a frame behind: start over rather than catch up with a burst of frames
+	else if(now - next > period)
+		next = now;
+	next += period;
+}
+
+PresentLatency::~PresentLatency()
+{
+	if(!waiter.joinable())
+		return;
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+	waiter.join();
+}
+
+void PresentLatency::Start(const vk::raii::Device& device)
+{
+	this->device = &device;
+	waiter = std::thread([this](){ Run(); });
+}
+
+void PresentLatency::Presented(vk::SwapchainKHR swapChain, uint64_t id, uint64_t inputNs)
+{
+	{
+		std::lock_guard lock(mutex);
+		pending.push_back({swapChain, id, inputNs});
+	}
+	changed.notify_all();
+}
+
+std::unique_lock<std::mutex> PresentLatency::LockSwapChain()
+{
+	if(!IsEnabled())
+		return {};
+	return std::unique_lock(swapChainMutex);
+}
+
+void PresentLatency::Retire(vk::SwapchainKHR swapChain)
+{
+	std::unique_lock lock(mutex);
+	stats.dropped += std::erase_if(pending, [swapChain](const Pending& present){ return present.swapChain == swapChain; });
+	changed.wait(lock, [&](){ return waiting != swapChain; });
+}
+
+void PresentLatency::Run()
+{
+	TRACE_THREAD_NAME("present wait");
+	auto const& dispatcher = *device->getDispatcher();
+	std::unique_lock lock(mutex);
+	while(true)
+	{
+		changed.wait(lock, [this](){ return stopping || !pending.empty(); });
+		if(stopping)
+			return;
+		Pending present = pending.front();
+		waiting = present.swapChain;
+		lock.unlock();
+		VkResult result;
+		uint64_t shownNs;
+		{
+			std::lock_guard swapChainLock(swapChainMutex);
+			result = dispatcher.vkWaitForPresentKHR(static_cast<VkDevice>(**device), static_cast<VkSwapchainKHR>(present.swapChain),
+													present.id, PRESENT_WAIT_SLICE_NS);
+			shownNs = Tracer::Now();
+		}
+		//a render thread blocked on the swapchain gets it before the next slice
+		if(result == VK_TIMEOUT)
+			std::this_thread::yield();
+		lock.lock();
+		waiting = nullptr;
+		//Retire may have dropped it meanwhile
+		bool current = !pending.empty() && pending.front().swapChain == present.swapChain && pending.front().id == present.id;
+		if(result == VK_SUCCESS && current)
+		{
+			double ms = static_cast<double>(shownNs - present.inputNs) / 1e6;
+			stats.frames++;
+			stats.totalMs	+= ms;
+			stats.maxMs		= std::max(stats.maxMs, ms);
+			stats.lastMs	= ms;
+			pending.pop_front();
+		}
+		//out of date or surface lost, the present never shows
+		else if(result != VK_TIMEOUT && current)
+		{
+			stats.dropped++;
+			pending.pop_front();
+		}
+		changed.notify_all();
+	}
+}
+
+PresentLatencyStats PresentLatency::Stats() const
+{
+	std::lock_guard lock(mutex);
+	return stats;
+}
+
+void PresentLatency::PrintStats(std::ostream& out) const
+{
+	PresentLatencyStats s = Stats();
+	out << "latency: input to display avg " << (s.frames > 0 ? s.totalMs / s.frames : 0.0) << " ms, max " << s.maxMs
+		<< " ms over " << s.frames << " presents, " << s.dropped << " not measured" << std::endl;
+}
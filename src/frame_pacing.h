@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#include <vulkan/vulkan_raii.hpp>
+
+//Caps the render loop at a fixed rate on the CPU. Wait is called right before input is
+//sampled, so a capped frame sleeps with nothing in hand instead of blocking later in a
+//GPU or present wait on input that keeps getting older.
+class FrameLimiter
+{
+	public:
+		using Clock = std::chrono::steady_clock;
+		//0 = unlimited
+		void SetRate(uint32_t fps);
+		bool IsEnabled() const { return period != Clock::duration::zero(); }
+		//sleeps until the next frame is due
+		void Wait();
+		double SleptMs() const { return sleptMs; }
+	private:
+		Clock::duration		period = Clock::duration::zero();
+		Clock::time_point	next;
+		double				sleptMs = 0.0;
+};
+
+struct PresentLatencyStats
+{
+	uint64_t	frames	= 0;
+	//presents the wait gave up on, the swapchain was retired or lost first
+	uint64_t	dropped	= 0;
+	double		totalMs	= 0.0;
+	double		maxMs	= 0.0;
+	double		lastMs	= 0.0;
+};
+
+//Input to display latency through VK_KHR_present_id and VK_KHR_present_wait. Every present
+//carries an id and the time its input was sampled; a waiter thread blocks on the ids in order
+//and takes the time at which each one reached the screen. The swapchain must be externally
+//synchronized, so the render thread holds LockSwapChain around acquire and present and the
+//waiter only blocks on it in short slices.
+class PresentLatency
+{
+	public:
+		~PresentLatency();
+		//the device has present id and present wait enabled
+		void Start(const vk::raii::Device& device);
+		bool IsEnabled() const { return device != nullptr; }
+		//render thread: id of the next present on swapChain
+		uint64_t NextId(){ return ++presentId; }
+		//render thread, after presentKHR accepted the present; inputNs on the Tracer::Now() clock
+		void Presented(vk::SwapchainKHR swapChain, uint64_t id, uint64_t inputNs);
+		//render thread: held around acquireNextImage and presentKHR, empty when not enabled
+		std::unique_lock<std::mutex> LockSwapChain();
+		//render thread, before swapChain is replaced: drops its pending presents and returns
+		//once the waiter no longer uses it
+		void Retire(vk::SwapchainKHR swapChain);
+		PresentLatencyStats Stats() const;
+		void PrintStats(std::ostream& out) const;
+	private:
+		struct Pending
+		{
+			vk::SwapchainKHR	swapChain;
+			uint64_t			id = 0;
+			uint64_t			inputNs = 0;
+		};
+		void Run();
+
+		const vk::raii::Device*		device = nullptr;
+		uint64_t					presentId = 0;
+		mutable std::mutex			mutex;
+		//every use of the swapchain, the waiter's vkWaitForPresentKHR included
+		std::mutex					swapChainMutex;
+		std::condition_variable		changed;
+		std::deque<Pending>			pending;
+		//swapchain the waiter is blocked on, null between waits
+		vk::SwapchainKHR			waiting;
+		bool						stopping = false;
+		PresentLatencyStats			stats;
+		std::thread					waiter;
+};
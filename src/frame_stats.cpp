@@ -0,0 +1,171 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <stdexcept>
+
+const char* ToString(FramePhase phase)
+{
+	switch(phase)
+	{
+		case FramePhase::Wait:		return "wait";
+		case FramePhase::Pace:		return "pace";
+		case FramePhase::Acquire:	return "acquire";
+		case FramePhase::Record:	return "record";
+		case FramePhase::Submit:	return "submit";
+		case FramePhase::Present:	return "present";
+		default:					return "unknown";
+	}
+}
+
+const char* ToString(StartupPhase phase)
+{
+	switch(phase)
+	{
+		case StartupPhase::Window:			return "window";
+		case StartupPhase::Instance:		return "instance";
+		case StartupPhase::DeviceSelection:	return "deviceSelection";
+		case StartupPhase::DeviceCreation:	return "deviceCreation";
+		case StartupPhase::Resources:		return "resources";
+		case StartupPhase::Swapchain:		return "swapchain";
+		case StartupPhase::Pipeline:		return "pipeline";
+		case StartupPhase::Scene:			return "scene";
+		case StartupPhase::CommandsAndSync:	return "commandsAndSync";
+		case StartupPhase::PipelineWait:	return "pipelineWait";
+		default:							return "unknown";
+	}
+}
+
+void StartupTimings::Print(std::ostream& out) const
+{
+	out << "startup: " << std::fixed << std::setprecision(2) << totalMs << " ms (";
+	for(size_t i = 0; i < STARTUP_PHASE_COUNT; i++)
+		out << (i > 0 ? ", " : "") << ToString(static_cast<StartupPhase>(i)) << " " << phaseMs[i];
+	out << ")" << std::defaultfloat << std::endl;
+}
+
+Percentiles Percentiles::From(std::vector<double> samples)
+{
+	Percentiles result;
+	if(samples.empty())
+		return result;
+	std::ranges::sort(samples);
+	auto rank = [&samples](double p){
+		size_t index = static_cast<size_t>(std::ceil(p * static_cast<double>(samples.size())));
+		return samples[std::clamp<size_t>(index, 1, samples.size()) - 1];
+	};
+	result.count	= samples.size();
+	result.mean		= std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+	result.p50		= rank(0.50);
+	result.p95		= rank(0.95);
+	result.p99		= rank(0.99);
+	result.max		= samples.back();
+	return result;
+}
+
+void FrameStats::Reserve(size_t frames)
+{
+	for(auto& phase : phaseMs)
+		phase.reserve(frames);
+	cpuMs.reserve(frames);
+	frameMs.reserve(frames);
+	gpuMs.reserve(frames);
+}
+
+void FrameStats::AddFrame(const FrameTimings& timings)
+{
+	for(size_t i = 0; i < FRAME_PHASE_COUNT; i++)
+		phaseMs[i].push_back(timings.phaseMs[i]);
+	cpuMs.push_back(timings.cpuMs);
+	if(timings.frameMs > 0.0)
+		frameMs.push_back(timings.frameMs);
+}
+
+namespace
+{
+	void PrintRow(std::ostream& out, const char* name, const Percentiles& p)
+	{
+		out << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(10) << p.p50
+			<< std::setw(10) << p.p95
+			<< std::setw(10) << p.p99
+			<< std::setw(10) << p.max
+			<< std::setw(10) << p.mean
+			<< std::setw(8) << p.count << "\n";
+	}
+
+	void WriteObject(std::ostream& out, const char* name, const Percentiles& p, bool last)
+	{
+		out << "    \"" << name << "\": {"
+			<< "\"count\": " << p.count
+			<< ", \"mean\": " << p.mean
+			<< ", \"p50\": " << p.p50
+			<< ", \"p95\": " << p.p95
+			<< ", \"p99\": " << p.p99
+			<< ", \"max\": " << p.max
+			<< (last ? "}\n" : "},\n");
+	}
+
+	std::string Escape(const std::string& text)
+	{
+		std::string result;
+		for(char c : text)
+		{
+			if(c == '"' || c == '\\')
+				result += '\\';
+			if(static_cast<unsigned char>(c) >= 0x20)
+				result += c;
+		}
+		return result;
+	}
+}
+
+void FrameStats::Print(std::ostream& out) const
+{
+	out << "benchmark: " << FrameCount() << " frames (ms)\n";
+	out << std::left << std::setw(10) << "" << std::right
+		<< std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99"
+		<< std::setw(10) << "max" << std::setw(10) << "mean" << std::setw(8) << "n" << "\n";
+	PrintRow(out, "frame", Percentiles::From(frameMs));
+	PrintRow(out, "cpu", Percentiles::From(cpuMs));
+	for(size_t i = 0; i < FRAME_PHASE_COUNT; i++)
+		PrintRow(out, ToString(static_cast<FramePhase>(i)), Percentiles::From(phaseMs[i]));
+	if(!gpuMs.empty())
+		PrintRow(out, "gpu", Percentiles::From(gpuMs));
+	out << std::defaultfloat << std::flush;
+}
+
+void FrameStats::WriteJson(const std::string& path, const BenchmarkInfo& info) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	if(!file.is_open())
+		throw std::runtime_error("failed to open benchmark report: " + path);
+	file << std::setprecision(6) << std::fixed;
+	file << "{\n";
+	file << "  \"device\": \"" << Escape(info.deviceName) << "\",\n";
+	file << "  \"width\": " << info.width << ",\n";
+	file << "  \"height\": " << info.height << ",\n";
+	file << "  \"headless\": " << (info.headless ? "true" : "false") << ",\n";
+	file << "  \"warmupFrames\": " << info.warmupFrames << ",\n";
+	file << "  \"presentMode\": \"" << Escape(info.presentMode) << "\",\n";
+	file << "  \"fpsLimit\": " << info.fpsLimit << ",\n";
+	file << "  \"frames\": " << FrameCount() << ",\n";
+	file << "  \"unit\": \"ms\",\n";
+	file << "  \"startup\": {\"total\": " << info.startup.totalMs;
+	for(size_t i = 0; i < STARTUP_PHASE_COUNT; i++)
+		file << ", \"" << ToString(static_cast<StartupPhase>(i)) << "\": " << info.startup.phaseMs[i];
+	file << "},\n";
+	file << "  \"metrics\": {\n";
+	WriteObject(file, "frame", Percentiles::From(frameMs), false);
+	WriteObject(file, "cpu", Percentiles::From(cpuMs), false);
+	for(size_t i = 0; i < FRAME_PHASE_COUNT; i++)
+		WriteObject(file, ToString(static_cast<FramePhase>(i)), Percentiles::From(phaseMs[i]), false);
+	WriteObject(file, "gpu", Percentiles::From(gpuMs), true);
+	file << "  }\n";
+	file << "}\n";
+	if(!file)
+		throw std::runtime_error("failed to write benchmark report: " + path);
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//CPU steps of DrawFrame, in submission order
+enum class FramePhase : uint32_t
+{
+	Wait,
+	//frame limiter sleep and input sampling
+	Pace,
+	Acquire,
+	Record,
+	Submit,
+	Present,
+	Count
+};
+constexpr size_t FRAME_PHASE_COUNT = static_cast<size_t>(FramePhase::Count);
+const char* ToString(FramePhase phase);
+
+struct FrameTimings
+{
+	std::array<double, FRAME_PHASE_COUNT> phaseMs{};
+	//sum of the phases
+	double cpuMs	= 0.0;
+	//begin of the previous frame to begin of this one, 0 for the first frame
+	double frameMs	= 0.0;
+};
+
+//Lap based stopwatch, one Lap per FramePhase
+class FrameTimer
+{
+	public:
+		using Clock = std::chrono::steady_clock;
+		void Begin()
+		{
+			auto now = Clock::now();
+			timings = {};
+			if(hasPrevious)
+				timings.frameMs = Milliseconds(now - frameBegin);
+			hasPrevious = true;
+			frameBegin	= now;
+			lap			= now;
+		}
+		void Lap(FramePhase phase)
+		{
+			auto now = Clock::now();
+			double ms = Milliseconds(now - lap);
+			timings.phaseMs[static_cast<size_t>(phase)] += ms;
+			timings.cpuMs += ms;
+			lap = now;
+		}
+		const FrameTimings& Timings() const { return timings; }
+	private:
+		static double Milliseconds(Clock::duration d){ return std::chrono::duration<double, std::milli>(d).count(); }
+		FrameTimings		timings;
+		Clock::time_point	frameBegin;
+		Clock::time_point	lap;
+		bool				hasPrevious = false;
+};
+
+//InitVulkan steps; Pipeline runs on a worker next to the ones after it
+enum class StartupPhase : uint32_t
+{
+	Window,
+	Instance,
+	DeviceSelection,
+	DeviceCreation,
+	Resources,
+	Swapchain,
+	Pipeline,
+	Scene,
+	CommandsAndSync,
+	//main thread blocked on the pipeline worker
+	PipelineWait,
+	Count
+};
+constexpr size_t STARTUP_PHASE_COUNT = static_cast<size_t>(StartupPhase::Count);
+const char* ToString(StartupPhase phase);
+
+struct StartupTimings
+{
+	std::array<double, STARTUP_PHASE_COUNT> phaseMs{};
+	//wall clock from Begin to the last Lap, less than the phase sum when work overlapped
+	double totalMs = 0.0;
+	void Print(std::ostream& out) const;
+};
+
+//Lap based like FrameTimer; phases timed on other threads are added with Add
+class StartupTimer
+{
+	public:
+		using Clock = std::chrono::steady_clock;
+		void Begin()
+		{
+			begin	= Clock::now();
+			lap		= begin;
+		}
+		void Lap(StartupPhase phase)
+		{
+			auto now = Clock::now();
+			timings.phaseMs[static_cast<size_t>(phase)] += std::chrono::duration<double, std::milli>(now - lap).count();
+			timings.totalMs = std::chrono::duration<double, std::milli>(now - begin).count();
+			lap = now;
+		}
+		void Add(StartupPhase phase, double ms){ timings.phaseMs[static_cast<size_t>(phase)] += ms; }
+		const StartupTimings& Timings() const { return timings; }
+	private:
+		StartupTimings		timings;
+		Clock::time_point	begin;
+		Clock::time_point	lap;
+};
+
+struct Percentiles
+{
+	size_t count	= 0;
+	double mean		= 0.0;
+	double p50		= 0.0;
+	double p95		= 0.0;
+	double p99		= 0.0;
+	double max		= 0.0;
+	//nearest rank percentiles, samples is sorted in place
+	static Percentiles From(std::vector<double> samples);
+};
+
+//Run description written next to the numbers in the JSON report
+struct BenchmarkInfo
+{
+	std::string deviceName;
+	uint32_t	width		= 0;
+	uint32_t	height		= 0;
+	bool		headless	= false;
+	uint32_t	warmupFrames = 0;
+	//the swapchain's present mode, "offscreen" headless
+	std::string	presentMode;
+	//0 = unlimited
+	uint32_t	fpsLimit	= 0;
+	StartupTimings	startup;
+};
+
+class FrameStats
+{
+	public:
+		void Reserve(size_t frames);
+		void AddFrame(const FrameTimings& timings);
+		void AddGpuFrame(double ms){ gpuMs.push_back(ms); }
+		size_t FrameCount() const { return cpuMs.size(); }
+		void Print(std::ostream& out) const;
+		//throws std::runtime_error if the report can not be written
+		void WriteJson(const std::string& path, const BenchmarkInfo& info) const;
+	private:
+		std::array<std::vector<double>, FRAME_PHASE_COUNT> phaseMs;
+		std::vector<double> cpuMs;
+		std::vector<double> frameMs;
+		std::vector<double> gpuMs;
+};
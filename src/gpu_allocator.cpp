@@ -0,0 +1,411 @@
+#include "gpu_allocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <iomanip>
+#include <stdexcept>
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+//BuddyAllocator
+BuddyAllocator::BuddyAllocator(uint64_t capacity, uint64_t minBlockSize) : capacity(capacity)
+{
+	assert(std::has_single_bit(capacity) && std::has_single_bit(minBlockSize) && minBlockSize <= capacity);
+	levelCount = static_cast<uint32_t>(std::countr_zero(capacity) - std::countr_zero(minBlockSize)) + 1;
+	freeLists.resize(levelCount);
+	freeLists[0].insert(0);
+}
+
+uint64_t BuddyAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	uint64_t need = std::bit_ceil(std::max({size, alignment, BlockSize(levelCount - 1)}));
+	if(need > capacity)
+		return INVALID;
+	uint32_t level = static_cast<uint32_t>(std::countr_zero(capacity) - std::countr_zero(need));
+	//smallest free block that is big enough
+	int32_t source = static_cast<int32_t>(level);
+	while(source >= 0 && freeLists[source].empty())
+		source--;
+	if(source < 0)
+		return INVALID;
+	uint64_t offset = *freeLists[source].begin();
+	freeLists[source].erase(freeLists[source].begin());
+	//split down, the upper halves become free buddies
+	for(uint32_t split = static_cast<uint32_t>(source) + 1; split <= level; split++)
+		freeLists[split].insert(offset + BlockSize(split));
+	allocated.emplace(offset, level);
+	usedBytes += BlockSize(level);
+	return offset;
+}
+
+void BuddyAllocator::Free(uint64_t offset)
+{
+	auto it = allocated.find(offset);
+	assert(it != allocated.end() && "freeing an offset that was not allocated");
+	if(it == allocated.end())
+		return;
+	uint32_t level = it->second;
+	allocated.erase(it);
+	usedBytes -= BlockSize(level);
+	//merge with free buddies as far up as possible
+	while(level > 0)
+	{
+		uint64_t buddy = offset ^ BlockSize(level);
+		auto buddyIt = freeLists[level].find(buddy);
+		if(buddyIt == freeLists[level].end())
+			break;
+		freeLists[level].erase(buddyIt);
+		offset = std::min(offset, buddy);
+		level--;
+	}
+	freeLists[level].insert(offset);
+}
+
+uint64_t BuddyAllocator::LargestFreeBlock() const
+{
+	for(uint32_t level = 0; level < levelCount; level++)
+		if(!freeLists[level].empty())
+			return BlockSize(level);
+	return 0;
+}
+
+//LinearAllocator
+LinearAllocator::LinearAllocator(uint64_t capacity, uint64_t granularity) : capacity(capacity), granularity(std::max<uint64_t>(granularity, 1))
+{
+}
+
+uint64_t LinearAllocator::Allocate(uint64_t size, uint64_t alignment, ResourceTiling tiling)
+{
+	uint64_t start = AlignUp(offset, alignment);
+	//a linear and an optimal resource must not share a granularity page
+	if(!empty && tiling != lastTiling)
+		start = AlignUp(start, granularity);
+	if(start + size > capacity)
+		return INVALID;
+	offset		= start + size;
+	lastTiling	= tiling;
+	empty		= false;
+	return start;
+}
+
+void LinearAllocator::Reset()
+{
+	offset	= 0;
+	empty	= true;
+}
+
+//GpuMemoryBlock
+struct GpuMemoryBlock
+{
+	vk::raii::DeviceMemory				memory = nullptr;
+	uint32_t							memoryType = 0;
+	vk::DeviceSize						size = 0;
+	void*								mapped = nullptr;
+	ResourceTiling						tiling = ResourceTiling::Linear;
+	uint32_t							frameSlot = 0;
+	//exactly one of buddy/linear is set, neither for dedicated blocks
+	std::unique_ptr<BuddyAllocator>		buddy;
+	std::unique_ptr<LinearAllocator>	linear;
+};
+
+//GpuBuffer
+GpuBuffer::GpuBuffer(GpuAllocator& allocator, vk::raii::Buffer&& buffer, const GpuAllocation& allocation)
+	: allocator(&allocator), buffer(std::move(buffer)), allocation(allocation)
+{
+}
+
+GpuBuffer::GpuBuffer(GpuBuffer&& other) noexcept
+	: allocator(std::exchange(other.allocator, nullptr)), buffer(std::move(other.buffer)), allocation(std::exchange(other.allocation, {}))
+{
+}
+
+GpuBuffer& GpuBuffer::operator=(GpuBuffer&& other) noexcept
+{
+	if(this != &other)
+	{
+		Release();
+		allocator	= std::exchange(other.allocator, nullptr);
+		buffer		= std::move(other.buffer);
+		allocation	= std::exchange(other.allocation, {});
+	}
+	return *this;
+}
+
+void GpuBuffer::Release()
+{
+	//the buffer goes before the memory it is bound to
+	buffer = nullptr;
+	if(allocator != nullptr && allocation)
+		allocator->Free(allocation);
+	allocator = nullptr;
+}
+
+//GpuImage
+GpuImage::GpuImage(GpuAllocator& allocator, vk::raii::Image&& image, const GpuAllocation& allocation)
+	: allocator(&allocator), image(std::move(image)), allocation(allocation)
+{
+}
+
+GpuImage::GpuImage(GpuImage&& other) noexcept
+	: allocator(std::exchange(other.allocator, nullptr)), image(std::move(other.image)), allocation(std::exchange(other.allocation, {}))
+{
+}
+
+GpuImage& GpuImage::operator=(GpuImage&& other) noexcept
+{
+	if(this != &other)
+	{
+		Release();
+		allocator	= std::exchange(other.allocator, nullptr);
+		image		= std::move(other.image);
+		allocation	= std::exchange(other.allocation, {});
+	}
+	return *this;
+}
+
+void GpuImage::Release()
+{
+	image = nullptr;
+	if(allocator != nullptr && allocation)
+		allocator->Free(allocation);
+	allocator = nullptr;
+}
+
+//GpuAllocator
+GpuAllocator::GpuAllocator() = default;
+GpuAllocator::~GpuAllocator() = default;
+
+void GpuAllocator::Init(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, const GpuAllocatorConfig& config)
+{
+	this->device			= &device;
+	this->config			= config;
+	memoryProperties		= physicalDevice.getMemoryProperties();
+	auto limits				= physicalDevice.getProperties().limits;
+	bufferImageGranularity	= limits.bufferImageGranularity;
+	maxAllocationCount		= limits.maxMemoryAllocationCount;
+}
+
+uint32_t GpuAllocator::FindMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred) const
+{
+	for(vk::MemoryPropertyFlags wanted : {required | preferred, required})
+	{
+		for(uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & wanted) == wanted)
+				return i;
+		}
+	}
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+GpuMemoryBlock& GpuAllocator::CreateBlock(uint32_t memoryType, vk::DeviceSize size)
+{
+	if(blocks.size() >= maxAllocationCount)
+		throw std::runtime_error("gpu allocator: maxMemoryAllocationCount reached");
+	vk::MemoryAllocateInfo allocInfo;
+	allocInfo.allocationSize	= size;
+	allocInfo.memoryTypeIndex	= memoryType;
+	vk::MemoryAllocateFlagsInfo flagsInfo;
+	flagsInfo.flags = vk::MemoryAllocateFlagBits::eDeviceAddress;
+	if(config.deviceAddress)
+		allocInfo.pNext = &flagsInfo;
+	auto block			= std::make_unique<GpuMemoryBlock>();
+	block->memory		= vk::raii::DeviceMemory(*device, allocInfo);
+	block->memoryType	= memoryType;
+	block->size			= size;
+	//host visible blocks stay mapped for their whole lifetime
+	if(memoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+		block->mapped = block->memory.mapMemory(0, VK_WHOLE_SIZE);
+	blocks.push_back(std::move(block));
+	return *blocks.back();
+}
+
+GpuAllocation GpuAllocator::Allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred,
+									 ResourceTiling tiling, AllocationLifetime lifetime)
+{
+	uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, required, preferred);
+	std::lock_guard lock(mutex);
+	//transients of any size come from their frame slot, a dedicated block would live as long as
+	//the resource instead of going back with BeginFrame
+	if(lifetime == AllocationLifetime::Transient)
+		return AllocateTransient(requirements, memoryType, tiling);
+	if(requirements.size > config.dedicatedThreshold)
+		return AllocateDedicated(requirements, memoryType);
+	return AllocatePersistent(requirements, memoryType, tiling);
+}
+
+GpuAllocation GpuAllocator::AllocatePersistent(const vk::MemoryRequirements& requirements, uint32_t memoryType, ResourceTiling tiling)
+{
+	//with a granularity of 1 linear and optimal resources may share blocks
+	bool separateTiling = bufferImageGranularity > 1;
+	auto fill = [&](GpuMemoryBlock& block, uint64_t offset){
+		GpuAllocation allocation;
+		allocation.memory		= *block.memory;
+		allocation.offset		= offset;
+		allocation.size			= requirements.size;
+		allocation.mapped		= block.mapped != nullptr ? static_cast<uint8_t*>(block.mapped) + offset : nullptr;
+		allocation.memoryType	= memoryType;
+		allocation.block		= &block;
+		return allocation;
+	};
+	for(auto& block : blocks)
+	{
+		if(!block->buddy || block->memoryType != memoryType || (separateTiling && block->tiling != tiling))
+			continue;
+		uint64_t offset = block->buddy->Allocate(requirements.size, requirements.alignment);
+		if(offset != BuddyAllocator::INVALID)
+			return fill(*block, offset);
+	}
+	//small heaps get proportionally smaller blocks
+	vk::DeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+	vk::DeviceSize blockSize = std::bit_floor(std::min(config.blockSize, std::max<vk::DeviceSize>(heapSize / 8, config.minBuddySize)));
+	if(requirements.size > blockSize)
+		return AllocateDedicated(requirements, memoryType);
+	GpuMemoryBlock& block	= CreateBlock(memoryType, blockSize);
+	block.tiling			= tiling;
+	block.buddy				= std::make_unique<BuddyAllocator>(blockSize, std::bit_ceil(config.minBuddySize));
+	uint64_t offset			= block.buddy->Allocate(requirements.size, requirements.alignment);
+	assert(offset != BuddyAllocator::INVALID);
+	return fill(block, offset);
+}
+
+GpuAllocation GpuAllocator::AllocateTransient(const vk::MemoryRequirements& requirements, uint32_t memoryType, ResourceTiling tiling)
+{
+	auto fill = [&](GpuMemoryBlock& block, uint64_t offset){
+		GpuAllocation allocation;
+		allocation.memory		= *block.memory;
+		allocation.offset		= offset;
+		allocation.size			= requirements.size;
+		allocation.mapped		= block.mapped != nullptr ? static_cast<uint8_t*>(block.mapped) + offset : nullptr;
+		allocation.memoryType	= memoryType;
+		allocation.block		= &block;
+		return allocation;
+	};
+	for(auto& block : blocks)
+	{
+		if(!block->linear || block->memoryType != memoryType || block->frameSlot != currentFrameSlot)
+			continue;
+		uint64_t offset = block->linear->Allocate(requirements.size, requirements.alignment, tiling);
+		if(offset != LinearAllocator::INVALID)
+			return fill(*block, offset);
+	}
+	vk::DeviceSize blockSize	= std::max(config.transientBlockSize, AlignUp(requirements.size, requirements.alignment));
+	GpuMemoryBlock& block		= CreateBlock(memoryType, blockSize);
+	block.frameSlot				= currentFrameSlot;
+	block.linear				= std::make_unique<LinearAllocator>(blockSize, bufferImageGranularity);
+	uint64_t offset				= block.linear->Allocate(requirements.size, requirements.alignment, tiling);
+	assert(offset != LinearAllocator::INVALID);
+	return fill(block, offset);
+}
+
+GpuAllocation GpuAllocator::AllocateDedicated(const vk::MemoryRequirements& requirements, uint32_t memoryType)
+{
+	GpuMemoryBlock& block = CreateBlock(memoryType, requirements.size);
+	GpuAllocation allocation;
+	allocation.memory		= *block.memory;
+	allocation.offset		= 0;
+	allocation.size			= requirements.size;
+	allocation.mapped		= block.mapped;
+	allocation.memoryType	= memoryType;
+	allocation.block		= &block;
+	return allocation;
+}
+
+void GpuAllocator::Free(GpuAllocation& allocation)
+{
+	if(!allocation)
+		return;
+	std::lock_guard lock(mutex);
+	GpuMemoryBlock* block	= allocation.block;
+	uint64_t offset			= allocation.offset;
+	allocation = {};
+	//transient memory comes back with BeginFrame
+	if(block->linear)
+		return;
+	if(!block->buddy)
+	{
+		ReleaseBlock(block);
+		return;
+	}
+	block->buddy->Free(offset);
+	if(block->buddy->AllocationCount() > 0)
+		return;
+	//keep one empty block per memory type around to avoid allocation churn
+	bool hasSpare = std::ranges::any_of(blocks, [block](const auto& other){
+		return other.get() != block && other->buddy && other->memoryType == block->memoryType && other->tiling == block->tiling;
+	});
+	if(hasSpare)
+		ReleaseBlock(block);
+}
+
+void GpuAllocator::ReleaseBlock(GpuMemoryBlock* block)
+{
+	auto it = std::ranges::find_if(blocks, [block](const auto& other){ return other.get() == block; });
+	assert(it != blocks.end());
+	blocks.erase(it);
+}
+
+void GpuAllocator::BeginFrame(uint32_t frameSlot)
+{
+	std::lock_guard lock(mutex);
+	currentFrameSlot = frameSlot;
+	for(auto& block : blocks)
+		if(block->linear && block->frameSlot == frameSlot)
+			block->linear->Reset();
+}
+
+GpuAllocatorStats GpuAllocator::Stats() const
+{
+	std::lock_guard lock(mutex);
+	GpuAllocatorStats stats;
+	stats.deviceMemoryCount = static_cast<uint32_t>(blocks.size());
+	//free bytes outside the largest free block of their own block
+	uint64_t scatteredBytes = 0;
+	for(const auto& block : blocks)
+	{
+		if(block->buddy)
+		{
+			stats.blockCount++;
+			stats.blockBytes		+= block->size;
+			stats.usedBytes			+= block->buddy->UsedBytes();
+			stats.freeBytes			+= block->buddy->FreeBytes();
+			stats.allocationCount	+= static_cast<uint32_t>(block->buddy->AllocationCount());
+			stats.largestFreeBlock	= std::max(stats.largestFreeBlock, block->buddy->LargestFreeBlock());
+			scatteredBytes			+= block->buddy->FreeBytes() - block->buddy->LargestFreeBlock();
+		}
+		else if(block->linear)
+		{
+			stats.transientCapacity		+= block->linear->Capacity();
+			stats.transientUsedBytes	+= block->linear->UsedBytes();
+		}
+		else
+		{
+			stats.dedicatedCount++;
+			stats.dedicatedBytes += block->size;
+			stats.allocationCount++;
+		}
+	}
+	if(stats.freeBytes > 0)
+		stats.fragmentation = static_cast<double>(scatteredBytes) / static_cast<double>(stats.freeBytes);
+	return stats;
+}
+
+void GpuAllocator::PrintStats(std::ostream& out) const
+{
+	GpuAllocatorStats stats = Stats();
+	constexpr double MB = 1024.0 * 1024.0;
+	out << std::fixed << std::setprecision(2)
+		<< "gpu memory: " << stats.deviceMemoryCount << " device allocations, " << stats.allocationCount << " resources\n"
+		<< "  blocks:    " << stats.blockCount << " (" << stats.blockBytes / MB << " MB, " << stats.usedBytes / MB << " MB used, fragmentation "
+		<< stats.fragmentation * 100.0 << "%)\n"
+		<< "  dedicated: " << stats.dedicatedCount << " (" << stats.dedicatedBytes / MB << " MB)\n"
+		<< "  transient: " << stats.transientUsedBytes / MB << " / " << stats.transientCapacity / MB << " MB" << std::endl;
+	out << std::defaultfloat;
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+//Linear resources (buffers, linear images) and optimal images must not share a
+//bufferImageGranularity page, the allocators keep them apart by tiling
+enum class ResourceTiling : uint8_t
+{
+	Linear,
+	Optimal
+};
+
+enum class AllocationLifetime : uint8_t
+{
+	//buddy sub-allocated, freed individually
+	Persistent,
+	//bump allocated from the current frame slot, released all at once by BeginFrame
+	Transient
+};
+
+//Power-of-two buddy allocator over [0, capacity)
+class BuddyAllocator
+{
+	public:
+		static constexpr uint64_t INVALID = ~0ull;
+		BuddyAllocator(uint64_t capacity, uint64_t minBlockSize);
+		//blocks are aligned to their own size, so any power-of-two alignment up to the block size holds
+		uint64_t Allocate(uint64_t size, uint64_t alignment);
+		void Free(uint64_t offset);
+		uint64_t Capacity() const { return capacity; }
+		uint64_t UsedBytes() const { return usedBytes; }
+		uint64_t FreeBytes() const { return capacity - usedBytes; }
+		uint64_t LargestFreeBlock() const;
+		size_t AllocationCount() const { return allocated.size(); }
+	private:
+		uint64_t BlockSize(uint32_t level) const { return capacity >> level; }
+
+		uint64_t								capacity;
+		uint32_t								levelCount;
+		uint64_t								usedBytes = 0;
+		//level 0 is the whole range, one ordered free list per level
+		std::vector<std::set<uint64_t>>			freeLists;
+		std::unordered_map<uint64_t, uint32_t>	allocated;
+};
+
+//Bump allocator for per-frame data, only Reset gives memory back
+class LinearAllocator
+{
+	public:
+		static constexpr uint64_t INVALID = ~0ull;
+		LinearAllocator(uint64_t capacity, uint64_t granularity);
+		uint64_t Allocate(uint64_t size, uint64_t alignment, ResourceTiling tiling);
+		void Reset();
+		uint64_t Capacity() const { return capacity; }
+		uint64_t UsedBytes() const { return offset; }
+	private:
+		uint64_t		capacity;
+		uint64_t		granularity;
+		uint64_t		offset = 0;
+		ResourceTiling	lastTiling = ResourceTiling::Linear;
+		bool			empty = true;
+};
+
+struct GpuMemoryBlock;
+
+struct GpuAllocation
+{
+	vk::DeviceMemory	memory;
+	vk::DeviceSize		offset		= 0;
+	vk::DeviceSize		size		= 0;
+	//persistently mapped pointer for host visible memory
+	void*				mapped		= nullptr;
+	uint32_t			memoryType	= 0;
+	GpuMemoryBlock*		block		= nullptr;
+	explicit operator bool() const { return block != nullptr; }
+};
+
+struct GpuAllocatorConfig
+{
+	vk::DeviceSize	blockSize			= 64ull << 20;
+	vk::DeviceSize	transientBlockSize	= 16ull << 20;
+	vk::DeviceSize	minBuddySize		= 256;
+	//persistent requests larger than this get their own vkAllocateMemory
+	vk::DeviceSize	dedicatedThreshold	= 32ull << 20;
+	//every block is allocated with eDeviceAddress so buffers can use eShaderDeviceAddress
+	bool			deviceAddress		= false;
+};
+
+struct GpuAllocatorStats
+{
+	uint32_t	deviceMemoryCount	= 0;
+	uint32_t	blockCount			= 0;
+	uint32_t	dedicatedCount		= 0;
+	uint32_t	allocationCount		= 0;
+	uint64_t	blockBytes			= 0;
+	uint64_t	usedBytes			= 0;
+	uint64_t	freeBytes			= 0;
+	uint64_t	largestFreeBlock	= 0;
+	uint64_t	dedicatedBytes		= 0;
+	uint64_t	transientCapacity	= 0;
+	uint64_t	transientUsedBytes	= 0;
+	//share of the free bytes outside the largest free block of their buddy block, 0 = not
+	//fragmented; per block, so a spare empty block does not count as fragmentation
+	double		fragmentation		= 0.0;
+};
+
+class GpuAllocator;
+
+//vk::raii::Buffer together with the memory it is bound to
+class GpuBuffer
+{
+	public:
+		GpuBuffer() = default;
+		GpuBuffer(std::nullptr_t){}
+		GpuBuffer(GpuAllocator& allocator, vk::raii::Buffer&& buffer, const GpuAllocation& allocation);
+		GpuBuffer(GpuBuffer&& other) noexcept;
+		GpuBuffer& operator=(GpuBuffer&& other) noexcept;
+		~GpuBuffer(){ Release(); }
+		vk::Buffer operator*() const { return *buffer; }
+		const GpuAllocation& Allocation() const { return allocation; }
+		void* Mapped() const { return allocation.mapped; }
+		void Release();
+	private:
+		GpuAllocator*		allocator = nullptr;
+		vk::raii::Buffer	buffer = nullptr;
+		GpuAllocation		allocation;
+};
+
+//vk::raii::Image together with the memory it is bound to
+class GpuImage
+{
+	public:
+		GpuImage() = default;
+		GpuImage(std::nullptr_t){}
+		GpuImage(GpuAllocator& allocator, vk::raii::Image&& image, const GpuAllocation& allocation);
+		GpuImage(GpuImage&& other) noexcept;
+		GpuImage& operator=(GpuImage&& other) noexcept;
+		~GpuImage(){ Release(); }
+		vk::Image operator*() const { return *image; }
+		const GpuAllocation& Allocation() const { return allocation; }
+		void Release();
+	private:
+		GpuAllocator*		allocator = nullptr;
+		vk::raii::Image		image = nullptr;
+		GpuAllocation		allocation;
+};
+
+//Sub-allocates buffer and image memory from large per memory type blocks.
+//Persistent resources come from buddy blocks, transient ones from per frame slot linear blocks.
+class GpuAllocator
+{
+	public:
+		GpuAllocator();
+		~GpuAllocator();
+		void Init(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, const GpuAllocatorConfig& config = {});
+		//memory types with required | preferred are tried first, then required only
+		GpuAllocation Allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred,
+								ResourceTiling tiling, AllocationLifetime lifetime = AllocationLifetime::Persistent);
+		void Free(GpuAllocation& allocation);
+		GpuBuffer CreateBuffer(const vk::BufferCreateInfo& createInfo, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {},
+								AllocationLifetime lifetime = AllocationLifetime::Persistent);
+		GpuImage CreateImage(const vk::ImageCreateInfo& createInfo, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {},
+								AllocationLifetime lifetime = AllocationLifetime::Persistent);
+		//releases every transient allocation of frameSlot, the GPU must be done with them
+		void BeginFrame(uint32_t frameSlot);
+		GpuAllocatorStats Stats() const;
+		void PrintStats(std::ostream& out) const;
+		const vk::PhysicalDeviceMemoryProperties& MemoryProperties() const { return memoryProperties; }
+	private:
+		uint32_t FindMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred) const;
+		GpuMemoryBlock& CreateBlock(uint32_t memoryType, vk::DeviceSize size);
+		GpuAllocation AllocatePersistent(const vk::MemoryRequirements& requirements, uint32_t memoryType, ResourceTiling tiling);
+		GpuAllocation AllocateTransient(const vk::MemoryRequirements& requirements, uint32_t memoryType, ResourceTiling tiling);
+		GpuAllocation AllocateDedicated(const vk::MemoryRequirements& requirements, uint32_t memoryType);
+		void ReleaseBlock(GpuMemoryBlock* block);
+
+		const vk::raii::Device*							device = nullptr;
+		GpuAllocatorConfig								config;
+		vk::PhysicalDeviceMemoryProperties				memoryProperties;
+		vk::DeviceSize									bufferImageGranularity = 1;
+		uint32_t										maxAllocationCount = 0;
+		uint32_t										currentFrameSlot = 0;
+		mutable std::mutex								mutex;
+		std::vector<std::unique_ptr<GpuMemoryBlock>>	blocks;
+};
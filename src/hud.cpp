@@ -0,0 +1,260 @@
+#include "hud.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <imgui.h>
+
+#include "draw_constants.h"
+
+namespace
+{
+	constexpr float HUD_WIDTH = 260.0f;
+	//graphs are scaled to two 60 Hz frames
+	constexpr float GRAPH_MAX_MS = 33.3f;
+
+	float Mebibytes(vk::DeviceSize bytes)
+	{
+		return static_cast<float>(static_cast<double>(bytes) / (1024.0 * 1024.0));
+	}
+}
+
+Hud::Texture::~Texture()
+{
+	if(slot != BindlessDescriptors::INVALID_INDEX)
+		bindless->ReleaseImage(slot);
+}
+
+void Hud::Init(const vk::raii::Device& device, GpuAllocator& allocator, TransferUploader& uploader, BindlessDescriptors& bindless,
+				DeferredDeletionQueue& deletionQueue, bool visible)
+{
+	this->device		= &device;
+	this->allocator		= &allocator;
+	this->uploader		= &uploader;
+	this->bindless		= &bindless;
+	this->deletionQueue	= &deletionQueue;
+	this->visible		= visible;
+	context = ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	//display only: no settings file, no input
+	io.IniFilename	= nullptr;
+	io.LogFilename	= nullptr;
+	io.BackendRendererName = "vulkan_renderer_hud";
+	//atlas pages come and go through ImDrawData::Textures, draws use their vertex offset
+	io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures | ImGuiBackendFlags_RendererHasVtxOffset;
+	ImGui::StyleColorsDark();
+
+	vk::SamplerCreateInfo samplerInfo;
+	samplerInfo.magFilter		= vk::Filter::eLinear;
+	samplerInfo.minFilter		= vk::Filter::eLinear;
+	samplerInfo.mipmapMode		= vk::SamplerMipmapMode::eLinear;
+	samplerInfo.addressModeU	= vk::SamplerAddressMode::eClampToEdge;
+	samplerInfo.addressModeV	= vk::SamplerAddressMode::eClampToEdge;
+	samplerInfo.addressModeW	= vk::SamplerAddressMode::eClampToEdge;
+	sampler		= vk::raii::Sampler(device, samplerInfo);
+	samplerSlot	= bindless.RegisterSampler(*sampler);
+	lastBuild	= std::chrono::steady_clock::now();
+}
+
+Hud::~Hud()
+{
+	if(context == nullptr)
+		return;
+	//the GPU is idle by now, pages still alive go away right here
+	for(ImTextureData* texture : ImGui::GetPlatformIO().Textures)
+	{
+		delete static_cast<Texture*>(texture->BackendUserData);
+		texture->BackendUserData = nullptr;
+		texture->SetTexID(ImTextureID_Invalid);
+		texture->SetStatus(ImTextureStatus_Destroyed);
+	}
+	ImGui::DestroyContext(context);
+}
+
+void Hud::AddFrame(const FrameTimings& timings)
+{
+	lastFrame = timings;
+	frameMs[frameHead]	= static_cast<float>(timings.frameMs);
+	cpuMs[frameHead]	= static_cast<float>(timings.cpuMs);
+	frameHead = (frameHead + 1) % HISTORY_FRAMES;
+}
+
+void Hud::AddGpuFrame(double ms)
+{
+	gpuMs[gpuHead] = static_cast<float>(ms);
+	gpuHead = (gpuHead + 1) % HISTORY_FRAMES;
+}
+
+void Hud::BuildFrame(const HudStatus& status, vk::Extent2D extent, uint64_t retireValue)
+{
+	drawData = nullptr;
+	if(!visible || extent.width == 0 || extent.height == 0)
+		return;
+	auto now = std::chrono::steady_clock::now();
+	ImGuiIO& io		= ImGui::GetIO();
+	io.DisplaySize	= ImVec2(static_cast<float>(extent.width), static_cast<float>(extent.height));
+	io.DeltaTime	= std::max(std::chrono::duration<float>(now - lastBuild).count(), 1e-4f);
+	lastBuild		= now;
+	ImGui::NewFrame();
+	DrawWindow(status);
+	ImGui::Render();
+	drawData = ImGui::GetDrawData();
+
+	drawable = true;
+	if(drawData->Textures != nullptr)
+	{
+		for(ImTextureData* texture : *drawData->Textures)
+		{
+			if(texture->Status != ImTextureStatus_OK)
+				UpdateTexture(*texture, retireValue);
+			//pages are few, a frame waits for all of them rather than tracking which ones it uses
+			auto* page = static_cast<Texture*>(texture->BackendUserData);
+			if(page != nullptr && !uploader->IsAvailable(page->ticket))
+				drawable = false;
+		}
+	}
+}
+
+void Hud::DrawWindow(const HudStatus& status)
+{
+	ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f));
+	ImGui::SetNextWindowBgAlpha(0.65f);
+	ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings |
+							 ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoInputs;
+	ImGui::Begin("hud", nullptr, flags);
+	size_t newest = (frameHead + HISTORY_FRAMES - 1) % HISTORY_FRAMES;
+	float lastMs = frameMs[newest];
+	ImGui::Text("%.2f ms  %.0f fps", lastMs, lastMs > 0.0f ? 1000.0f / lastMs : 0.0f);
+	ImGui::PlotLines("frame", frameMs.data(), static_cast<int>(HISTORY_FRAMES), static_cast<int>(frameHead), nullptr, 0.0f, GRAPH_MAX_MS, ImVec2(HUD_WIDTH, 40.0f));
+	ImGui::PlotLines("cpu", cpuMs.data(), static_cast<int>(HISTORY_FRAMES), static_cast<int>(frameHead), nullptr, 0.0f, GRAPH_MAX_MS, ImVec2(HUD_WIDTH, 40.0f));
+	char gpuLabel[32];
+	std::snprintf(gpuLabel, sizeof(gpuLabel), "%.2f ms", gpuMs[(gpuHead + HISTORY_FRAMES - 1) % HISTORY_FRAMES]);
+	ImGui::PlotLines("gpu", gpuMs.data(), static_cast<int>(HISTORY_FRAMES), static_cast<int>(gpuHead), gpuLabel, 0.0f, GRAPH_MAX_MS, ImVec2(HUD_WIDTH, 40.0f));
+	for(size_t i = 0; i < FRAME_PHASE_COUNT; i++)
+		ImGui::Text("%-8s %7.3f ms", ToString(static_cast<FramePhase>(i)), lastFrame.phaseMs[i]);
+	ImGui::Separator();
+	ImGui::Text("present: %s, %u images, frames in flight: %u", status.presentMode, status.swapChainImages, status.framesInFlight);
+	if(status.fpsLimit != 0)
+		ImGui::Text("fps limit: %u", status.fpsLimit);
+	if(status.latencyMs >= 0.0)
+		ImGui::Text("input to display: %.2f ms", status.latencyMs);
+	if(status.renderScale > 0.0f)
+		ImGui::Text("render scale: %.2f (%ux%u)", status.renderScale, status.renderExtent.width, status.renderExtent.height);
+	if(status.sceneNodes != 0)
+		ImGui::Text("draws: %u visible of %u", status.visibleNodes, status.sceneNodes);
+	for(size_t i = 0; i < status.heaps.size(); i++)
+	{
+		const HudHeapBudget& heap = status.heaps[i];
+		if(heap.budget == 0)
+			continue;
+		char label[64];
+		std::snprintf(label, sizeof(label), "heap %zu%s: %.0f / %.0f MiB", i, heap.deviceLocal ? " (device)" : "", Mebibytes(heap.usage), Mebibytes(heap.budget));
+		ImGui::ProgressBar(static_cast<float>(static_cast<double>(heap.usage) / static_cast<double>(heap.budget)), ImVec2(HUD_WIDTH, 0.0f), label);
+	}
+	ImGui::Text("allocator: %.1f / %.1f MiB in %u blocks", Mebibytes(status.allocator.usedBytes), Mebibytes(status.allocator.blockBytes), status.allocator.blockCount);
+	ImGui::End();
+}
+
+void Hud::UpdateTexture(ImTextureData& texture, uint64_t retireValue)
+{
+	auto* current = static_cast<Texture*>(texture.BackendUserData);
+	if(texture.Status == ImTextureStatus_WantDestroy)
+	{
+		//in flight frames may still sample it
+		if(current != nullptr)
+			deletionQueue->Push(retireValue, std::unique_ptr<Texture>(current));
+		texture.BackendUserData = nullptr;
+		texture.SetTexID(ImTextureID_Invalid);
+		texture.SetStatus(ImTextureStatus_Destroyed);
+		return;
+	}
+	if(texture.Format != ImTextureFormat_RGBA32)
+		throw std::runtime_error("hud: unsupported atlas format");
+	//creation and updates both upload a whole new page, atlas changes only happen when new glyphs show up
+	vk::ImageCreateInfo imageInfo;
+	imageInfo.imageType		= vk::ImageType::e2D;
+	imageInfo.format		= vk::Format::eR8G8B8A8Unorm;
+	imageInfo.extent		= vk::Extent3D{static_cast<uint32_t>(texture.Width), static_cast<uint32_t>(texture.Height), 1};
+	imageInfo.mipLevels		= 1;
+	imageInfo.arrayLayers	= 1;
+	imageInfo.samples		= vk::SampleCountFlagBits::e1;
+	imageInfo.tiling		= vk::ImageTiling::eOptimal;
+	imageInfo.usage			= vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+	imageInfo.sharingMode	= vk::SharingMode::eExclusive;
+	imageInfo.initialLayout	= vk::ImageLayout::eUndefined;
+	auto page		= std::make_unique<Texture>();
+	page->bindless	= bindless;
+	page->image		= allocator->CreateImage(imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	vk::ImageViewCreateInfo viewInfo;
+	viewInfo.image				= *page->image;
+	viewInfo.viewType			= vk::ImageViewType::e2D;
+	viewInfo.format				= imageInfo.format;
+	viewInfo.subresourceRange	= vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+	page->view = vk::raii::ImageView(*device, viewInfo);
+	TransferUploader::ImageUpload upload;
+	upload.image	= *page->image;
+	upload.range	= viewInfo.subresourceRange;
+	vk::BufferImageCopy region;
+	region.imageSubresource	= vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+	region.imageExtent		= imageInfo.extent;
+	upload.regions.push_back(region);
+	page->ticket	= uploader->UploadImage(upload, texture.GetPixels(), static_cast<vk::DeviceSize>(texture.GetSizeInBytes()));
+	page->slot		= bindless->RegisterImage(*page->view);
+	if(current != nullptr)
+		deletionQueue->Push(retireValue, std::unique_ptr<Texture>(current));
+	texture.SetTexID(static_cast<ImTextureID>(page->slot));
+	texture.BackendUserData = page.release();
+	texture.SetStatus(ImTextureStatus_OK);
+}
+
+void Hud::Record(const vk::raii::CommandBuffer& commandBuffer, UploadRing& ring, vk::Pipeline pipeline, vk::PipelineLayout layout) const
+{
+	if(drawData == nullptr || !drawable || drawData->TotalVtxCount == 0)
+		return;
+	//every list of the frame goes into one vertex and one index allocation
+	UploadRing::Slice vertices	= ring.Allocate(drawData->TotalVtxCount * sizeof(ImDrawVert), sizeof(float));
+	UploadRing::Slice indices	= ring.Allocate(drawData->TotalIdxCount * sizeof(ImDrawIdx), sizeof(uint32_t));
+	auto* vertexOut	= static_cast<ImDrawVert*>(vertices.data);
+	auto* indexOut	= static_cast<ImDrawIdx*>(indices.data);
+	for(const ImDrawList* list : drawData->CmdLists)
+	{
+		vertexOut	= std::copy(list->VtxBuffer.begin(), list->VtxBuffer.end(), vertexOut);
+		indexOut	= std::copy(list->IdxBuffer.begin(), list->IdxBuffer.end(), indexOut);
+	}
+	//ImGui pixels to clip space, y already points down in Vulkan
+	glm::vec2 scale(2.0f / drawData->DisplaySize.x, 2.0f / drawData->DisplaySize.y);
+	FrameData frameData;
+	frameData.transform = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f - drawData->DisplayPos.x * scale.x, -1.0f - drawData->DisplayPos.y * scale.y, 0.0f)),
+									 glm::vec3(scale, 1.0f));
+	DrawConstants constants;
+	constants.frameData		= ring.DeviceAddress() + ring.Push(frameData).offset;
+	constants.vertices		= ring.DeviceAddress() + vertices.offset;
+	constants.samplerIndex	= samplerSlot;
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+	commandBuffer.bindIndexBuffer(ring.Buffer(), indices.offset, sizeof(ImDrawIdx) == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32);
+	commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, drawData->DisplaySize.x, drawData->DisplaySize.y, 0.0f, 1.0f));
+	uint32_t vertexBase = 0;
+	uint32_t indexBase = 0;
+	for(const ImDrawList* list : drawData->CmdLists)
+	{
+		for(const ImDrawCmd& command : list->CmdBuffer)
+		{
+			if(command.UserCallback != nullptr)
+				continue;
+			ImVec2 clipMin(std::max(command.ClipRect.x - drawData->DisplayPos.x, 0.0f), std::max(command.ClipRect.y - drawData->DisplayPos.y, 0.0f));
+			ImVec2 clipMax(std::min(command.ClipRect.z - drawData->DisplayPos.x, drawData->DisplaySize.x), std::min(command.ClipRect.w - drawData->DisplayPos.y, drawData->DisplaySize.y));
+			if(clipMax.x <= clipMin.x || clipMax.y <= clipMin.y)
+				continue;
+			commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(static_cast<int32_t>(clipMin.x), static_cast<int32_t>(clipMin.y)),
+												   vk::Extent2D(static_cast<uint32_t>(clipMax.x - clipMin.x), static_cast<uint32_t>(clipMax.y - clipMin.y))));
+			constants.textureIndex = static_cast<uint32_t>(command.GetTexID());
+			commandBuffer.pushConstants<DrawConstants>(layout, DRAW_CONSTANT_STAGES, 0, constants);
+			commandBuffer.drawIndexed(command.ElemCount, 1, indexBase + command.IdxOffset, static_cast<int32_t>(vertexBase + command.VtxOffset), 0);
+		}
+		vertexBase	+= static_cast<uint32_t>(list->VtxBuffer.Size);
+		indexBase	+= static_cast<uint32_t>(list->IdxBuffer.Size);
+	}
+}
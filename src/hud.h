@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "bindless.h"
+#include "deferred_deletion.h"
+#include "frame_stats.h"
+#include "gpu_allocator.h"
+#include "transfer_queue.h"
+#include "upload_ring.h"
+
+struct ImDrawData;
+struct ImGuiContext;
+struct ImTextureData;
+
+struct HudHeapBudget
+{
+	vk::DeviceSize	usage		= 0;
+	vk::DeviceSize	budget		= 0;
+	bool			deviceLocal	= false;
+};
+
+//what the overlay shows besides the timing history it keeps itself
+struct HudStatus
+{
+	const char*					presentMode		= "";
+	uint32_t					framesInFlight	= 0;
+	uint32_t					swapChainImages	= 0;
+	//0 = unlimited
+	uint32_t					fpsLimit		= 0;
+	//input to display of the newest measured present, negative without present wait
+	double						latencyMs		= -1.0;
+	//0 without dynamic resolution
+	float						renderScale		= 0.0f;
+	vk::Extent2D				renderExtent;
+	//CPU culled draws, 0 nodes when GPU driven
+	uint32_t					sceneNodes		= 0;
+	uint32_t					visibleNodes	= 0;
+	//empty without VK_EXT_memory_budget
+	std::vector<HudHeapBudget>	heaps;
+	GpuAllocatorStats			allocator;
+};
+
+//Performance overlay on Dear ImGui with a renderer of its own: vertices and indices are copied
+//into the per-frame upload ring and read through a device address, atlas pages are bindless
+//images uploaded through the transfer queue. Hidden, it costs nothing per frame.
+class Hud
+{
+	public:
+		static constexpr size_t HISTORY_FRAMES = 240;
+
+		void Init(const vk::raii::Device& device, GpuAllocator& allocator, TransferUploader& uploader, BindlessDescriptors& bindless,
+					DeferredDeletionQueue& deletionQueue, bool visible);
+		~Hud();
+		void Toggle(){ visible = !visible; }
+		bool IsVisible() const { return visible; }
+		void AddFrame(const FrameTimings& timings);
+		void AddGpuFrame(double ms);
+		//render thread, before recording: builds the UI and applies atlas changes;
+		//retireValue is the frame timeline value after which replaced atlas pages are unused
+		void BuildFrame(const HudStatus& status, vk::Extent2D extent, uint64_t retireValue);
+		//inside the frame's rendering, may run on a recording thread; the bindless set has to be bound
+		//on set 0 of a layout compatible with layout
+		void Record(const vk::raii::CommandBuffer& commandBuffer, UploadRing& ring, vk::Pipeline pipeline, vk::PipelineLayout layout) const;
+	private:
+		struct Texture
+		{
+			BindlessDescriptors*	bindless = nullptr;
+			GpuImage				image;
+			vk::raii::ImageView		view = nullptr;
+			uint32_t				slot = BindlessDescriptors::INVALID_INDEX;
+			uint64_t				ticket = 0;
+			~Texture();
+		};
+		void DrawWindow(const HudStatus& status);
+		void UpdateTexture(ImTextureData& texture, uint64_t retireValue);
+
+		const vk::raii::Device*					device = nullptr;
+		GpuAllocator*							allocator = nullptr;
+		TransferUploader*						uploader = nullptr;
+		BindlessDescriptors*					bindless = nullptr;
+		DeferredDeletionQueue*					deletionQueue = nullptr;
+		ImGuiContext*							context = nullptr;
+		vk::raii::Sampler						sampler = nullptr;
+		uint32_t								samplerSlot = BindlessDescriptors::INVALID_INDEX;
+		bool									visible = false;
+		//this frame's draw lists, owned by ImGui until the next BuildFrame
+		ImDrawData*								drawData = nullptr;
+		//false while an atlas page the draw lists use is still uploading
+		bool									drawable = false;
+		std::array<float, HISTORY_FRAMES>		frameMs{};
+		std::array<float, HISTORY_FRAMES>		cpuMs{};
+		std::array<float, HISTORY_FRAMES>		gpuMs{};
+		size_t									frameHead = 0;
+		size_t									gpuHead = 0;
+		FrameTimings							lastFrame;
+		std::chrono::steady_clock::time_point	lastBuild;
+};
@@ -0,0 +1,168 @@
+#include "instance_culler.h"
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+namespace
+{
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+void InstanceCuller::Init(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, GpuAllocator& allocator,
+							TransferUploader& uploader, vk::DescriptorSetLayout globalSetLayout, const vk::PushConstantRange& pushConstants, uint32_t frameSlots)
+{
+	this->device		= &device;
+	this->allocator		= &allocator;
+	this->uploader		= &uploader;
+	this->frameSlots	= frameSlots;
+	storageAlignment	= physicalDevice.getProperties().limits.minStorageBufferOffsetAlignment;
+
+	//0 instances, 1 bounds, 2 visible list written by the cull pass, 3 draw args, 4 visible list read by the vertex shader
+	std::array<vk::DescriptorSetLayoutBinding, 5> bindings;
+	bindings[0] = vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex);
+	bindings[1] = vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+	bindings[2] = vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute);
+	bindings[3] = vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute);
+	bindings[4] = vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex);
+	vk::DescriptorSetLayoutCreateInfo layoutInfo;
+	layoutInfo.bindingCount	= static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings	= bindings.data();
+	setLayout = vk::raii::DescriptorSetLayout(device, layoutInfo);
+
+	std::array<vk::DescriptorSetLayout, 2> setLayouts = {globalSetLayout, *setLayout};
+	vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+	pipelineLayoutInfo.setLayoutCount			= static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutInfo.pSetLayouts				= setLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount	= 1;
+	pipelineLayoutInfo.pPushConstantRanges		= &pushConstants;
+	pipelineLayout = vk::raii::PipelineLayout(device, pipelineLayoutInfo);
+
+	std::array<vk::DescriptorPoolSize, 2> poolSizes = {
+		vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 2),
+		vk::DescriptorPoolSize(vk::DescriptorType::eStorageBufferDynamic, 3)};
+	vk::DescriptorPoolCreateInfo poolInfo;
+	poolInfo.flags			= vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+	poolInfo.maxSets		= 1;
+	poolInfo.poolSizeCount	= static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes		= poolSizes.data();
+	descriptorPool = vk::raii::DescriptorPool(device, poolInfo);
+
+	vk::DescriptorSetAllocateInfo allocInfo;
+	allocInfo.descriptorPool		= descriptorPool;
+	allocInfo.descriptorSetCount	= 1;
+	allocInfo.pSetLayouts			= &*setLayout;
+	descriptorSet = std::move(vk::raii::DescriptorSets(device, allocInfo).front());
+}
+
+void InstanceCuller::Upload(const std::vector<uint32_t>& indices, const std::vector<InstanceData>& instances, const std::vector<glm::vec4>& bounds)
+{
+	if(instances.empty() || instances.size() != bounds.size() || indices.empty())
+		throw std::runtime_error("instance culler: every instance needs one bounding sphere");
+	instanceCount	= static_cast<uint32_t>(instances.size());
+	indexCount		= static_cast<uint32_t>(indices.size());
+
+	auto createBuffer = [this](vk::DeviceSize size, vk::BufferUsageFlags usage){
+		vk::BufferCreateInfo bufferInfo;
+		bufferInfo.size			= size;
+		bufferInfo.usage		= usage;
+		bufferInfo.sharingMode	= vk::SharingMode::eExclusive;
+		return allocator->CreateBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	};
+	vk::DeviceSize indexBytes		= indices.size() * sizeof(uint32_t);
+	vk::DeviceSize instanceBytes	= instances.size() * sizeof(InstanceData);
+	vk::DeviceSize boundsBytes		= bounds.size() * sizeof(glm::vec4);
+	indexBuffer		= createBuffer(indexBytes, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst);
+	instanceBuffer	= createBuffer(instanceBytes, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+	boundsBuffer	= createBuffer(boundsBytes, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+	//one region per frame slot, a slot is only rewritten after the frame that used it has completed
+	visibleStride	= AlignUp(instances.size() * sizeof(uint32_t), storageAlignment);
+	argsStride		= AlignUp(sizeof(DrawArgs), storageAlignment);
+	visibleBuffer	= createBuffer(visibleStride * frameSlots, vk::BufferUsageFlagBits::eStorageBuffer);
+	argsBuffer		= createBuffer(argsStride * frameSlots, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+																vk::BufferUsageFlagBits::eTransferDst);
+
+	//tickets grow monotonically, the last one covers the whole scene
+	uploader->UploadBuffer(*indexBuffer, 0, indices.data(), indexBytes);
+	uploader->UploadBuffer(*instanceBuffer, 0, instances.data(), instanceBytes);
+	uploadTicket = uploader->UploadBuffer(*boundsBuffer, 0, bounds.data(), boundsBytes);
+
+	std::array<vk::DescriptorBufferInfo, 5> bufferInfos = {
+		vk::DescriptorBufferInfo(*instanceBuffer, 0, instanceBytes),
+		vk::DescriptorBufferInfo(*boundsBuffer, 0, boundsBytes),
+		vk::DescriptorBufferInfo(*visibleBuffer, 0, instances.size() * sizeof(uint32_t)),
+		vk::DescriptorBufferInfo(*argsBuffer, 0, sizeof(DrawArgs)),
+		vk::DescriptorBufferInfo(*visibleBuffer, 0, instances.size() * sizeof(uint32_t))};
+	std::array<vk::WriteDescriptorSet, 5> writes;
+	for(uint32_t i = 0; i < writes.size(); i++)
+	{
+		writes[i].dstSet			= descriptorSet;
+		writes[i].dstBinding		= i;
+		writes[i].descriptorCount	= 1;
+		writes[i].descriptorType	= i < 2 ? vk::DescriptorType::eStorageBuffer : vk::DescriptorType::eStorageBufferDynamic;
+		writes[i].pBufferInfo		= &bufferInfos[i];
+	}
+	device->updateDescriptorSets(writes, {});
+}
+
+void InstanceCuller::CreatePipeline(vk::ShaderModule shaderModule, const vk::raii::PipelineCache& cache)
+{
+	vk::PipelineShaderStageCreateInfo stageInfo;
+	stageInfo.stage		= vk::ShaderStageFlagBits::eCompute;
+	stageInfo.module	= shaderModule;
+	stageInfo.pName		= "cullMain";
+	vk::ComputePipelineCreateInfo pipelineInfo;
+	pipelineInfo.stage	= stageInfo;
+	pipelineInfo.layout	= *pipelineLayout;
+	pipeline = vk::raii::Pipeline(*device, cache, pipelineInfo);
+}
+
+bool InstanceCuller::IsReady() const
+{
+	return instanceCount > 0 && uploader->IsAvailable(uploadTicket);
+}
+
+std::vector<uint32_t> InstanceCuller::DynamicOffsets(uint32_t frameSlot) const
+{
+	//binding order: visible list, draw args, visible list again for the vertex shader
+	uint32_t visibleOffset	= static_cast<uint32_t>(visibleStride * frameSlot);
+	uint32_t argsOffset		= static_cast<uint32_t>(argsStride * frameSlot);
+	return {visibleOffset, argsOffset, visibleOffset};
+}
+
+BufferRange InstanceCuller::DrawArgsRange(uint32_t frameSlot) const
+{
+	return {*argsBuffer, argsStride * frameSlot, sizeof(DrawArgs)};
+}
+
+BufferRange InstanceCuller::VisibleRange(uint32_t frameSlot) const
+{
+	return {*visibleBuffer, visibleStride * frameSlot, visibleStride};
+}
+
+void InstanceCuller::RecordReset(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameSlot) const
+{
+	//the cull pass counts the surviving instances up from zero
+	DrawArgs args;
+	args.command.indexCount = indexCount;
+	commandBuffer.updateBuffer<DrawArgs>(*argsBuffer, argsStride * frameSlot, args);
+}
+
+void InstanceCuller::RecordCull(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameSlot) const
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout, 1, *descriptorSet, DynamicOffsets(frameSlot));
+	commandBuffer.dispatch((instanceCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+}
+
+void InstanceCuller::RecordDraw(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameSlot) const
+{
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *pipelineLayout, 1, *descriptorSet, DynamicOffsets(frameSlot));
+	commandBuffer.bindIndexBuffer(*indexBuffer, 0, vk::IndexType::eUint32);
+	vk::DeviceSize argsOffset = argsStride * frameSlot;
+	commandBuffer.drawIndexedIndirectCount(*argsBuffer, argsOffset + offsetof(DrawArgs, command), *argsBuffer, argsOffset + offsetof(DrawArgs, drawCount),
+											1, sizeof(vk::DrawIndexedIndirectCommand));
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+#include <glm/glm.hpp>
+
+#include "gpu_allocator.h"
+#include "render_graph.h"
+#include "transfer_queue.h"
+
+//matches InstanceData in shader.slang
+struct InstanceData
+{
+	glm::mat4	transform;
+	glm::vec4	tint;
+};
+
+//GPU driven instancing. Instances and their bounding spheres live in device local storage
+//buffers; a compute pass frustum culls them and compacts the visible ones into a per frame
+//slot list and the indexed indirect command that drawIndexedIndirectCount consumes, so the
+//CPU records the same handful of commands however many instances the scene holds.
+//Barriers between reset, cull and draw are left to the render graph, see the *Range accessors.
+class InstanceCuller
+{
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+		//globalSetLayout and pushConstants are shared with the other pipelines, the culler's own set is set 1
+		void Init(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, GpuAllocator& allocator,
+					TransferUploader& uploader, vk::DescriptorSetLayout globalSetLayout, const vk::PushConstantRange& pushConstants, uint32_t frameSlots);
+		//uploads the mesh indices, the instances and one bounding sphere per instance (xyz center, w radius)
+		void Upload(const std::vector<uint32_t>& indices, const std::vector<InstanceData>& instances, const std::vector<glm::vec4>& bounds);
+		void CreatePipeline(vk::ShaderModule shaderModule, const vk::raii::PipelineCache& cache);
+		//layout shared by the cull pipeline and the instanced graphics pipelines
+		vk::PipelineLayout PipelineLayout() const { return *pipelineLayout; }
+		//false until the uploaded scene is owned by the graphics queue
+		bool IsReady() const;
+		uint32_t InstanceCount() const { return instanceCount; }
+		//the slot's draw count and indirect command, written by RecordReset and RecordCull, read by RecordDraw
+		BufferRange DrawArgsRange(uint32_t frameSlot) const;
+		//the slot's compacted instance indices, written by RecordCull, read by the vertex shader
+		BufferRange VisibleRange(uint32_t frameSlot) const;
+		//transfer: zeroes the slot's draw count
+		void RecordReset(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameSlot) const;
+		//outside of rendering, after RecordReset: culls into the slot's list and command.
+		//set 0 and the push constants have to be bound for the compute bind point already
+		void RecordCull(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameSlot) const;
+		//inside rendering, the instanced pipeline, set 0 and the push constants have to be bound already
+		void RecordDraw(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameSlot) const;
+	private:
+		//matches DrawArgs in shader.slang: the draw count followed by one indexed indirect command
+		struct DrawArgs
+		{
+			uint32_t							drawCount = 0;
+			uint32_t							padding[3] = {};
+			vk::DrawIndexedIndirectCommand		command;
+		};
+		std::vector<uint32_t> DynamicOffsets(uint32_t frameSlot) const;
+
+		const vk::raii::Device*			device = nullptr;
+		TransferUploader*				uploader = nullptr;
+		GpuAllocator*					allocator = nullptr;
+		vk::DeviceSize					storageAlignment = 1;
+		uint32_t						frameSlots = 0;
+		uint32_t						instanceCount = 0;
+		uint32_t						indexCount = 0;
+		uint64_t						uploadTicket = 0;
+		vk::DeviceSize					visibleStride = 0;
+		vk::DeviceSize					argsStride = 0;
+		GpuBuffer						indexBuffer;
+		GpuBuffer						instanceBuffer;
+		GpuBuffer						boundsBuffer;
+		GpuBuffer						visibleBuffer;
+		GpuBuffer						argsBuffer;
+		vk::raii::DescriptorSetLayout	setLayout = nullptr;
+		vk::raii::PipelineLayout		pipelineLayout = nullptr;
+		vk::raii::DescriptorPool		descriptorPool = nullptr;
+		vk::raii::DescriptorSet			descriptorSet = nullptr;
+		vk::raii::Pipeline				pipeline = nullptr;
+};
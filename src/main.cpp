@@ -1,9 +1,42 @@
 #include <iostream>
-#include <fstream>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <span>
 
 #include <vulkan/vulkan_raii.hpp>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "options.h"
+#include "frame_stats.h"
+#include "pipeline_cache.h"
+#include "pipeline_registry.h"
+#include "gpu_allocator.h"
+#include "upload_ring.h"
+#include "transfer_queue.h"
+#include "command_recorder.h"
+#include "deferred_deletion.h"
+#include "instance_culler.h"
+#include "bindless.h"
+#include "draw_constants.h"
+#include "mesh_loader.h"
+#include "texture_streamer.h"
+#include "hud.h"
+#include "render_graph.h"
+#include "frame_capture.h"
+#include "frame_pacing.h"
+#include "dynamic_resolution.h"
+#include "scene.h"
+#include "render_server.h"
+#include "shader_spirv.h"
+#include "trace.h"
+#ifdef SHADER_HOT_RELOAD
+#include "shader_watcher.h"
+#endif
 
 const std::vector<char const*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"};
@@ -13,18 +46,56 @@ const std::vector<char const*> validationLayers = {
 	constexpr bool enableValidationLayers = true;
 #endif
 
-constexpr int WIDTH = 800;
-constexpr int HEIGHT = 600;
-constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+constexpr vk::DeviceSize UPLOAD_RING_REGION_SIZE = 16ull << 20;
+//kept free of per draw data for the HUD geometry and the other pushes of a frame
+constexpr vk::DeviceSize UPLOAD_RING_FRAME_RESERVE = 1ull << 20;
+constexpr vk::DeviceSize STAGING_BUFFER_SIZE = 64ull << 20;
+
+//what setup asks of the selected GPU, queried once during device selection
+struct DeviceCaps
+{
+	vk::PhysicalDeviceProperties			properties;
+	std::vector<vk::QueueFamilyProperties>	queueFamilies;
+	vk::PhysicalDeviceFeatures				features;
+	//VK_KHR_calibrated_timestamps with the device and CLOCK_MONOTONIC domains
+	bool									calibratedTimestamps = false;
+	//VK_EXT_memory_budget, heap budgets on the HUD
+	bool									memoryBudget = false;
+	//VK_KHR_present_id and VK_KHR_present_wait, input to display latency
+	bool									presentWait = false;
+	//vkCmdDrawIndexedIndirectCount, only the GPU driven path draws with it
+	bool									drawIndirectCount = false;
+};
+
+//GPU spans drift against the CPU clock, the calibration is refreshed this often
+constexpr uint64_t GPU_CLOCK_CALIBRATION_FRAMES = 256;
+//begin of the frame, end of the scene passes and end of the frame
+constexpr uint32_t TIMESTAMPS_PER_FRAME = 3;
+//heap budgets move slowly, the HUD queries them every this many frames
+constexpr uint64_t HUD_BUDGET_QUERY_FRAMES = 30;
+
+//headless render targets, the swapchain format picks from the surface
+constexpr vk::SurfaceFormatKHR OFFSCREEN_SURFACE_FORMAT{vk::Format::eR8G8B8A8Srgb, vk::ColorSpaceKHR::eSrgbNonlinear};
+
+//bounding radius of a mesh draw around its origin, the mesh fills [-1, 1] in x and y and [0.25, 0.75] in z
+constexpr float MESH_RADIUS = 1.6f;
 
 class TriangleVulkan
 {
 	public:
+		explicit TriangleVulkan(const RendererOptions& options) : options(options){}
 		void Run(){
-			if(InitGLFW())
+			startupTimer.Begin();
+			if(!options.tracePath.empty() && !Tracer::Start())
+				std::cerr << "tracing is compiled out, --trace ignored" << std::endl;
+			TRACE_THREAD_NAME("main");
+			if(options.headless || InitGLFW())
 			{
 				InitVulkan();
-				Loop();
+				if(!options.servePath.empty())
+					Serve();
+				else
+					Loop();
 				Destroy();
 			}
 		}
@@ -33,13 +104,14 @@ class TriangleVulkan
 				return false;
 			glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 			glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
-			window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan Triangle", nullptr, nullptr);
+			window = glfwCreateWindow(static_cast<int>(options.width), static_cast<int>(options.height), "Vulkan Triangle", nullptr, nullptr);
 			if(window == nullptr){
 				glfwTerminate();
 				return false;
 			}
 			glfwSetWindowUserPointer(window, this);
 			glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+			glfwSetKeyCallback(window, keyCallback);
 			return true;
 		}
 		static void framebufferResizeCallback(GLFWwindow* window, int w, int h)
@@ -47,7 +119,32 @@ class TriangleVulkan
 			auto app				= reinterpret_cast<TriangleVulkan*>(glfwGetWindowUserPointer(window));
 			app->framebufferResized = true;
 		}
+		static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+		{
+			if(action != GLFW_PRESS)
+				return;
+			auto app = reinterpret_cast<TriangleVulkan*>(glfwGetWindowUserPointer(window));
+			//C: cull mode, B: blend mode, T: write the trace so far, H: HUD, P: present mode
+			if(key == GLFW_KEY_T)
+				app->WriteTrace();
+			else if(key == GLFW_KEY_H)
+				app->hud.Toggle();
+			else if(key == GLFW_KEY_P)
+				app->CyclePresentMode();
+			else if(key == GLFW_KEY_C)
+			{
+				app->cullMode = app->cullMode == vk::CullModeFlagBits::eBack ? vk::CullModeFlagBits::eNone :
+								app->cullMode == vk::CullModeFlagBits::eNone ? vk::CullModeFlagBits::eFront : vk::CullModeFlagBits::eBack;
+				app->SelectPipelineVariant();
+			}
+			else if(key == GLFW_KEY_B)
+			{
+				app->blendMode = static_cast<BlendMode>((static_cast<uint32_t>(app->blendMode) + 1) % 3);
+				app->SelectPipelineVariant();
+			}
+		}
 		void InitVulkan(){
+			startupTimer.Lap(StartupPhase::Window);
 			constexpr vk::ApplicationInfo appInfo{	"Vulkan Triangle",
 													vk::makeVersion(1,0,0),
 													"No Engine",
@@ -55,12 +152,15 @@ class TriangleVulkan
 													vk::ApiVersion14};
 			//Get the required layers
 			std::vector<char const*> requiredLayers;
+			//enumerating layers loads every layer manifest, only worth it when there is one to check
 			if(enableValidationLayers)
+			{
 				requiredLayers.assign(validationLayers.begin(), validationLayers.end());
-			auto layerProperties = context.enumerateInstanceLayerProperties();
-			auto unSupportedLayerIt = std::ranges::find_if(requiredLayers, [&layerProperties](auto const& requiredLayer){return std::ranges::none_of(layerProperties, [requiredLayer](auto const& layerProperty){return strcmp(layerProperty.layerName, requiredLayer) == 0;});});
-			if(unSupportedLayerIt != requiredLayers.end())
-				throw std::runtime_error("Required layer not supported: " + std::string(*unSupportedLayerIt));
+				auto layerProperties = context.enumerateInstanceLayerProperties();
+				auto unSupportedLayerIt = std::ranges::find_if(requiredLayers, [&layerProperties](auto const& requiredLayer){return std::ranges::none_of(layerProperties, [requiredLayer](auto const& layerProperty){return strcmp(layerProperty.layerName, requiredLayer) == 0;});});
+				if(unSupportedLayerIt != requiredLayers.end())
+					throw std::runtime_error("Required layer not supported: " + std::string(*unSupportedLayerIt));
+			}
 			auto requiredExtensions = GetRequiredInstanceExtensions();
 			//Check if the required extensions are supported by the Vulkan implementation
 			auto extensionProperties = context.enumerateInstanceExtensionProperties();
@@ -77,87 +177,476 @@ class TriangleVulkan
 			//ValidationLayers
 			SetupDebugMessenger();
 			//Surface
-			CreateSurface();
+			if(!options.headless)
+				CreateSurface();
+			else
+				requiredDeviceExtension.clear();
+			startupTimer.Lap(StartupPhase::Instance);
 			//PhsicalDevice
 			SetupPhysicalDevice();
+			startupTimer.Lap(StartupPhase::DeviceSelection);
 			//LogicalDevice and Queue
 			CreateLogicalDevice();
-			//SwapChain
-			CreateSwapChain();
-			//ImageView
-			CreateImageViews();
-			//GraphicsPipeline
-			CreateGraphicsPipeline();
+			startupTimer.Lap(StartupPhase::DeviceCreation);
+			//Memory
+			GpuAllocatorConfig allocatorConfig;
+			allocatorConfig.deviceAddress = true;
+			gpuAllocator.Init(physicalDevice, device, allocatorConfig);
+			uploadRing.Init(gpuAllocator, physicalDevice, device, UPLOAD_RING_REGION_SIZE, options.framesInFlight,
+							vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress |
+							vk::BufferUsageFlagBits::eIndexBuffer);
+			//the CPU path pushes one FrameData per visible draw, a grid that cannot fit would only
+			//fail halfway through recording, possibly on a recording thread
+			vk::DeviceSize maxDraws = uploadRing.Capacity(sizeof(FrameData), UPLOAD_RING_FRAME_RESERVE);
+			if(!options.gpuDriven && options.drawCount > maxDraws)
+				throw std::runtime_error("--draws " + std::to_string(options.drawCount) + " exceeds the " + std::to_string(maxDraws) +
+										 " draws the upload ring fits per frame, use --gpu-driven for larger grids");
+			bindless.Init(physicalDevice, device);
+			transferUploader.Init(device, gpuAllocator, transferQueue, transferQueueIndex, queueIndex, STAGING_BUFFER_SIZE);
+			hud.Init(device, gpuAllocator, transferUploader, bindless, deletionQueue, options.hud);
+			renderGraph.Init(device, gpuAllocator, deletionQueue);
+			if(!options.texturePath.empty())
+			{
+				TextureStreamerConfig textureConfig;
+				textureConfig.budgetBytes	= vk::DeviceSize(options.textureBudgetMB) << 20;
+				textureConfig.compress		= options.textureBc1;
+				textureStreamer.Init(physicalDevice, device, gpuAllocator, transferUploader, bindless, deletionQueue, textureConfig);
+				texture = textureStreamer.Request(options.texturePath);
+			}
+			//the pipelines only depend on the target format, it is fixed before anything else needs it
+			swapChainSurfaceFormat = options.headless ? OFFSCREEN_SURFACE_FORMAT : SelectSwapSurfaceFormat(physicalDevice.getSurfaceFormatsKHR(*surface));
+			depthFormat = SelectDepthFormat();
+			InitDynamicResolution();
+			if(!options.capturePath.empty())
+			{
+				FrameCaptureConfig captureConfig;
+				captureConfig.format		= options.captureRaw ? CaptureFormat::Raw : CaptureFormat::Png;
+				captureConfig.path			= options.capturePath;
+				captureConfig.encodeThreads	= options.captureThreads;
+				//a window keeps its frame rate, headless runs keep every frame
+				captureConfig.dropWhenBusy	= !options.headless;
+				frameCapture.Init(physicalDevice, device, gpuAllocator, swapChainSurfaceFormat.format, options.framesInFlight, captureConfig);
+			}
+			CreatePipelineLayout();
+			startupTimer.Lap(StartupPhase::Resources);
+			//GraphicsPipeline: compiles on a worker while the swapchain, scene and sync objects are set up
+			auto pipelineWork = std::async(std::launch::async, [this](){
+				auto start = std::chrono::steady_clock::now();
+				CreateGraphicsPipeline();
+				return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			});
+			if(options.headless)
+			{
+				//Offscreen targets stand in for the swapchain images
+				CreateOffscreenTargets();
+			}
+			else
+			{
+				//SwapChain
+				CreateSwapChain();
+				//ImageView
+				CreateImageViews();
+			}
+			startupTimer.Lap(StartupPhase::Swapchain);
+			BuildScene();
+			if(!options.meshPath.empty())
+				LoadSceneMesh();
+			startupTimer.Lap(StartupPhase::Scene);
 			//Command
 			CreateCommandPool();
-			CreateCommandBuffer();
 			//SyncObjects
 			CreateSyncObjects();
+			//Benchmark, GPU trace spans and the HUD graph
+			CreateTimestampQueries();
+			if(options.benchmarkFrames > 0)
+				frameStats.Reserve(options.benchmarkFrames);
+			startupTimer.Lap(StartupPhase::CommandsAndSync);
+			startupTimer.Add(StartupPhase::Pipeline, pipelineWork.get());
+			startupTimer.Lap(StartupPhase::PipelineWait);
+			startupTimer.Timings().Print(std::cout);
 		}
 		void Loop()
 		{
-			while(!glfwWindowShouldClose(window)){
-				glfwPollEvents();
+			auto start = std::chrono::steady_clock::now();
+			uint32_t frame = 0;
+			frameLimiter.SetRate(options.fpsLimit);
+			for(; !ShouldStop(frame); frame++){
+				//GPU wait and frame cap come first, input is sampled as late as possible
+				WaitForFrameSlot();
+				frameLimiter.Wait();
+				if(!options.headless)
+					glfwPollEvents();
+				inputSampleNs = Tracer::Now();
+				frameTimer.Lap(FramePhase::Pace);
+#ifdef SHADER_HOT_RELOAD
+				ReloadShaders();
+#endif
 				DrawFrame();
 			}
 			device.waitIdle();
+			deletionQueue.Flush();
+			WriteTrace();
+			PrintPipelineStats();
+			gpuAllocator.PrintStats(std::cout);
+			uploadRing.PrintStats(std::cout);
+			renderGraph.PrintStats(std::cout);
+			if(presentLatency.IsEnabled())
+				presentLatency.PrintStats(std::cout);
+			if(dynamicResolution.IsEnabled())
+				dynamicResolution.PrintStats(std::cout);
+			if(frameCapture.IsEnabled())
+			{
+				frameCapture.Finish(CompletedFrameValue());
+				frameCapture.PrintStats(std::cout);
+			}
+			if(texture != TextureStreamer::INVALID_HANDLE)
+				textureStreamer.PrintStats(std::cout);
+			if(options.benchmarkFrames > 0)
+			{
+				CollectGpuTimestamps();
+				ReportBenchmark();
+			}
+			else if(options.headless)
+			{
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				std::cout << "headless: " << frame << " frames in " << seconds * 1000.0 << " ms ("
+						  << (seconds > 0.0 ? frame / seconds : 0.0) << " fps)" << std::endl;
+			}
+		}
+		//batch mode: the device, pipelines and bindless set stay, jobs replace the frame loop
+		void Serve()
+		{
+			RenderServerDevice serverDevice;
+			serverDevice.physicalDevice		= &physicalDevice;
+			serverDevice.device				= &device;
+			serverDevice.allocator			= &gpuAllocator;
+			serverDevice.bindless			= &bindless;
+			serverDevice.queueFamily		= queueIndex;
+			for(const vk::raii::Queue& serverQueue : serverQueues)
+				serverDevice.queues.push_back(&serverQueue);
+			serverDevice.pipeline			= pipelineRegistry.Resolve(fallbackPipeline, fallbackPipeline);
+			serverDevice.layout				= *pipeLineLayout;
+			serverDevice.colorFormat		= swapChainSurfaceFormat.format;
+			serverDevice.depthFormat		= depthFormat;
+			serverDevice.timestampValidBits	= deviceCaps.queueFamilies[queueIndex].timestampValidBits;
+			serverDevice.timestampPeriod	= deviceCaps.properties.limits.timestampPeriod;
+			RenderServerConfig config;
+			config.source			= options.servePath;
+			config.concurrentJobs	= options.serveJobs;
+			renderServer.Run(serverDevice, config);
+			device.waitIdle();
+			deletionQueue.Flush();
+			WriteTrace();
+			renderServer.PrintStats(std::cout);
+			gpuAllocator.PrintStats(std::cout);
+		}
+		bool ShouldStop(uint32_t frame) const
+		{
+			if(options.frameCount != 0 && frame >= options.frameCount)
+				return true;
+			return !options.headless && glfwWindowShouldClose(window);
+		}
+		void ReportBenchmark()
+		{
+			frameStats.Print(std::cout);
+			BenchmarkInfo info;
+			info.deviceName		= deviceCaps.properties.deviceName.data();
+			info.width			= swapChainExtent.width;
+			info.height			= swapChainExtent.height;
+			info.headless		= options.headless;
+			info.warmupFrames	= options.warmupFrames;
+			info.presentMode	= swapChainPresentMode;
+			info.fpsLimit		= options.fpsLimit;
+			info.startup		= startupTimer.Timings();
+			frameStats.WriteJson(options.reportPath, info);
+			std::cout << "benchmark report: " << options.reportPath << std::endl;
+		}
+		bool IsMeasuredFrame(uint64_t frame) const
+		{
+			return options.benchmarkFrames > 0 && frame >= options.warmupFrames;
+		}
+		void WriteTrace() const
+		{
+			if(!Tracer::IsEnabled())
+				return;
+			Tracer::WriteJson(options.tracePath);
+			std::cout << "trace: " << options.tracePath << std::endl;
+		}
+		//the frame that used this slot before has to be done on the GPU
+		void WaitForFrameSlot()
+		{
+			frameTimer.Begin();
+			{
+				TRACE_ZONE("WaitForFrame");
+				WaitForFrame(frameSlotValues[frameIndex]);
+			}
+			frameTimer.Lap(FramePhase::Wait);
 		}
+		//after WaitForFrameSlot and input sampling
 		void DrawFrame()
 		{
-			auto fenceResult = device.waitForFences(*inFlightFence[frameIndex], vk::True, UINT64_MAX);
-			if(fenceResult != vk::Result::eSuccess)
-				throw std::runtime_error("failed to wait for fence!");
-			auto[result, imageIndex] = swapChain.acquireNextImage(UINT64_MAX, *presentCompleteSemaphores[frameIndex], nullptr);
-			if(result == vk::Result::eErrorOutOfDateKHR)
+			TRACE_ZONE("DrawFrame");
+			if(!deletionQueue.Empty())
+				deletionQueue.Collect(CompletedFrameValue());
+			//readbacks of completed frames go to the encoders, the GPU is never waited on for them
+			if(frameCapture.IsEnabled())
+				frameCapture.Collect(CompletedFrameValue());
+			//images replaced now may still be sampled by every frame submitted so far
+			textureStreamer.Update(submittedFrameValue);
+			hud.BuildFrame(HudStatusNow(), swapChainExtent, submittedFrameValue);
+			//the GPU is done with this slot, its transient memory can be reused
+			gpuAllocator.BeginFrame(frameIndex);
+			uploadRing.BeginFrame(frameIndex);
+			//the wait covers the timestamps written the last time this slot was used
+			CollectGpuTimestamps();
+			//headless targets are owned per frame in flight, no acquire needed
+			uint32_t imageIndex = frameIndex;
+			if(!options.headless)
 			{
-				ReCreateSwapChain();
+				TRACE_ZONE("acquireNextImage");
+				auto swapChainLock = presentLatency.LockSwapChain();
+				auto[result, acquiredIndex] = swapChain.acquireNextImage(UINT64_MAX, *presentCompleteSemaphores[frameIndex], nullptr);
+				swapChainLock = {};
+				if(result == vk::Result::eErrorOutOfDateKHR)
+				{
+					ReCreateSwapChain();
+					return;
+				}
+				else if(result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
+				{
+					assert(result != vk::Result::eTimeout || result == vk::Result::eNotReady);
+					throw std::runtime_error("failed to acquire swap chain image!");
+				}
+				imageIndex = acquiredIndex;
+			}
+			frameTimer.Lap(FramePhase::Acquire);
+			//resets every pool of this slot at once
+			commandRecorder.BeginFrame(frameIndex);
+			//copies queued since the last frame go to the transfer queue now
+			transferUploader.Submit();
+			RecordCommandBuffer(imageIndex);
+			uploadRing.Flush();
+			frameTimer.Lap(FramePhase::Record);
+			std::vector<vk::SemaphoreSubmitInfo> waitInfos;
+			std::vector<vk::SemaphoreSubmitInfo> signalInfos;
+			if(!options.headless)
+			{
+				waitInfos.emplace_back(*presentCompleteSemaphores[frameIndex], 0, AcquireWaitStages());
+				signalInfos.emplace_back(*renderFinishedSemaphores[imageIndex], 0, vk::PipelineStageFlagBits2::eAllCommands);
+			}
+			//one timeline value per frame, other subsystems reclaim against it
+			uint64_t frameValue = ++submittedFrameValue;
+			signalInfos.emplace_back(*frameTimeline, frameValue, vk::PipelineStageFlagBits2::eAllCommands);
+			//uploads acquired in this command buffer have to be complete on the transfer queue
+			if(transferWaitValue != 0)
+				waitInfos.emplace_back(transferUploader.Timeline(), transferWaitValue, vk::PipelineStageFlagBits2::eAllCommands);
+			vk::CommandBufferSubmitInfo commandBufferInfo(*commandRecorder.Primary());
+			vk::SubmitInfo2 submitInfo;
+			submitInfo.waitSemaphoreInfoCount	= static_cast<uint32_t>(waitInfos.size());
+			submitInfo.pWaitSemaphoreInfos		= waitInfos.data();
+			submitInfo.commandBufferInfoCount	= 1;
+			submitInfo.pCommandBufferInfos		= &commandBufferInfo;
+			submitInfo.signalSemaphoreInfoCount	= static_cast<uint32_t>(signalInfos.size());
+			submitInfo.pSignalSemaphoreInfos	= signalInfos.data();
+			uint64_t submitNs = Tracer::Now();
+			{
+				TRACE_ZONE("queue.submit");
+				queue.submit2(submitInfo);
+			}
+			frameSlotValues[frameIndex] = frameValue;
+			if(captureSlot != FrameCapture::NO_SLOT)
+				frameCapture.Submitted(captureSlot, frameValue);
+			if(*timestampQueryPool)
+			{
+				timestampFrames[frameIndex]		= frameNumber;
+				timestampSubmitNs[frameIndex]	= submitNs;
+			}
+			frameTimer.Lap(FramePhase::Submit);
+			if(!options.headless)
+				Present(imageIndex);
+			frameTimer.Lap(FramePhase::Present);
+			if(IsMeasuredFrame(frameNumber))
+				frameStats.AddFrame(frameTimer.Timings());
+			hud.AddFrame(frameTimer.Timings());
+			frameNumber++;
+			frameIndex = (frameIndex + 1) % options.framesInFlight;
+			
+		}
+		void WaitForFrame(uint64_t frameValue) const
+		{
+			if(frameValue == 0)
 				return;
+			vk::SemaphoreWaitInfo waitInfo;
+			waitInfo.semaphoreCount	= 1;
+			waitInfo.pSemaphores	= &*frameTimeline;
+			waitInfo.pValues		= &frameValue;
+			if(device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess)
+				throw std::runtime_error("failed to wait for frame timeline!");
+		}
+		//timeline value of the newest frame the GPU has finished
+		uint64_t CompletedFrameValue() const
+		{
+			return frameTimeline.getCounterValue();
+		}
+		//heap budgets are refreshed every HUD_BUDGET_QUERY_FRAMES, and only while the HUD is shown
+		const HudStatus& HudStatusNow()
+		{
+			if(!hud.IsVisible())
+				return hudStatus;
+			hudStatus.presentMode		= swapChainPresentMode.c_str();
+			hudStatus.framesInFlight	= options.framesInFlight;
+			hudStatus.swapChainImages	= static_cast<uint32_t>(swapChainImages.size());
+			hudStatus.fpsLimit			= options.fpsLimit;
+			hudStatus.latencyMs			= presentLatency.IsEnabled() ? presentLatency.Stats().lastMs : -1.0;
+			hudStatus.renderScale		= dynamicResolution.IsEnabled() ? dynamicResolution.Scale() : 0.0f;
+			hudStatus.renderExtent		= dynamicResolution.RenderExtent(swapChainExtent);
+			hudStatus.sceneNodes		= options.gpuDriven ? 0 : static_cast<uint32_t>(scene.Size());
+			hudStatus.visibleNodes		= static_cast<uint32_t>(visibleDraws.size());
+			if(deviceCaps.memoryBudget && (hudStatus.heaps.empty() || frameNumber % HUD_BUDGET_QUERY_FRAMES == 0))
+			{
+				auto properties = physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+				auto const& memory = properties.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+				auto const& budget = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+				hudStatus.heaps.resize(memory.memoryHeapCount);
+				for(uint32_t i = 0; i < memory.memoryHeapCount; i++)
+				{
+					hudStatus.heaps[i].usage		= budget.heapUsage[i];
+					hudStatus.heaps[i].budget		= budget.heapBudget[i];
+					hudStatus.heaps[i].deviceLocal	= !!(memory.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+				}
 			}
-			else if(result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
+			hudStatus.allocator = gpuAllocator.Stats();
+			return hudStatus;
+		}
+		void CreateTimestampQueries()
+		{
+			timestampValidBits = deviceCaps.queueFamilies[queueIndex].timestampValidBits;
+			timestampPeriod = deviceCaps.properties.limits.timestampPeriod;
+			if(timestampValidBits == 0)
 			{
-				assert(result != vk::Result::eTimeout || result == vk::Result::eNotReady);
-				throw std::runtime_error("failed to acquire swap chain image!");
+				std::cerr << "queue does not support timestamps, GPU timings disabled" << std::endl;
+				return;
 			}
-			device.resetFences(*inFlightFence[frameIndex]);
-			commandBuffers[frameIndex].reset();
-			RecordCommandBuffer(imageIndex);
-			vk::PipelineStageFlags waitDestinationStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
-			vk::SubmitInfo submitInfo;
-			submitInfo.waitSemaphoreCount 		= 1;
-			submitInfo.pWaitSemaphores			= &*presentCompleteSemaphores[frameIndex];
-			submitInfo.pWaitDstStageMask		= &waitDestinationStageMask;
-			submitInfo.commandBufferCount 		= 1;
-			submitInfo.pCommandBuffers			= &*commandBuffers[frameIndex];
-			submitInfo.signalSemaphoreCount		= 1;
-			submitInfo.pSignalSemaphores		= &*renderFinishedSemaphores[imageIndex];
-			queue.submit(submitInfo, *inFlightFence[frameIndex]);
+			//TIMESTAMPS_PER_FRAME per frame in flight
+			vk::QueryPoolCreateInfo queryPoolInfo;
+			queryPoolInfo.queryType		= vk::QueryType::eTimestamp;
+			queryPoolInfo.queryCount	= TIMESTAMPS_PER_FRAME * options.framesInFlight;
+			timestampQueryPool = vk::raii::QueryPool(device, queryPoolInfo);
+			timestampFrames.assign(options.framesInFlight, NO_TIMESTAMP);
+			timestampSubmitNs.assign(options.framesInFlight, 0);
+		}
+		void CollectGpuTimestamps()
+		{
+			if(!*timestampQueryPool)
+				return;
+			uint64_t frame = timestampFrames[frameIndex];
+			if(frame == NO_TIMESTAMP)
+				return;
+			timestampFrames[frameIndex] = NO_TIMESTAMP;
+			auto[result, ticks] = timestampQueryPool.getResults<uint64_t>(TIMESTAMPS_PER_FRAME * frameIndex, TIMESTAMPS_PER_FRAME, TIMESTAMPS_PER_FRAME * sizeof(uint64_t),
+																		  sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+			if(result != vk::Result::eSuccess)
+				return;
+			uint64_t mask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+			uint64_t elapsed = ((ticks[2] & mask) - (ticks[0] & mask)) & mask;
+			//scaled scene passes never touch the swapchain image, the acquire wait stays out of their time
+			uint64_t sceneElapsed = ((ticks[1] & mask) - (ticks[0] & mask)) & mask;
+			dynamicResolution.AddGpuFrame(static_cast<double>(sceneElapsed) * timestampPeriod / 1e6);
+			if(Tracer::IsEnabled())
+				TraceGpuFrame(ticks[0] & mask, elapsed, timestampSubmitNs[frameIndex]);
+			double ms = static_cast<double>(elapsed) * timestampPeriod / 1e6;
+			if(IsMeasuredFrame(frame))
+				frameStats.AddGpuFrame(ms);
+			hud.AddGpuFrame(ms);
+		}
+		//puts the frame's GPU span on the trace clock next to the CPU zones that produced it
+		void TraceGpuFrame(uint64_t beginTicks, uint64_t elapsedTicks, uint64_t submitNs)
+		{
+			if(gpuClockHostNs == 0 || (deviceCaps.calibratedTimestamps && frameNumber - gpuClockFrame >= GPU_CLOCK_CALIBRATION_FRAMES))
+				CalibrateGpuClock(beginTicks, submitNs);
+			//sign extended, the calibration point may lie after beginTicks
+			uint32_t unusedBits = 64 - std::max(timestampValidBits, 1u);
+			int64_t deltaTicks = static_cast<int64_t>((beginTicks - gpuClockTicks) << unusedBits) >> unusedBits;
+			uint64_t beginNs = gpuClockHostNs + static_cast<int64_t>(static_cast<double>(deltaTicks) * timestampPeriod);
+			Tracer::RecordGpu("GPU frame", beginNs, beginNs + static_cast<uint64_t>(static_cast<double>(elapsedTicks) * timestampPeriod));
+		}
+		void CalibrateGpuClock(uint64_t beginTicks, uint64_t submitNs)
+		{
+			gpuClockFrame = frameNumber;
+			if(deviceCaps.calibratedTimestamps)
+			{
+				//one GPU tick and one CLOCK_MONOTONIC reading taken together, the trace clock is CLOCK_MONOTONIC
+				std::array infos{vk::CalibratedTimestampInfoKHR(vk::TimeDomainKHR::eDevice), vk::CalibratedTimestampInfoKHR(vk::TimeDomainKHR::eClockMonotonic)};
+				auto [timestamps, maxDeviation] = device.getCalibratedTimestampsKHR(infos);
+				uint64_t mask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+				gpuClockTicks	= timestamps[0] & mask;
+				gpuClockHostNs	= timestamps[1];
+				return;
+			}
+			//without calibration the first traced frame is assumed to start on the GPU when it was submitted
+			gpuClockTicks	= beginTicks;
+			gpuClockHostNs	= submitNs;
+		}
+		void Present(uint32_t imageIndex)
+		{
+			TRACE_ZONE("presentKHR");
 			vk::PresentInfoKHR presentInfoKHR;
 			presentInfoKHR.waitSemaphoreCount 	= 1;
 			presentInfoKHR.pWaitSemaphores		= &*renderFinishedSemaphores[imageIndex];
 			presentInfoKHR.swapchainCount		= 1;
 			presentInfoKHR.pSwapchains			= &*swapChain;
 			presentInfoKHR.pImageIndices		= &imageIndex;
-			result = queue.presentKHR(presentInfoKHR);
-			if((result == vk::Result::eSuboptimalKHR) || (result == vk::Result::eErrorOutOfDateKHR) || framebufferResized)
+			//tags the present so the latency waiter can tell when it is on screen
+			uint64_t presentId = 0;
+			vk::PresentIdKHR presentIdInfo;
+			if(presentLatency.IsEnabled())
+			{
+				presentId						= presentLatency.NextId();
+				presentIdInfo.swapchainCount	= 1;
+				presentIdInfo.pPresentIds		= &presentId;
+				presentInfoKHR.pNext			= &presentIdInfo;
+			}
+			auto swapChainLock = presentLatency.LockSwapChain();
+			vk::Result result = queue.presentKHR(presentInfoKHR);
+			swapChainLock = {};
+			if(presentId != 0 && (result == vk::Result::eSuccess || result == vk::Result::eSuboptimalKHR))
+				presentLatency.Presented(*swapChain, presentId, inputSampleNs);
+			if((result == vk::Result::eSuboptimalKHR) || (result == vk::Result::eErrorOutOfDateKHR) || framebufferResized || presentModeChanged)
 			{
 				framebufferResized =false;
+				presentModeChanged = false;
 				ReCreateSwapChain();
 			}
 			else
 			{
 				assert(result == vk::Result::eSuccess);
 			}
-			frameIndex = (frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
-			
 		}
 		void Destroy(){
+			//let queued variants land in the cache before it is written
+			pipelineRegistry.Clear();
+			if(!options.pipelineCachePath.empty())
+				pipelineCache.Save();
+			if(window == nullptr)
+				return;
 			glfwDestroyWindow(window);
 			glfwTerminate();
 		}
-		void CleanupSwapChain()
+		//next present mode the surface supports, applied after the next present
+		void CyclePresentMode()
 		{
-			swapChainImageViews.clear();
-			swapChain = nullptr;
+			auto available = physicalDevice.getSurfacePresentModesKHR(*surface);
+			constexpr uint32_t modeCount = static_cast<uint32_t>(PresentMode::Count);
+			for(uint32_t i = 1; i <= modeCount; i++)
+			{
+				auto mode = static_cast<PresentMode>((static_cast<uint32_t>(options.presentMode) + i) % modeCount);
+				if(std::ranges::find(available, ToVkPresentMode(mode)) != available.end())
+				{
+					options.presentMode = mode;
+					break;
+				}
+			}
+			presentModeChanged = true;
 		}
 		void ReCreateSwapChain()
 		{
@@ -168,16 +657,39 @@ class TriangleVulkan
 				glfwGetFramebufferSize(window, &w, &h);
 				glfwWaitEvents();
 			}
-			device.waitIdle();
-			CleanupSwapChain();
-			CreateSwapChain();
+			//no waitIdle, frames in flight keep running on the old swapchain.
+			//old presents are queued ahead of the next submit, so once the first frame
+			//on the new swapchain completes nothing references the old objects anymore
+			uint64_t retireValue = submittedFrameValue + 1;
+			uint32_t oldImageCount = static_cast<uint32_t>(swapChainImages.size());
+			deletionQueue.Push(retireValue, std::move(swapChainImageViews));
+			swapChainImageViews.clear();
+			if(presentLatency.IsEnabled())
+				presentLatency.Retire(*swapChain);
+			vk::raii::SwapchainKHR oldSwapChain = std::move(swapChain);
+			swapChainImages.clear();
+			CreateSwapChain(*oldSwapChain);
+			deletionQueue.Push(retireValue, std::move(oldSwapChain));
 			CreateImageViews();
+			//one render finished semaphore per image, a present may still wait on the old ones
+			if(swapChainImages.size() != oldImageCount)
+			{
+				deletionQueue.Push(retireValue, std::move(renderFinishedSemaphores));
+				renderFinishedSemaphores.clear();
+				for(size_t i = 0; i < swapChainImages.size(); i++)
+					renderFinishedSemaphores.emplace_back(device, vk::SemaphoreCreateInfo());
+			}
 		}
 		//
 		std::vector<const char*> GetRequiredInstanceExtensions(){
-			uint32_t glfwExtensionCount = 0;
-			auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-			std::vector extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+			std::vector<const char*> extensions;
+			if(!options.headless)
+			{
+				//surface extensions only make sense with a window
+				uint32_t glfwExtensionCount = 0;
+				auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+				extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+			}
 			if(enableValidationLayers)
 				extensions.push_back(vk::EXTDebugUtilsExtensionName);
 			return extensions;
@@ -207,117 +719,253 @@ class TriangleVulkan
 		}
 		void SetupPhysicalDevice(){
 			std::vector<vk::raii::PhysicalDevice> devices = instance.enumeratePhysicalDevices();
-			//람다식을 사용해서 그래픽카드와 큐패밀리 확인
-			const auto devIter = std::ranges::find_if(devices,[&](auto const& device){
-				if(enableValidationLayers){
-					auto props = device.getProperties();
-					std::cerr<<"Device: " << props.deviceName << std::endl;;
-
-					std::cerr<<"Vulkan Version: " 	<<VK_VERSION_MAJOR(props.apiVersion)<<"."
-													<<VK_VERSION_MINOR(props.apiVersion)<<"."
-													<<VK_VERSION_PATCH(props.apiVersion)<<std::endl;
-					//
-					auto queProps = device.getQueueFamilyProperties();
-					int count = 0;
-					std::ranges::for_each(queProps,[&count](auto const& queProp){
-						std::string flags;
-						if(queProp.queueFlags & vk::QueueFlagBits::eGraphics)
-							flags += "Graphics ";
-						if(queProp.queueFlags & vk::QueueFlagBits::eCompute)
-							flags += "Compute ";
-						if(queProp.queueFlags & vk::QueueFlagBits::eTransfer)
-							flags += "Transfer ";
-						std::cerr<<"Queue Family["<< count <<"] " <<"Count: " << queProp.queueCount << " | Flags: " << flags << std::endl;
-						count += 1;
-					});					
-				}
-				bool supportsVulkan1_3 = device.getProperties().apiVersion >= VK_API_VERSION_1_3;
-				auto queueFamilies = device.getQueueFamilyProperties();
-				bool supportsGraphics = std::ranges::any_of(queueFamilies,[](auto const& qfp){return !!(qfp.queueFlags & vk::QueueFlagBits::eGraphics);});
-				auto availableDeviceExtensions = device.enumerateDeviceExtensionProperties();
+			//checks go from cheap to expensive and stop at the first failing one; the first suitable
+			//device ends the search and keeps what was queried for the rest of the setup
+			for(auto const& candidate : devices)
+			{
+				DeviceCaps caps;
+				caps.properties		= candidate.getProperties();
+				caps.queueFamilies	= candidate.getQueueFamilyProperties();
+				if(enableValidationLayers)
+					LogDevice(caps);
+				if(caps.properties.apiVersion < VK_API_VERSION_1_3)
+					continue;
+				if(std::ranges::none_of(caps.queueFamilies,[](auto const& qfp){return !!(qfp.queueFlags & vk::QueueFlagBits::eGraphics);}))
+					continue;
+				auto availableDeviceExtensions = candidate.enumerateDeviceExtensionProperties();
 				bool supportsAllRequiredExtensions = std::ranges::all_of(requiredDeviceExtension,[&availableDeviceExtensions](auto const&requiredDeviceExtension){return std::ranges::any_of(availableDeviceExtensions,[requiredDeviceExtension](auto const& availableDeviceExtension){return strcmp(availableDeviceExtension.extensionName, requiredDeviceExtension) == 0;});});
-                auto features = device.template getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
-                bool supportsRequiredFeatures = features.template get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters &&
+				if(!supportsAllRequiredExtensions)
+					continue;
+				auto features = candidate.template getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+				auto const& features12 = features.template get<vk::PhysicalDeviceVulkan12Features>();
+				//bindless: descriptor indexing with update-after-bind plus buffer device addresses
+				bool supportsBindless = features12.bufferDeviceAddress && features12.descriptorIndexing && features12.runtimeDescriptorArray &&
+										features12.descriptorBindingPartiallyBound && features12.descriptorBindingUpdateUnusedWhilePending &&
+										features12.descriptorBindingSampledImageUpdateAfterBind && features12.descriptorBindingStorageBufferUpdateAfterBind &&
+										features12.shaderSampledImageArrayNonUniformIndexing && features12.shaderStorageBufferArrayNonUniformIndexing;
+				bool supportsRequiredFeatures = features.template get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters &&
+												features12.timelineSemaphore &&
+												supportsBindless &&
 												features.template get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering &&
 												features.template get<vk::PhysicalDeviceVulkan13Features>().synchronization2 &&
 												features.template get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState;
-                return supportsVulkan1_3 && supportsGraphics && supportsAllRequiredExtensions && supportsRequiredFeatures;
+				if(!supportsRequiredFeatures)
+					continue;
+				caps.drawIndirectCount = features12.drawIndirectCount;
+				if(options.gpuDriven && !caps.drawIndirectCount)
+					continue;
+				caps.features	= features.template get<vk::PhysicalDeviceFeatures2>().features;
+				caps.calibratedTimestamps = std::ranges::any_of(availableDeviceExtensions,[](auto const& extension){return strcmp(extension.extensionName, vk::KHRCalibratedTimestampsExtensionName) == 0;});
+				caps.memoryBudget = std::ranges::any_of(availableDeviceExtensions,[](auto const& extension){return strcmp(extension.extensionName, vk::EXTMemoryBudgetExtensionName) == 0;});
+				//only a window presents, the feature structs are only valid to query with both extensions
+				if(!options.headless &&
+				   std::ranges::any_of(availableDeviceExtensions,[](auto const& extension){return strcmp(extension.extensionName, vk::KHRPresentIdExtensionName) == 0;}) &&
+				   std::ranges::any_of(availableDeviceExtensions,[](auto const& extension){return strcmp(extension.extensionName, vk::KHRPresentWaitExtensionName) == 0;}))
+				{
+					auto presentFeatures = candidate.template getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+					caps.presentWait = presentFeatures.template get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+									   presentFeatures.template get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+				}
+				physicalDevice	= candidate;
+				deviceCaps		= std::move(caps);
+				return;
+			}
+			if(options.gpuDriven)
+				throw std::runtime_error("failed to find a suitable GPU with drawIndirectCount for --gpu-driven!");
+			throw std::runtime_error("failed to find a suitable GPU!");
+		}
+		static void LogDevice(const DeviceCaps& caps)
+		{
+			std::cerr<<"Device: " << caps.properties.deviceName << std::endl;;
+
+			std::cerr<<"Vulkan Version: " 	<<VK_VERSION_MAJOR(caps.properties.apiVersion)<<"."
+											<<VK_VERSION_MINOR(caps.properties.apiVersion)<<"."
+											<<VK_VERSION_PATCH(caps.properties.apiVersion)<<std::endl;
+			int count = 0;
+			std::ranges::for_each(caps.queueFamilies,[&count](auto const& queProp){
+				std::string flags;
+				if(queProp.queueFlags & vk::QueueFlagBits::eGraphics)
+					flags += "Graphics ";
+				if(queProp.queueFlags & vk::QueueFlagBits::eCompute)
+					flags += "Compute ";
+				if(queProp.queueFlags & vk::QueueFlagBits::eTransfer)
+					flags += "Transfer ";
+				std::cerr<<"Queue Family["<< count <<"] " <<"Count: " << queProp.queueCount << " | Flags: " << flags << std::endl;
+				count += 1;
 			});
-			if (devIter != devices.end())
-				physicalDevice = *devIter;
-			else
-				throw std::runtime_error("failed to find a suitable GPU!");
 		}
 		void CreateLogicalDevice(){
-			std::vector<vk::QueueFamilyProperties> queueFamilyProperties = physicalDevice.getQueueFamilyProperties();
+			const std::vector<vk::QueueFamilyProperties>& queueFamilyProperties = deviceCaps.queueFamilies;
 			auto graphicsQueueFamilyProperty = std::ranges::find_if(queueFamilyProperties,[](auto const&qfp){return (qfp.queueFlags & vk::QueueFlagBits::eGraphics) != static_cast<vk::QueueFlags>(0);});
 			assert(graphicsQueueFamilyProperty != queueFamilyProperties.end() && "No graphics queue family found!");
 			queueIndex = static_cast<uint32_t>(std::distance(queueFamilyProperties.begin(), graphicsQueueFamilyProperty));
 			if(queueIndex == ~0)
 				throw std::runtime_error("Colud not find a queue for graphics and present -> terminating");
+			//uploads prefer a transfer only family (DMA engine) so they never compete with graphics work
+			auto transferQueueFamilyProperty = std::ranges::find_if(queueFamilyProperties,[](auto const&qfp){
+				return (qfp.queueFlags & vk::QueueFlagBits::eTransfer) && !(qfp.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));});
+			transferQueueIndex = transferQueueFamilyProperty != queueFamilyProperties.end() ?
+									static_cast<uint32_t>(std::distance(queueFamilyProperties.begin(), transferQueueFamilyProperty)) : queueIndex;
 
 			//query vulakn
 			vk::PhysicalDeviceVulkan11Features pv11;
 			pv11.shaderDrawParameters = true;
+			vk::PhysicalDeviceVulkan12Features pv12;
+			pv12.timelineSemaphore = true;
+			//optional, the GPU driven path requires it at device selection
+			pv12.drawIndirectCount = deviceCaps.drawIndirectCount;
+			pv12.bufferDeviceAddress = true;
+			pv12.descriptorIndexing = true;
+			pv12.runtimeDescriptorArray = true;
+			pv12.descriptorBindingPartiallyBound = true;
+			pv12.descriptorBindingUpdateUnusedWhilePending = true;
+			pv12.descriptorBindingSampledImageUpdateAfterBind = true;
+			pv12.descriptorBindingStorageBufferUpdateAfterBind = true;
+			pv12.shaderSampledImageArrayNonUniformIndexing = true;
+			pv12.shaderStorageBufferArrayNonUniformIndexing = true;
 			vk::PhysicalDeviceVulkan13Features pv13;
 			pv13.dynamicRendering = true;
 			pv13.synchronization2 = true;
 			vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT pded;
 			pded.extendedDynamicState = true;
-			vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT> featureChain =
+			//optional, the texture streamer falls back to RGBA8 without it
+			vk::PhysicalDeviceFeatures2 pf2;
+			pf2.features.textureCompressionBC = deviceCaps.features.textureCompressionBC;
+			//optional, latency measurement only
+			vk::PhysicalDevicePresentIdFeaturesKHR ppid;
+			ppid.presentId = true;
+			vk::PhysicalDevicePresentWaitFeaturesKHR ppw;
+			ppw.presentWait = true;
+			vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT,
+							   vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR> featureChain =
 			{
-				{},
+				pf2,
 				pv11,
+				pv12,
 				pv13,
-				pded
+				pded,
+				ppid,
+				ppw
 			};
+			if(!deviceCaps.presentWait)
+			{
+				featureChain.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+				featureChain.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+			}
 			// create a Device
-			float queuePriority = 0.5f;
-			vk::DeviceQueueCreateInfo deviceQueueCreateInfo;
-			deviceQueueCreateInfo.queueFamilyIndex = queueIndex;
-			deviceQueueCreateInfo.queueCount = 1;
-			deviceQueueCreateInfo.pQueuePriorities = &queuePriority;
+			//the render server spreads its jobs over several queues of the graphics family
+			uint32_t graphicsQueueCount = 1;
+			if(!options.servePath.empty())
+				graphicsQueueCount = std::min(options.serveQueues != 0 ? options.serveQueues : ~0u, queueFamilyProperties[queueIndex].queueCount);
+			std::vector<float> queuePriorities(graphicsQueueCount, 0.5f);
+			std::vector<vk::DeviceQueueCreateInfo> deviceQueueCreateInfos;
+			for(uint32_t family : {queueIndex, transferQueueIndex})
+			{
+				if(std::ranges::any_of(deviceQueueCreateInfos, [family](auto const& info){return info.queueFamilyIndex == family;}))
+					continue;
+				vk::DeviceQueueCreateInfo deviceQueueCreateInfo;
+				deviceQueueCreateInfo.queueFamilyIndex = family;
+				deviceQueueCreateInfo.queueCount = family == queueIndex ? graphicsQueueCount : 1;
+				deviceQueueCreateInfo.pQueuePriorities = queuePriorities.data();
+				deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);
+			}
+
+			//optional: GPU trace spans line up exactly with calibrated timestamps
+			std::vector<const char*> deviceExtensions = requiredDeviceExtension;
+			if(deviceCaps.calibratedTimestamps && Tracer::IsEnabled())
+			{
+				auto domains = physicalDevice.getCalibrateableTimeDomainsKHR();
+				deviceCaps.calibratedTimestamps = std::ranges::find(domains, vk::TimeDomainKHR::eDevice) != domains.end() &&
+												  std::ranges::find(domains, vk::TimeDomainKHR::eClockMonotonic) != domains.end();
+			}
+			else
+				deviceCaps.calibratedTimestamps = false;
+			if(deviceCaps.calibratedTimestamps)
+				deviceExtensions.push_back(vk::KHRCalibratedTimestampsExtensionName);
+			if(deviceCaps.memoryBudget)
+				deviceExtensions.push_back(vk::EXTMemoryBudgetExtensionName);
+			if(deviceCaps.presentWait)
+			{
+				deviceExtensions.push_back(vk::KHRPresentIdExtensionName);
+				deviceExtensions.push_back(vk::KHRPresentWaitExtensionName);
+			}
 
 			vk::DeviceCreateInfo deviceCreateInfo;
-			deviceCreateInfo.queueCreateInfoCount = 1;
-			deviceCreateInfo.pQueueCreateInfos = &deviceQueueCreateInfo;
-			deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(requiredDeviceExtension.size());
-			deviceCreateInfo.ppEnabledExtensionNames = requiredDeviceExtension.data();
+			deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(deviceQueueCreateInfos.size());
+			deviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfos.data();
+			deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+			deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 			deviceCreateInfo.pNext = &featureChain.get<vk::PhysicalDeviceFeatures2>();
 
 			device = vk::raii::Device(physicalDevice, deviceCreateInfo);
 			queue = vk::raii::Queue(device, queueIndex, 0);
+			transferQueue = vk::raii::Queue(device, transferQueueIndex, 0);
+			if(!options.servePath.empty())
+			{
+				for(uint32_t i = 0; i < graphicsQueueCount; i++)
+					serverQueues.emplace_back(device, queueIndex, i);
+			}
+			if(deviceCaps.presentWait)
+				presentLatency.Start(device);
 		}
-		void CreateSwapChain(){
+		void CreateSwapChain(vk::SwapchainKHR oldSwapChain = nullptr){
 			auto surfaceCapabilities = physicalDevice.getSurfaceCapabilitiesKHR(*surface);
 			swapChainExtent = SelectSwapExtend(surfaceCapabilities);
-			swapChainSurfaceFormat = SelectSwapSurfaceFormat(physicalDevice.getSurfaceFormatsKHR(*surface));
 			vk::SwapchainCreateInfoKHR swapChainCreateInfo{};
 			swapChainCreateInfo.surface = *surface;
-			swapChainCreateInfo.minImageCount = SelectSwapMinImageCount(surfaceCapabilities);
+			swapChainCreateInfo.minImageCount = SelectSwapMinImageCount(surfaceCapabilities, options.swapchainImages);
 			swapChainCreateInfo.imageFormat = swapChainSurfaceFormat.format;
 			swapChainCreateInfo.imageColorSpace = swapChainSurfaceFormat.colorSpace;
 			swapChainCreateInfo.imageExtent = swapChainExtent;
 			swapChainCreateInfo.imageArrayLayers = 1;
 			swapChainCreateInfo.imageUsage =vk::ImageUsageFlagBits::eColorAttachment;
+			//frame capture copies out of the swapchain images
+			if(!options.capturePath.empty())
+			{
+				if(!(surfaceCapabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc))
+					throw std::runtime_error("capture: the surface does not support copying from swapchain images");
+				swapChainCreateInfo.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+			}
+			//the scaled scene is blitted into the swapchain image
+			if(dynamicResolution.IsEnabled())
+				swapChainCreateInfo.imageUsage |= vk::ImageUsageFlagBits::eTransferDst;
 			swapChainCreateInfo.imageSharingMode = vk::SharingMode::eExclusive;
 			swapChainCreateInfo.preTransform = surfaceCapabilities.currentTransform;
 			swapChainCreateInfo.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
-			swapChainCreateInfo.presentMode = SelectSwapPresentMode(physicalDevice.getSurfacePresentModesKHR(*surface));
+			swapChainCreateInfo.presentMode = SelectSwapPresentMode(physicalDevice.getSurfacePresentModesKHR(*surface), options.presentMode);
+			swapChainPresentMode = vk::to_string(swapChainCreateInfo.presentMode);
 			swapChainCreateInfo.clipped = true;
+			//lets the driver hand resources over instead of waiting for the old chain to drain
+			swapChainCreateInfo.oldSwapchain = oldSwapChain;
 			swapChain = vk::raii::SwapchainKHR(device, swapChainCreateInfo);
 			swapChainImages = swapChain.getImages();
 		}
-		static vk::PresentModeKHR SelectSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes)
+		static vk::PresentModeKHR ToVkPresentMode(PresentMode mode)
+		{
+			switch(mode)
+			{
+				case PresentMode::Immediate:	return vk::PresentModeKHR::eImmediate;
+				case PresentMode::Mailbox:		return vk::PresentModeKHR::eMailbox;
+				case PresentMode::FifoRelaxed:	return vk::PresentModeKHR::eFifoRelaxed;
+				default:						return vk::PresentModeKHR::eFifo;
+			}
+		}
+		//the requested mode, else the next one towards FIFO that does not tear more: immediate falls back
+		//to mailbox, everything else to FIFO, which every surface supports
+		static vk::PresentModeKHR SelectSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes, PresentMode requested)
 		{
 			assert(std::ranges::any_of(availablePresentModes,[](auto presentMode){ return presentMode == vk::PresentModeKHR::eFifo;}));
-			return std::ranges::any_of(availablePresentModes,[](const vk::PresentModeKHR value){
-				return vk::PresentModeKHR::eMailbox == value;}) ? vk::PresentModeKHR::eMailbox : vk::PresentModeKHR::eFifo;
+			auto available = [&](vk::PresentModeKHR mode){ return std::ranges::find(availablePresentModes, mode) != availablePresentModes.end(); };
+			if(available(ToVkPresentMode(requested)))
+				return ToVkPresentMode(requested);
+			vk::PresentModeKHR fallback = requested == PresentMode::Immediate && available(vk::PresentModeKHR::eMailbox) ? vk::PresentModeKHR::eMailbox : vk::PresentModeKHR::eFifo;
+			std::cerr << "present mode " << ToString(requested) << " is not supported, using " << vk::to_string(fallback) << std::endl;
+			return fallback;
 		}
 
-		static uint32_t SelectSwapMinImageCount(vk::SurfaceCapabilitiesKHR const& surfaceCapabilities)
+		static uint32_t SelectSwapMinImageCount(vk::SurfaceCapabilitiesKHR const& surfaceCapabilities, uint32_t requested)
 		{
-			auto minImageCount = std::max(3u, surfaceCapabilities.minImageCount);
+			auto minImageCount = std::max(requested, surfaceCapabilities.minImageCount);
 			if((0 < surfaceCapabilities.maxImageCount) && (surfaceCapabilities.maxImageCount < minImageCount))
 				minImageCount = surfaceCapabilities.maxImageCount;
 			return minImageCount;
@@ -340,6 +988,58 @@ class TriangleVulkan
 				std::clamp<uint32_t>(width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width),
 				std::clamp<uint32_t>(height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height)};
 		}
+		//D32 where it can be an attachment, D16 is always supported
+		vk::Format SelectDepthFormat() const
+		{
+			vk::FormatProperties properties = physicalDevice.getFormatProperties(vk::Format::eD32Sfloat);
+			if(properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+				return vk::Format::eD32Sfloat;
+			return vk::Format::eD16Unorm;
+		}
+		//the upscale blit needs timestamps to steer by and a linearly filtered blit between targets of the surface format
+		void InitDynamicResolution()
+		{
+			if(options.gpuBudgetMs <= 0.0f)
+				return;
+			auto disabled = [](const char* reason){ std::cerr << "dynamic resolution disabled: " << reason << std::endl; };
+			vk::FormatFeatureFlags blitFeatures = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+			if(deviceCaps.queueFamilies[queueIndex].timestampValidBits == 0)
+				return disabled("the queue has no timestamps");
+			if((physicalDevice.getFormatProperties(swapChainSurfaceFormat.format).optimalTilingFeatures & blitFeatures) != blitFeatures)
+				return disabled("the color format cannot be blitted with a linear filter");
+			if(!options.headless && !(physicalDevice.getSurfaceCapabilitiesKHR(*surface).supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst))
+				return disabled("the swapchain images cannot be blitted to");
+			DynamicResolutionConfig config;
+			config.gpuBudgetMs	= options.gpuBudgetMs;
+			config.minScale		= options.renderScaleMin;
+			config.maxScale		= options.renderScaleMax;
+			dynamicResolution.Init(config);
+		}
+		void CreateOffscreenTargets()
+		{
+			assert(swapChainImages.empty() && swapChainImageViews.empty());
+			swapChainExtent = vk::Extent2D{options.width, options.height};
+			vk::ImageCreateInfo imageInfo;
+			imageInfo.imageType		= vk::ImageType::e2D;
+			imageInfo.format		= swapChainSurfaceFormat.format;
+			imageInfo.extent		= vk::Extent3D{swapChainExtent.width, swapChainExtent.height, 1};
+			imageInfo.mipLevels		= 1;
+			imageInfo.arrayLayers	= 1;
+			imageInfo.samples		= vk::SampleCountFlagBits::e1;
+			imageInfo.tiling		= vk::ImageTiling::eOptimal;
+			imageInfo.usage			= vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+			if(dynamicResolution.IsEnabled())
+				imageInfo.usage		|= vk::ImageUsageFlagBits::eTransferDst;
+			imageInfo.sharingMode	= vk::SharingMode::eExclusive;
+			imageInfo.initialLayout	= vk::ImageLayout::eUndefined;
+			//one target per frame in flight, DrawFrame renders into frameIndex
+			for(size_t i = 0; i < options.framesInFlight; i++)
+			{
+				auto& image = offscreenImages.emplace_back(gpuAllocator.CreateImage(imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal));
+				swapChainImages.push_back(*image);
+			}
+			CreateImageViews();
+		}
 		void CreateImageViews()
 		{
 			assert(swapChainImageViews.empty());
@@ -353,197 +1053,453 @@ class TriangleVulkan
 				swapChainImageViews.emplace_back(device, imageViewCreateinfo);
 			}
 		}
-		void CreateGraphicsPipeline()
+		//the layouts and culler buffers, on the main thread since they allocate
+		void CreatePipelineLayout()
 		{
-			vk::raii::ShaderModule shaderModule = CreateShaderModule(readFile("./slang.spv"));
-			vk::PipelineShaderStageCreateInfo vertShaderStageInfo{};
-			vertShaderStageInfo.stage = vk::ShaderStageFlagBits::eVertex;
-			vertShaderStageInfo.module = shaderModule,
-			vertShaderStageInfo.pName = "vertMain";
-			
-			vk::PipelineShaderStageCreateInfo fragShaderStageInfo{};
-			fragShaderStageInfo.stage = vk::ShaderStageFlagBits::eFragment;
-			fragShaderStageInfo.module = shaderModule;
-			fragShaderStageInfo.pName = "fragMain";
-			
-			vk::PipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-			//vertexMerge
-			vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
-			vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
-			inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
-			
-			vk::PipelineViewportStateCreateInfo viewportState;
-			viewportState.viewportCount = 1;
-			viewportState.scissorCount = 1;
-
-			vk::PipelineRasterizationStateCreateInfo rasterizer;
-			rasterizer.depthClampEnable = vk::False;
-			rasterizer.rasterizerDiscardEnable = vk::False;
-			rasterizer.polygonMode = vk::PolygonMode::eFill;
-			rasterizer.cullMode = vk::CullModeFlagBits::eBack;
-			rasterizer.frontFace = vk::FrontFace::eClockwise;
-			rasterizer.depthBiasEnable = vk::False;
-			rasterizer.depthBiasSlopeFactor = 1.0f;
-			rasterizer.lineWidth = 1.0f;
-
-			vk::PipelineMultisampleStateCreateInfo multisampling;
-			multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
-			multisampling.sampleShadingEnable = vk::False;
-
-			vk::PipelineColorBlendAttachmentState colorBlendAttachemnt;
-			colorBlendAttachemnt.blendEnable = vk::False;
-			colorBlendAttachemnt.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-			
-			vk::PipelineColorBlendStateCreateInfo colorBlending;
-			colorBlending.logicOpEnable = vk::False;
-			colorBlending.logicOp = vk::LogicOp::eCopy;
-			colorBlending.attachmentCount = 1;
-			colorBlending.pAttachments = &colorBlendAttachemnt;
-
-			std::vector dynamicStates={
-				vk::DynamicState::eViewport,
-				vk::DynamicState::eScissor
-			};
-			vk::PipelineDynamicStateCreateInfo dynamicState;
-			dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-			dynamicState.pDynamicStates = dynamicStates.data();
-
+			//everything reaches its data through the bindless set and the push constants
+			vk::DescriptorSetLayout globalSetLayout = bindless.SetLayout();
+			vk::PushConstantRange pushConstantRange(DRAW_CONSTANT_STAGES, 0, sizeof(DrawConstants));
 			vk::PipelineLayoutCreateInfo pipeLineLayoutInfo;
+			pipeLineLayoutInfo.setLayoutCount			= 1;
+			pipeLineLayoutInfo.pSetLayouts				= &globalSetLayout;
+			pipeLineLayoutInfo.pushConstantRangeCount	= 1;
+			pipeLineLayoutInfo.pPushConstantRanges		= &pushConstantRange;
 			pipeLineLayout = vk::raii::PipelineLayout(device, pipeLineLayoutInfo);
+			if(options.gpuDriven)
+				instanceCuller.Init(physicalDevice, device, gpuAllocator, transferUploader, globalSetLayout, pushConstantRange, options.framesInFlight);
+		}
+		//runs on a worker during InitVulkan, touches nothing the main thread sets up meanwhile
+		void CreateGraphicsPipeline()
+		{
+			if(!options.pipelineCachePath.empty())
+				pipelineCache.Open(physicalDevice, device, options.pipelineCachePath);
+			//compiled at build time, see the Shaders section of CMakeLists.txt
+			shaderModule = CreateShaderModule(SHADER_SPIRV);
+			if(options.gpuDriven)
+				instanceCuller.CreatePipeline(*shaderModule, pipelineCache.Cache());
 
-			vk::GraphicsPipelineCreateInfo gpinfo;
-			gpinfo.stageCount = 2;
-			gpinfo.pStages = shaderStages;
-			gpinfo.pVertexInputState = &vertexInputInfo;
-			gpinfo.pInputAssemblyState = &inputAssembly;
-			gpinfo.pViewportState = &viewportState;
-			gpinfo.pRasterizationState = &rasterizer;
-			gpinfo.pMultisampleState = &multisampling;
-			gpinfo.pColorBlendState = &colorBlending;
-			gpinfo.pDynamicState = &dynamicState;
-			gpinfo.layout = pipeLineLayout;
-			gpinfo.renderPass = nullptr;
-
-			vk::PipelineRenderingCreateInfo pginfo;
-			pginfo.colorAttachmentCount = 1;
-			pginfo.pColorAttachmentFormats = &swapChainSurfaceFormat.format;
-
-			vk::StructureChain<vk::GraphicsPipelineCreateInfo, vk::PipelineRenderingCreateInfo> pipelineCreateInfoChain = {gpinfo, pginfo};
-			
-			grapicsPipeline = vk::raii::Pipeline(device, nullptr, pipelineCreateInfoChain.get<vk::GraphicsPipelineCreateInfo>());
+			pipelineRegistry.Init(device, pipelineCache.Cache(), options.pipelineThreads != 0 ? options.pipelineThreads : ThreadPool::DefaultThreadCount());
+			//the fallback has to exist before the first frame, everything else compiles in the background
+			auto start = std::chrono::steady_clock::now();
+			fallbackPipeline = pipelineRegistry.Build(CurrentPipelineDesc());
+			activePipeline = fallbackPipeline;
+			hudPipeline = pipelineRegistry.Build(HudPipelineDesc());
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			const char* cacheState = options.pipelineCachePath.empty() ? "disabled" : (pipelineCache.IsWarm() ? "warm" : "cold");
+			std::cout << "pipeline creation: " << ms << " ms (" << cacheState << " cache)" << std::endl;
+#ifdef SHADER_HOT_RELOAD
+			shaderWatcher = std::make_unique<ShaderWatcher>(SHADER_SOURCE_PATH, std::string("\"") + SLANGC_EXECUTABLE + "\" \"" + SHADER_SOURCE_PATH + "\" " + SLANGC_FLAGS);
+#endif
+			//prewarm the variants the key bindings switch between
+			for(vk::CullModeFlags cull : {vk::CullModeFlags(vk::CullModeFlagBits::eBack), vk::CullModeFlags(vk::CullModeFlagBits::eNone), vk::CullModeFlags(vk::CullModeFlagBits::eFront)})
+			{
+				for(BlendMode blend : {BlendMode::Opaque, BlendMode::Alpha, BlendMode::Additive})
+				{
+					pipelineRegistry.Request(PipelineDescFor(cull, blend));
+				}
+			}
+		}
+#ifdef SHADER_HOT_RELOAD
+		//dev builds only: the new module replaces every pipeline, draining the GPU is fine here
+		void ReloadShaders()
+		{
+			auto code = shaderWatcher->TakeUpdate();
+			if(!code)
+				return;
+			device.waitIdle();
+			pipelineRegistry.Clear();
+			shaderModule = CreateShaderModule(*code);
+			if(options.gpuDriven)
+				instanceCuller.CreatePipeline(*shaderModule, pipelineCache.Cache());
+			fallbackPipeline = pipelineRegistry.Build(CurrentPipelineDesc());
+			activePipeline = fallbackPipeline;
+			hudPipeline = pipelineRegistry.Build(HudPipelineDesc());
+		}
+#endif
+		PipelineDesc CurrentPipelineDesc() const
+		{
+			return PipelineDescFor(cullMode, blendMode);
+		}
+		PipelineDesc PipelineDescFor(vk::CullModeFlags cull, BlendMode blend) const
+		{
+			PipelineDesc desc;
+			desc.shaderModule	= *shaderModule;
+			desc.layout			= *pipeLineLayout;
+			if(options.gpuDriven)
+			{
+				desc.vertexEntry	= "vertInstanced";
+				desc.layout			= instanceCuller.PipelineLayout();
+			}
+			else if(!options.meshPath.empty())
+			{
+				//OBJ winding, LoadSceneMesh keeps it counter clockwise on screen
+				desc.vertexEntry	= "vertMesh";
+				desc.frontFace		= vk::FrontFace::eCounterClockwise;
+			}
+			desc.colorFormat	= swapChainSurfaceFormat.format;
+			desc.depthFormat	= depthFormat;
+			desc.cullMode		= cull;
+			desc.blendMode		= blend;
+			//variants are specialization constants of the same module
+			desc.shaderFeatures	= ShaderFeatureBit(ShaderFeature::VertexColor);
+			if(!options.texturePath.empty())
+				desc.shaderFeatures |= ShaderFeatureBit(ShaderFeature::Texture);
+			if(blend != BlendMode::Opaque)
+				desc.shaderFeatures |= ShaderFeatureBit(ShaderFeature::TintAlpha);
+			return desc;
+		}
+		PipelineDesc HudPipelineDesc() const
+		{
+			PipelineDesc desc;
+			desc.shaderModule	= *shaderModule;
+			desc.vertexEntry	= "vertHud";
+			desc.fragmentEntry	= "fragHud";
+			desc.layout			= *pipeLineLayout;
+			desc.colorFormat	= swapChainSurfaceFormat.format;
+			//tested against the cleared depth at z = 0, so always on top; with dynamic resolution
+			//it is drawn after the upscale, straight into the output without depth
+			desc.depthFormat	= dynamicResolution.IsEnabled() ? vk::Format::eUndefined : depthFormat;
+			desc.cullMode		= vk::CullModeFlagBits::eNone;
+			desc.blendMode		= BlendMode::Alpha;
+			desc.shaderFeatures	= 0;
+			return desc;
+		}
+		void SelectPipelineVariant()
+		{
+			//drawn with the fallback until the variant finished compiling
+			PipelineDesc desc = CurrentPipelineDesc();
+			pipelineRegistry.Request(desc);
+			activePipeline = desc.Hash();
+		}
+		void PrintPipelineStats() const
+		{
+			PipelineRegistryStats stats = pipelineRegistry.Stats();
+			std::cout << "pipelines: " << stats.compiled << "/" << stats.requested << " compiled, "
+					  << stats.failed << " failed, " << stats.pending << " pending, avg "
+					  << (stats.compiled > 0 ? stats.totalCompileMs / stats.compiled : 0.0) << " ms, max "
+					  << stats.maxCompileMs << " ms, " << stats.fallbackDraws << " fallback draws" << std::endl;
 		}
 		//반환값을 강제
-		[[nodiscard]] vk::raii::ShaderModule CreateShaderModule(const std::vector<char>& code) const
+		[[nodiscard]] vk::raii::ShaderModule CreateShaderModule(std::span<const uint32_t> code) const
 		{
 			vk::ShaderModuleCreateInfo createInfo{};
-			createInfo.codeSize = code.size() * sizeof(char);
-			createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+			createInfo.codeSize = code.size_bytes();
+			createInfo.pCode = code.data();
 			vk::raii::ShaderModule shaderModule{device, createInfo};
 			return shaderModule;
 		}
 		void CreateCommandPool()
 		{
-			vk::CommandPoolCreateInfo poolInfo;
-			poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-			poolInfo.queueFamilyIndex = queueIndex;
-			commandPool = vk::raii::CommandPool(device, poolInfo);
+			size_t recordThreads = options.recordThreads != 0 ? options.recordThreads : ThreadPool::DefaultThreadCount();
+			commandRecorder.Init(device, queueIndex, options.framesInFlight, recordThreads);
+		}
+		void BuildScene()
+		{
+			//a grid of triangles, one draw each
+			AddDrawGrid(scene, options.drawCount, options.meshPath.empty() ? TRIANGLE_RADIUS : MESH_RADIUS);
+			//updates and culls of large scenes are split across the pool, the recording threads are busy by then
+			if(!options.gpuDriven && options.drawCount >= 2 * CommandRecorder::MIN_ITEMS_PER_CHUNK)
+				scenePool = std::make_unique<ThreadPool>(ThreadPool::DefaultThreadCount());
+			scene.UpdateTransforms(scenePool.get());
+			if(options.gpuDriven)
+				UploadInstances();
+		}
+		void LoadSceneMesh()
+		{
+			auto start = std::chrono::steady_clock::now();
+			mesh = LoadMesh(options.meshPath, device, gpuAllocator, transferUploader);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::cout << "mesh: " << options.meshPath << ", " << mesh.indexCount / 3 << " triangles, " << mesh.meshletCount << " meshlets, "
+					  << mesh.fileBytes / (1024.0 * 1024.0) << " MiB staged in " << ms << " ms ("
+					  << mesh.fileBytes / (1024.0 * 1024.0) / std::max(ms / 1000.0, 1e-9) << " MiB/s)" << std::endl;
+			//quantized positions are in [-1, 1] per axis, scale them back to the mesh's proportions
+			//and fit the largest axis into the draw item; OBJ is y up, z lands inside [0.25, 0.75]
+			glm::vec3 halfExtent = (mesh.boundsMax - mesh.boundsMin) * 0.5f;
+			float largest = std::max({halfExtent.x, halfExtent.y, halfExtent.z, 1e-20f});
+			meshTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.5f)) *
+							glm::scale(glm::mat4(1.0f), glm::vec3(halfExtent.x, -halfExtent.y, 0.25f * halfExtent.z) / largest);
 		}
-		void CreateCommandBuffer()
+		void UploadInstances()
 		{
-			commandBuffers.clear();
-			vk::CommandBufferAllocateInfo allocInfo;
-			allocInfo.commandPool 	= commandPool;
-			allocInfo.level			= vk::CommandBufferLevel::ePrimary;
-			allocInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
-			commandBuffers = vk::raii::CommandBuffers(device, allocInfo);
+			std::vector<InstanceData> instances;
+			std::vector<glm::vec4> bounds;
+			instances.reserve(scene.Size());
+			bounds.reserve(scene.Size());
+			for(Scene::Node node = 0; node < scene.Size(); node++)
+			{
+				instances.push_back({scene.World(node), scene.Tint(node)});
+				bounds.push_back(scene.Bounds(node));
+			}
+			instanceCuller.Upload({0, 1, 2}, instances, bounds);
+		}
+		glm::mat4 CameraTransform() const
+		{
+			//zooms in and out so the cull pass has instances to reject
+			float zoom = 1.25f + 0.75f * std::sin(frameTime * 0.5f);
+			return glm::scale(glm::mat4(1.0f), glm::vec3(zoom, zoom, 1.0f));
+		}
+		//the whole scene in one indirect draw, culled by RecordCull earlier in the frame
+		void RecordInstancedDraw(const vk::raii::CommandBuffer& commandBuffer, const DrawConstants& constants)
+		{
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, framePipeline);
+			commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(frameRenderExtent.width), static_cast<float>(frameRenderExtent.height), 0.0f, 1.0f));
+			commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), frameRenderExtent));
+			bindless.Bind(commandBuffer, vk::PipelineBindPoint::eGraphics, instanceCuller.PipelineLayout());
+			commandBuffer.pushConstants<DrawConstants>(instanceCuller.PipelineLayout(), DRAW_CONSTANT_STAGES, 0, constants);
+			instanceCuller.RecordDraw(commandBuffer, frameIndex);
+		}
+		//records visible scene nodes [begin, end), called from the recording threads
+		void RecordDraws(const vk::raii::CommandBuffer& commandBuffer, size_t begin, size_t end)
+		{
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, framePipeline);
+			commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(frameRenderExtent.width), static_cast<float>(frameRenderExtent.height), 0.0f, 1.0f));
+			commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), frameRenderExtent));
+			//bound once, draws only change push constants
+			bindless.Bind(commandBuffer, vk::PipelineBindPoint::eGraphics, *pipeLineLayout);
+			//a loaded mesh replaces the triangle in every draw item once its upload has landed
+			bool useMesh = !options.meshPath.empty();
+			size_t drawEnd = useMesh && !frameMeshReady ? begin : end;
+			if(useMesh && drawEnd > begin)
+				commandBuffer.bindIndexBuffer(*mesh.indices, 0, vk::IndexType::eUint32);
+			for(size_t i = begin; i < drawEnd; i++)
+			{
+				Scene::Node node = visibleDraws[i];
+				FrameData frameData;
+				frameData.transform	= useMesh ? frameCamera * scene.World(node) * meshTransform : frameCamera * scene.World(node);
+				frameData.tint		= scene.Tint(node);
+				frameData.time		= frameTime;
+				DrawConstants constants;
+				constants.frameData	= uploadRing.DeviceAddress() + uploadRing.Push(frameData).offset;
+				constants.vertices	= useMesh ? mesh.vertexAddress : 0;
+				constants.textureIndex	= frameTextureIndex;
+				constants.samplerIndex	= textureStreamer.SamplerIndex();
+				commandBuffer.pushConstants<DrawConstants>(*pipeLineLayout, DRAW_CONSTANT_STAGES, 0, constants);
+				if(useMesh)
+					commandBuffer.drawIndexed(mesh.indexCount, 1, 0, 0, 0);
+				else
+					commandBuffer.draw(3, 1, 0, 0);
+			}
+			//the last chunk draws the HUD on top of the scene, a scaled scene gets it after the upscale
+			if(end == visibleDraws.size() && !frameScaled)
+				hud.Record(commandBuffer, uploadRing, frameHudPipeline, *pipeLineLayout);
 		}
 		void RecordCommandBuffer(uint32_t imageIndex)
 		{
-			auto& commandBuffer = commandBuffers[frameIndex];
+			TRACE_ZONE("RecordCommandBuffer");
+			auto& commandBuffer = commandRecorder.Primary();
 			commandBuffer.begin({});
-			TranstionImageLayout(
-									imageIndex,
-									vk::ImageLayout::eUndefined,
-									vk::ImageLayout::eColorAttachmentOptimal,
-									{},
-									vk::AccessFlagBits2::eColorAttachmentWrite,
-									vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-									vk::PipelineStageFlagBits2::eColorAttachmentOutput);
-			vk::ClearValue clearColor = vk::ClearColorValue(1.0f, 1.0f, 1.0f, 1.0f);
+			transferWaitValue = transferUploader.RecordAcquireBarriers(commandBuffer);
+			if(*timestampQueryPool)
+			{
+				commandBuffer.resetQueryPool(*timestampQueryPool, TIMESTAMPS_PER_FRAME * frameIndex, TIMESTAMPS_PER_FRAME);
+				commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *timestampQueryPool, TIMESTAMPS_PER_FRAME * frameIndex);
+			}
+			framePipeline	= pipelineRegistry.Resolve(activePipeline, fallbackPipeline);
+			frameHudPipeline = pipelineRegistry.Resolve(hudPipeline, hudPipeline);
+			frameTime		= std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+			frameMeshReady	= mesh.indexCount > 0 && transferUploader.IsAvailable(mesh.ticket);
+			//resolved once per frame, the recording threads only read it
+			frameTextureIndex = textureStreamer.DescriptorIndex(texture);
+
+			//a scaled scene renders into a target sized for the largest scale, only this frame's
+			//region of it is used, so scale changes never reallocate it
+			frameScaled			= dynamicResolution.IsEnabled();
+			frameRenderExtent	= frameScaled ? dynamicResolution.RenderExtent(swapChainExtent) : swapChainExtent;
+			vk::Extent2D sceneExtent = frameScaled ? dynamicResolution.TargetExtent(swapChainExtent) : swapChainExtent;
+
+			//the graph places every barrier of the frame, passes only record their own work
+			renderGraph.Reset();
+			ImportedImage target;
+			target.image			= swapChainImages[imageIndex];
+			target.view				= *swapChainImageViews[imageIndex];
+			//the acquire semaphore is waited on at this stage
+			target.initialStages	= AcquireWaitStages();
+			target.finalUsage		= options.headless ? ResourceUsage::TransferSrc : ResourceUsage::Present;
+			RenderGraph::Resource output = renderGraph.ImportImage("output", target);
+			RenderGraph::Resource color = frameScaled ? renderGraph.CreateImage("scene color", {swapChainSurfaceFormat.format, sceneExtent, vk::ImageAspectFlagBits::eColor}) : output;
+			RenderGraph::Resource depth = renderGraph.CreateImage("depth", {depthFormat, sceneExtent, vk::ImageAspectFlagBits::eDepth});
+			//nothing is drawn until the instance upload has landed
+			bool gpuDriven = options.gpuDriven && instanceCuller.IsReady();
+			if(gpuDriven)
+			{
+				RenderGraph::Resource drawArgs	= renderGraph.ImportBuffer("draw args", instanceCuller.DrawArgsRange(frameIndex));
+				RenderGraph::Resource visible	= renderGraph.ImportBuffer("visible instances", instanceCuller.VisibleRange(frameIndex));
+				FrameData frameData;
+				frameData.transform		= CameraTransform();
+				frameData.time			= frameTime;
+				frameData.instanceCount	= instanceCuller.InstanceCount();
+				frameConstants.frameData	= uploadRing.DeviceAddress() + uploadRing.Push(frameData).offset;
+				frameConstants.textureIndex	= frameTextureIndex;
+				frameConstants.samplerIndex	= textureStreamer.SamplerIndex();
+				renderGraph.AddPass("cull reset", [this](const vk::raii::CommandBuffer& commandBuffer){
+					instanceCuller.RecordReset(commandBuffer, frameIndex);
+				}).Use(drawArgs, ResourceUsage::TransferDst);
+				renderGraph.AddPass("cull", [this](const vk::raii::CommandBuffer& commandBuffer){
+					bindless.Bind(commandBuffer, vk::PipelineBindPoint::eCompute, instanceCuller.PipelineLayout());
+					commandBuffer.pushConstants<DrawConstants>(instanceCuller.PipelineLayout(), DRAW_CONSTANT_STAGES, 0, frameConstants);
+					instanceCuller.RecordCull(commandBuffer, frameIndex);
+				}).Use(drawArgs, ResourceUsage::StorageWriteCompute).Use(visible, ResourceUsage::StorageWriteCompute);
+				renderGraph.AddPass("scene", [this, color, depth](const vk::raii::CommandBuffer& commandBuffer){
+					RecordScenePass(commandBuffer, color, depth, true);
+				}).Use(color, ResourceUsage::ColorAttachment).Use(depth, ResourceUsage::DepthAttachment)
+				  .Use(drawArgs, ResourceUsage::IndirectRead).Use(visible, ResourceUsage::StorageReadVertex);
+			}
+			else
+			{
+				//the CPU path culls here, the recording threads only walk the visible list
+				frameCamera = CameraTransform();
+				scene.UpdateTransforms(scenePool.get());
+				scene.Cull(frameCamera, visibleDraws, scenePool.get());
+				renderGraph.AddPass("scene", [this, color, depth](const vk::raii::CommandBuffer& commandBuffer){
+					RecordScenePass(commandBuffer, color, depth, false);
+				}).Use(color, ResourceUsage::ColorAttachment).Use(depth, ResourceUsage::DepthAttachment);
+			}
+			if(frameScaled)
+			{
+				renderGraph.AddPass("upscale", [this, color, output](const vk::raii::CommandBuffer& commandBuffer){
+					RecordUpscale(commandBuffer, renderGraph.Image(color), renderGraph.Image(output));
+				}).Use(color, ResourceUsage::TransferSrc).Use(output, ResourceUsage::TransferDst);
+				if(hud.IsVisible())
+				{
+					renderGraph.AddPass("hud", [this, output](const vk::raii::CommandBuffer& commandBuffer){
+						RecordHudPass(commandBuffer, output);
+					}).Use(output, ResourceUsage::ColorAttachment);
+				}
+			}
+			captureSlot = frameCapture.IsEnabled() ? frameCapture.Acquire(swapChainExtent, frameNumber) : FrameCapture::NO_SLOT;
+			if(captureSlot != FrameCapture::NO_SLOT)
+			{
+				RenderGraph::Resource readback = renderGraph.ImportBuffer("readback", frameCapture.Target(captureSlot), ResourceUsage::HostRead);
+				renderGraph.AddPass("readback", [this, output](const vk::raii::CommandBuffer& commandBuffer){
+					frameCapture.RecordCopy(commandBuffer, captureSlot, renderGraph.Image(output));
+				}).Use(output, ResourceUsage::TransferSrc).Use(readback, ResourceUsage::TransferDst);
+			}
+			//transients replaced now may still be in use by every frame submitted so far
+			renderGraph.Execute(commandBuffer, submittedFrameValue);
+			if(*timestampQueryPool)
+				commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *timestampQueryPool, TIMESTAMPS_PER_FRAME * frameIndex + 2);
+			commandBuffer.end();
+		}
+		//a scaled frame first touches the swapchain image in the upscale blit, its scene pass must
+		//not wait for the acquire or the scene timestamps would count vsync as GPU time
+		vk::PipelineStageFlags2 AcquireWaitStages() const
+		{
+			return frameScaled ? vk::PipelineStageFlagBits2::eAllTransfer : vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+		}
+		//the color target with the draw list, or the culled instances, and the HUD on top
+		void RecordScenePass(const vk::raii::CommandBuffer& commandBuffer, RenderGraph::Resource color, RenderGraph::Resource depth, bool gpuDriven)
+		{
 			vk::RenderingAttachmentInfo attachmentInfo;
-			attachmentInfo.imageView	= swapChainImageViews[imageIndex];
+			attachmentInfo.imageView	= renderGraph.View(color);
 			attachmentInfo.imageLayout	= vk::ImageLayout::eColorAttachmentOptimal;
 			attachmentInfo.loadOp		= vk::AttachmentLoadOp::eClear;
 			attachmentInfo.storeOp		= vk::AttachmentStoreOp::eStore;
-			attachmentInfo.clearValue	= clearColor;
+			attachmentInfo.clearValue	= vk::ClearColorValue(1.0f, 1.0f, 1.0f, 1.0f);
+			//depth never leaves the pass, its memory may be shared with other transients
+			vk::RenderingAttachmentInfo depthInfo;
+			depthInfo.imageView			= renderGraph.View(depth);
+			depthInfo.imageLayout		= vk::ImageLayout::eDepthAttachmentOptimal;
+			depthInfo.loadOp			= vk::AttachmentLoadOp::eClear;
+			depthInfo.storeOp			= vk::AttachmentStoreOp::eDontCare;
+			depthInfo.clearValue		= vk::ClearDepthStencilValue(1.0f, 0);
 			vk::RenderingInfo renderingInfo;
-			vk::Rect2D rect;
-			rect.offset = vk::Offset2D{0, 0};
-			rect.extent = swapChainExtent;
-			renderingInfo.renderArea			= rect;
+			renderingInfo.renderArea			= vk::Rect2D(vk::Offset2D{0, 0}, frameRenderExtent);
 			renderingInfo.layerCount			= 1;
 			renderingInfo.colorAttachmentCount 	= 1;
 			renderingInfo.pColorAttachments		= &attachmentInfo;
+			renderingInfo.pDepthAttachment		= &depthInfo;
+			//large draw lists are split into secondary buffers recorded in parallel
+			bool parallel = !options.gpuDriven && commandRecorder.ThreadCount() > 1 && visibleDraws.size() >= 2 * CommandRecorder::MIN_ITEMS_PER_CHUNK;
+			if(parallel)
+				renderingInfo.flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers;
 			commandBuffer.beginRendering(renderingInfo);
-			commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *grapicsPipeline);
-			commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height), 0.0f, 1.0f));
-			commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapChainExtent));
-			commandBuffer.draw(3, 1, 0, 0);
+			if(options.gpuDriven)
+			{
+				if(gpuDriven)
+					RecordInstancedDraw(commandBuffer, frameConstants);
+				if(hud.IsVisible() && !frameScaled)
+				{
+					bindless.Bind(commandBuffer, vk::PipelineBindPoint::eGraphics, *pipeLineLayout);
+					hud.Record(commandBuffer, uploadRing, frameHudPipeline, *pipeLineLayout);
+				}
+			}
+			else if(parallel)
+			{
+				vk::CommandBufferInheritanceRenderingInfo renderingInheritance;
+				renderingInheritance.colorAttachmentCount		= 1;
+				renderingInheritance.pColorAttachmentFormats	= &swapChainSurfaceFormat.format;
+				renderingInheritance.depthAttachmentFormat		= depthFormat;
+				renderingInheritance.rasterizationSamples		= vk::SampleCountFlagBits::e1;
+				vk::CommandBufferInheritanceInfo inheritanceInfo;
+				inheritanceInfo.pNext = &renderingInheritance;
+				auto secondaries = commandRecorder.RecordSecondaries(visibleDraws.size(), inheritanceInfo,
+					[this](const vk::raii::CommandBuffer& secondary, size_t begin, size_t end){ RecordDraws(secondary, begin, end); });
+				commandBuffer.executeCommands(secondaries);
+			}
+			else
+			{
+				RecordDraws(commandBuffer, 0, visibleDraws.size());
+			}
 			commandBuffer.endRendering();
-			TranstionImageLayout(
-									imageIndex,
-									vk::ImageLayout::eColorAttachmentOptimal,
-									vk::ImageLayout::ePresentSrcKHR,
-									vk::AccessFlagBits2::eColorAttachmentWrite,
-									{},
-									vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-									vk::PipelineStageFlagBits2::eBottomOfPipe);
-			commandBuffer.end();
+			//end of the scene, what dynamic resolution steers by
+			if(*timestampQueryPool)
+				commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *timestampQueryPool, TIMESTAMPS_PER_FRAME * frameIndex + 1);
+		}
+		//linear blit of the frame's render region onto the whole output
+		void RecordUpscale(const vk::raii::CommandBuffer& commandBuffer, vk::Image source, vk::Image destination) const
+		{
+			vk::ImageBlit2 region;
+			region.srcSubresource	= vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+			region.srcOffsets[1]	= vk::Offset3D(static_cast<int32_t>(frameRenderExtent.width), static_cast<int32_t>(frameRenderExtent.height), 1);
+			region.dstSubresource	= vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+			region.dstOffsets[1]	= vk::Offset3D(static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1);
+			vk::BlitImageInfo2 blitInfo;
+			blitInfo.srcImage		= source;
+			blitInfo.srcImageLayout	= vk::ImageLayout::eTransferSrcOptimal;
+			blitInfo.dstImage		= destination;
+			blitInfo.dstImageLayout	= vk::ImageLayout::eTransferDstOptimal;
+			blitInfo.regionCount	= 1;
+			blitInfo.pRegions		= &region;
+			blitInfo.filter			= vk::Filter::eLinear;
+			commandBuffer.blitImage2(blitInfo);
 		}
-		void TranstionImageLayout(
-									uint32_t				imageIndex,
-									vk::ImageLayout			old_layout,
-									vk::ImageLayout			new_layout,
-									vk::AccessFlags2		src_access_mask,
-									vk::AccessFlags2		dst_access_mask,
-									vk::PipelineStageFlags2 src_stage_mask,
-									vk::PipelineStageFlags2 dst_stage_mask)
-		{
-			vk::ImageMemoryBarrier2 barrier;
-			barrier.srcStageMask			= src_stage_mask;
-			barrier.srcAccessMask			= src_access_mask;
-			barrier.dstStageMask			= dst_stage_mask;
-			barrier.dstAccessMask			= dst_access_mask;
-			barrier.oldLayout				= old_layout;
-			barrier.newLayout				= new_layout;
-			barrier.srcQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
-			barrier.dstQueueFamilyIndex		= VK_QUEUE_FAMILY_IGNORED;
-			barrier.image					= swapChainImages[imageIndex];
-			vk::ImageSubresourceRange subRange;
-			subRange.aspectMask 	= vk::ImageAspectFlagBits::eColor;
-			subRange.baseMipLevel	= 0;
-			subRange.levelCount		= 1;
-			subRange.baseArrayLayer = 0;
-			subRange.layerCount		= 1;
-			barrier.subresourceRange = subRange;
-			vk::DependencyInfo dependencyInfo;
-			dependencyInfo.dependencyFlags = {};
-			dependencyInfo.imageMemoryBarrierCount = 1;
-			dependencyInfo.pImageMemoryBarriers = &barrier;
-			commandBuffers[frameIndex].pipelineBarrier2(dependencyInfo);
+		//the HUD at output resolution on top of the upscaled scene
+		void RecordHudPass(const vk::raii::CommandBuffer& commandBuffer, RenderGraph::Resource output)
+		{
+			vk::RenderingAttachmentInfo attachmentInfo;
+			attachmentInfo.imageView	= renderGraph.View(output);
+			attachmentInfo.imageLayout	= vk::ImageLayout::eColorAttachmentOptimal;
+			attachmentInfo.loadOp		= vk::AttachmentLoadOp::eLoad;
+			attachmentInfo.storeOp		= vk::AttachmentStoreOp::eStore;
+			vk::RenderingInfo renderingInfo;
+			renderingInfo.renderArea			= vk::Rect2D(vk::Offset2D{0, 0}, swapChainExtent);
+			renderingInfo.layerCount			= 1;
+			renderingInfo.colorAttachmentCount 	= 1;
+			renderingInfo.pColorAttachments		= &attachmentInfo;
+			commandBuffer.beginRendering(renderingInfo);
+			bindless.Bind(commandBuffer, vk::PipelineBindPoint::eGraphics, *pipeLineLayout);
+			hud.Record(commandBuffer, uploadRing, frameHudPipeline, *pipeLineLayout);
+			commandBuffer.endRendering();
 		}
 		void CreateSyncObjects()
 		{
-			assert(presentCompleteSemaphores.empty() && renderFinishedSemaphores.empty() && inFlightFence.empty());
-			for(size_t i = 0; i < swapChainImages.size(); i++)
-				renderFinishedSemaphores.emplace_back(device, vk::SemaphoreCreateInfo());
-			for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+			assert(presentCompleteSemaphores.empty() && renderFinishedSemaphores.empty());
+			//headless frames only signal the timeline, nothing is acquired or presented
+			if(!options.headless)
 			{
-				presentCompleteSemaphores.emplace_back(device, vk::SemaphoreCreateInfo());
-				vk::FenceCreateInfo fenceInfo;
-				fenceInfo.flags = vk::FenceCreateFlagBits::eSignaled;
-				inFlightFence.emplace_back(device, fenceInfo);
+				for(size_t i = 0; i < swapChainImages.size(); i++)
+					renderFinishedSemaphores.emplace_back(device, vk::SemaphoreCreateInfo());
+				for(size_t i = 0; i < options.framesInFlight; i++)
+					presentCompleteSemaphores.emplace_back(device, vk::SemaphoreCreateInfo());
 			}
+			//frame N signals value N, frameSlotValues remembers the last value per slot
+			vk::SemaphoreTypeCreateInfo typeInfo;
+			typeInfo.semaphoreType	= vk::SemaphoreType::eTimeline;
+			typeInfo.initialValue	= 0;
+			vk::SemaphoreCreateInfo semaphoreInfo;
+			semaphoreInfo.pNext = &typeInfo;
+			frameTimeline = vk::raii::Semaphore(device, semaphoreInfo);
+			frameSlotValues.assign(options.framesInFlight, 0);
 		}
 
 
@@ -557,19 +1513,8 @@ class TriangleVulkan
 			return vk::False;
 		}
 
-		static std::vector<char> readFile(const std::string &filename)
-		{
-			std::ifstream file(filename, std::ios::ate | std::ios::binary);
-			if(!file.is_open())
-				throw std::runtime_error("failed to open file!");
-			std::vector<char> buffer(file.tellg());
-			file.seekg(0, std::ios::beg);
-			file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-			file.clear();
-			return buffer;
-		}
-
 	private:
+		RendererOptions						options;
 		GLFWwindow* 						window 			= nullptr;
 		vk::raii::Context 					context;
 		vk::raii::Instance 					instance 		= nullptr;
@@ -581,34 +1526,122 @@ class TriangleVulkan
 		//queue
 		vk::raii::Queue 					queue	= nullptr;
 		uint32_t queueIndex = ~0;
+		vk::raii::Queue 					transferQueue	= nullptr;
+		//graphics queues of the render server, the first one is queue
+		std::vector<vk::raii::Queue>		serverQueues;
+		uint32_t transferQueueIndex = ~0;
+		//memory, outlives every resource allocated from it
+		GpuAllocator						gpuAllocator;
+		UploadRing							uploadRing;
+		TransferUploader					transferUploader;
+		uint64_t							transferWaitValue = 0;
+		//headless targets, destroyed after the views that reference them
+		std::vector<GpuImage>				offscreenImages;
 		//swapchain
 		vk::raii::SwapchainKHR 				swapChain 		= nullptr;
 		std::vector<vk::Image>				swapChainImages;
 		vk::SurfaceFormatKHR				swapChainSurfaceFormat;
 		vk::Extent2D						swapChainExtent;
+		vk::Format							depthFormat = vk::Format::eUndefined;
+		std::string							swapChainPresentMode = "offscreen";
 		std::vector<vk::raii::ImageView>	swapChainImageViews;
 		//grapics pipeline
+		PersistentPipelineCache		pipelineCache;
+		BindlessDescriptors				bindless;
 		vk::raii::PipelineLayout 	pipeLineLayout = nullptr;
-		vk::raii::Pipeline 			grapicsPipeline = nullptr;
+		vk::raii::ShaderModule		shaderModule = nullptr;
+		InstanceCuller				instanceCuller;
+		//destroyed first, joins the compile workers that use the members above
+		PipelineRegistry			pipelineRegistry;
+		PipelineRegistry::Key		fallbackPipeline = 0;
+		PipelineRegistry::Key		activePipeline = 0;
+		PipelineRegistry::Key		hudPipeline = 0;
+		vk::CullModeFlags			cullMode = vk::CullModeFlagBits::eBack;
+		BlendMode					blendMode = BlendMode::Opaque;
+#ifdef SHADER_HOT_RELOAD
+		std::unique_ptr<ShaderWatcher>	shaderWatcher;
+#endif
 		//conmmand
-		vk::raii::CommandPool 					commandPool = nullptr;
-		std::vector<vk::raii::CommandBuffer> 	commandBuffers;
+		CommandRecorder							commandRecorder;
+		RenderGraph								renderGraph;
+		//push constants of the GPU driven passes, built while the frame's graph is declared
+		DrawConstants							frameConstants;
+		FrameCapture							frameCapture;
+		uint32_t								captureSlot = FrameCapture::NO_SLOT;
+		RenderServer							renderServer;
+		//the draws as scene nodes, culled on the CPU unless GPU driven
+		Scene									scene;
+		std::vector<Scene::Node>				visibleDraws;
+		std::unique_ptr<ThreadPool>				scenePool;
+		glm::mat4								frameCamera{1.0f};
+		vk::Pipeline							framePipeline;
+		vk::Pipeline							frameHudPipeline;
+		bool									frameMeshReady = false;
+		//dynamic resolution: the scene renders into frameRenderExtent of a larger target and is upscaled
+		DynamicResolution						dynamicResolution;
+		bool									frameScaled = false;
+		vk::Extent2D							frameRenderExtent;
+		GpuMesh									mesh;
+		glm::mat4								meshTransform{1.0f};
+		TextureStreamer							textureStreamer;
+		TextureStreamer::Handle					texture = TextureStreamer::INVALID_HANDLE;
+		uint32_t								frameTextureIndex = BindlessDescriptors::INVALID_INDEX;
+		//after the allocator and bindless set its atlas pages live in
+		Hud										hud;
+		HudStatus								hudStatus;
+		float									frameTime = 0.0f;
 		//sync object
 		std::vector<vk::raii::Semaphore> 	presentCompleteSemaphores;
 		std::vector<vk::raii::Semaphore> 	renderFinishedSemaphores;
-		std::vector<vk::raii::Fence> 		inFlightFence;
+		vk::raii::Semaphore					frameTimeline = nullptr;
+		uint64_t							submittedFrameValue = 0;
+		std::vector<uint64_t>				frameSlotValues;
 		uint32_t							frameIndex = 0;
+		uint64_t							frameNumber = 0;
+		//retired swapchain objects, after the semaphores so it is destroyed first
+		DeferredDeletionQueue				deletionQueue;
+		//destroyed before the swapchains its waiter may block on
+		PresentLatency						presentLatency;
+		std::chrono::steady_clock::time_point	startTime = std::chrono::steady_clock::now();
+		//benchmark
+		static constexpr uint64_t			NO_TIMESTAMP = ~0ull;
+		FrameTimer							frameTimer;
+		FrameStats							frameStats;
+		vk::raii::QueryPool					timestampQueryPool = nullptr;
+		std::vector<uint64_t>				timestampFrames;
+		std::vector<uint64_t>				timestampSubmitNs;
+		//GPU tick and trace clock value of the same instant, see CalibrateGpuClock
+		uint64_t							gpuClockTicks = 0;
+		uint64_t							gpuClockHostNs = 0;
+		uint64_t							gpuClockFrame = 0;
+		uint32_t							timestampValidBits = 0;
+		float								timestampPeriod = 1.0f;
 
 		bool framebufferResized = false;
+		bool presentModeChanged = false;
+		//frame pacing; input sampling time of the frame being recorded, on the Tracer::Now() clock
+		FrameLimiter						frameLimiter;
+		uint64_t							inputSampleNs = 0;
+
+		DeviceCaps							deviceCaps;
+		StartupTimer						startupTimer;
 
 		std::vector<const char*> requiredDeviceExtension = {
 			vk::KHRSwapchainExtensionName};
 
 };
 
-int main()
+int main(int argc, char** argv)
 {
-	TriangleVulkan app;
-	app.Run();
-	return -1;
+	try
+	{
+		TriangleVulkan app(ParseOptions(argc, argv));
+		app.Run();
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
 }
\ No newline at end of file
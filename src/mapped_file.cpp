@@ -0,0 +1,76 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path)
+{
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(handle == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("failed to open " + path);
+	file = handle;
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(handle);
+		throw std::runtime_error("failed to map " + path);
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+	mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mapping != nullptr)
+		data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if(data == nullptr)
+	{
+		if(mapping != nullptr)
+			CloseHandle(mapping);
+		CloseHandle(handle);
+		throw std::runtime_error("failed to map " + path);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+	CloseHandle(file);
+}
+#else
+MappedFile::MappedFile(const std::string& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw std::runtime_error("failed to open " + path);
+	struct stat status;
+	if(fstat(fd, &status) != 0 || status.st_size == 0)
+	{
+		close(fd);
+		throw std::runtime_error("failed to map " + path);
+	}
+	size = static_cast<size_t>(status.st_size);
+	void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//the mapping keeps its own reference to the file
+	close(fd);
+	if(mapped == MAP_FAILED)
+		throw std::runtime_error("failed to map " + path);
+	//sections are read front to back exactly once
+	madvise(mapped, size, MADV_SEQUENTIAL);
+	madvise(mapped, size, MADV_WILLNEED);
+	data = static_cast<const uint8_t*>(mapped);
+}
+
+MappedFile::~MappedFile()
+{
+	munmap(const_cast<uint8_t*>(data), size);
+}
+#endif
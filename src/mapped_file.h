@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//Read only mapping of a whole file, mmap on POSIX and a file mapping on Windows
+class MappedFile
+{
+	public:
+		explicit MappedFile(const std::string& path);
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		const uint8_t* Data() const { return data; }
+		size_t Size() const { return size; }
+	private:
+		const uint8_t*	data = nullptr;
+		size_t			size = 0;
+#ifdef _WIN32
+		void*			file = nullptr;
+		void*			mapping = nullptr;
+#endif
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+
+//On-disk layout of the .vmesh files written by MeshConverter (tools/mesh_converter.cpp).
+//Every section is a raw array in GPU layout, the loader copies it into a buffer untouched.
+
+constexpr uint32_t MESH_FILE_MAGIC			= 0x48534D56;	//"VMSH"
+constexpr uint32_t MESH_FILE_VERSION		= 1;
+constexpr uint64_t MESH_SECTION_ALIGNMENT	= 16;
+constexpr uint32_t MESHLET_MAX_VERTICES		= 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES	= 124;
+
+enum class MeshSection : uint32_t
+{
+	Vertices,			//PackedVertex
+	Indices,			//uint32_t, ordered for the post transform vertex cache
+	Meshlets,			//MeshletDesc
+	MeshletVertices,	//uint32_t, indices into Vertices
+	MeshletTriangles,	//3 x uint8_t per triangle, indices into the meshlet's vertices
+	Count
+};
+
+struct MeshSectionRange
+{
+	uint64_t	offset	= 0;
+	uint64_t	size	= 0;
+};
+
+//position: snorm16 inside the mesh bounds, w unused; normal: snorm8, w unused; uv: half floats
+struct PackedVertex
+{
+	int16_t		position[4];
+	int8_t		normal[4];
+	uint16_t	uv[2];
+};
+static_assert(sizeof(PackedVertex) == 16);
+
+struct MeshletDesc
+{
+	uint32_t	vertexOffset;
+	uint32_t	triangleOffset;
+	uint32_t	vertexCount;
+	uint32_t	triangleCount;
+	//bounding sphere in mesh space
+	float		center[3];
+	float		radius;
+};
+static_assert(sizeof(MeshletDesc) == 32);
+
+struct MeshFileHeader
+{
+	uint32_t			magic			= MESH_FILE_MAGIC;
+	uint32_t			version			= MESH_FILE_VERSION;
+	uint32_t			vertexCount		= 0;
+	uint32_t			indexCount		= 0;
+	uint32_t			meshletCount	= 0;
+	uint32_t			padding			= 0;
+	//position = boundsMin + (quantized * 0.5 + 0.5) * (boundsMax - boundsMin)
+	float				boundsMin[3]	= {};
+	float				boundsMax[3]	= {};
+	MeshSectionRange	sections[static_cast<uint32_t>(MeshSection::Count)];
+};
@@ -0,0 +1,112 @@
+#include "mesh_loader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	//sections are not trusted to be aligned in a damaged file
+	template<typename T>
+	T ReadElement(const uint8_t* section, uint64_t index)
+	{
+		T value;
+		std::memcpy(&value, section + index * sizeof(T), sizeof(T));
+		return value;
+	}
+
+	//every index the GPU follows stays inside the array it indexes: the shaders fetch vertices
+	//through a device address with no robustness, a bad index would read past the buffer
+	void ValidateIndices(const std::string& path, const MeshFileHeader& header, const uint8_t* data)
+	{
+		auto section = [&](MeshSection which){ return header.sections[static_cast<uint32_t>(which)]; };
+		const uint8_t* indices = data + section(MeshSection::Indices).offset;
+		for(uint64_t i = 0; i < header.indexCount; i++)
+		{
+			if(ReadElement<uint32_t>(indices, i) >= header.vertexCount)
+				throw std::runtime_error("mesh: " + path + " has an index past its " + std::to_string(header.vertexCount) + " vertices");
+		}
+
+		//meshlets are packed back to back, the two meshlet arrays are exactly what they describe
+		const uint8_t* meshlets			= data + section(MeshSection::Meshlets).offset;
+		const uint8_t* meshletVertices	= data + section(MeshSection::MeshletVertices).offset;
+		const uint8_t* meshletTriangles	= data + section(MeshSection::MeshletTriangles).offset;
+		uint64_t meshletVertexCount		= section(MeshSection::MeshletVertices).size / sizeof(uint32_t);
+		uint64_t meshletTriangleBytes	= section(MeshSection::MeshletTriangles).size;
+		uint64_t vertexTotal = 0, triangleTotal = 0;
+		for(uint32_t m = 0; m < header.meshletCount; m++)
+		{
+			MeshletDesc meshlet = ReadElement<MeshletDesc>(meshlets, m);
+			if(meshlet.vertexCount > MESHLET_MAX_VERTICES || meshlet.triangleCount > MESHLET_MAX_TRIANGLES ||
+			   uint64_t(meshlet.vertexOffset) + meshlet.vertexCount > meshletVertexCount ||
+			   uint64_t(meshlet.triangleOffset) + 3ull * meshlet.triangleCount > meshletTriangleBytes)
+				throw std::runtime_error("mesh: " + path + " has meshlet " + std::to_string(m) + " outside of its arrays");
+			for(uint32_t v = 0; v < meshlet.vertexCount; v++)
+			{
+				if(ReadElement<uint32_t>(meshletVertices, meshlet.vertexOffset + v) >= header.vertexCount)
+					throw std::runtime_error("mesh: " + path + " has meshlet " + std::to_string(m) + " referencing a vertex past the mesh");
+			}
+			for(uint32_t t = 0; t < 3 * meshlet.triangleCount; t++)
+			{
+				if(meshletTriangles[meshlet.triangleOffset + t] >= meshlet.vertexCount)
+					throw std::runtime_error("mesh: " + path + " has meshlet " + std::to_string(m) + " referencing a vertex past the meshlet");
+			}
+			vertexTotal		+= meshlet.vertexCount;
+			triangleTotal	+= meshlet.triangleCount;
+		}
+		if(section(MeshSection::MeshletVertices).size != vertexTotal * sizeof(uint32_t) || meshletTriangleBytes != 3 * triangleTotal)
+			throw std::runtime_error("mesh: " + path + " has meshlet arrays that do not match its meshlets");
+	}
+}
+
+GpuMesh LoadMesh(const std::string& path, const vk::raii::Device& device, GpuAllocator& allocator, TransferUploader& uploader)
+{
+	MappedFile file(path);
+	if(file.Size() < sizeof(MeshFileHeader))
+		throw std::runtime_error("mesh: " + path + " is truncated");
+	MeshFileHeader header;
+	std::memcpy(&header, file.Data(), sizeof(header));
+	if(header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION)
+		throw std::runtime_error("mesh: " + path + " is not a version " + std::to_string(MESH_FILE_VERSION) + " .vmesh file, rerun MeshConverter");
+	for(const MeshSectionRange& section : header.sections)
+	{
+		if(section.offset > file.Size() || section.size > file.Size() - section.offset)
+			throw std::runtime_error("mesh: " + path + " has a section outside of the file");
+	}
+	auto sectionSize = [&](MeshSection section){ return header.sections[static_cast<uint32_t>(section)].size; };
+	if(sectionSize(MeshSection::Vertices) != uint64_t(header.vertexCount) * sizeof(PackedVertex) ||
+	   sectionSize(MeshSection::Indices) != uint64_t(header.indexCount) * sizeof(uint32_t) ||
+	   sectionSize(MeshSection::Meshlets) != uint64_t(header.meshletCount) * sizeof(MeshletDesc) ||
+	   header.indexCount == 0)
+		throw std::runtime_error("mesh: " + path + " has inconsistent section sizes");
+	ValidateIndices(path, header, file.Data());
+
+	GpuMesh mesh;
+	mesh.vertexCount	= header.vertexCount;
+	mesh.indexCount		= header.indexCount;
+	mesh.meshletCount	= header.meshletCount;
+	mesh.boundsMin		= glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	mesh.boundsMax		= glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	mesh.fileBytes		= file.Size();
+	//each section goes from the page cache into staging memory in one memcpy
+	auto upload = [&](MeshSection section, vk::BufferUsageFlags usage){
+		const MeshSectionRange& range = header.sections[static_cast<uint32_t>(section)];
+		vk::BufferCreateInfo bufferInfo;
+		//empty sections still get a buffer so descriptors stay valid
+		bufferInfo.size			= std::max<vk::DeviceSize>(range.size, 4);
+		bufferInfo.usage		= usage | vk::BufferUsageFlagBits::eTransferDst;
+		bufferInfo.sharingMode	= vk::SharingMode::eExclusive;
+		GpuBuffer buffer = allocator.CreateBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		if(range.size > 0)
+			mesh.ticket = uploader.UploadBuffer(*buffer, 0, file.Data() + range.offset, range.size);
+		return buffer;
+	};
+	mesh.vertices			= upload(MeshSection::Vertices, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress);
+	mesh.indices			= upload(MeshSection::Indices, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+	mesh.meshlets			= upload(MeshSection::Meshlets, vk::BufferUsageFlagBits::eStorageBuffer);
+	mesh.meshletVertices	= upload(MeshSection::MeshletVertices, vk::BufferUsageFlagBits::eStorageBuffer);
+	mesh.meshletTriangles	= upload(MeshSection::MeshletTriangles, vk::BufferUsageFlagBits::eStorageBuffer);
+	mesh.vertexAddress		= device.getBufferAddress(vk::BufferDeviceAddressInfo(*mesh.vertices));
+	return mesh;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include <vulkan/vulkan_raii.hpp>
+#include <glm/glm.hpp>
+
+#include "gpu_allocator.h"
+#include "mapped_file.h"
+#include "mesh_format.h"
+#include "transfer_queue.h"
+
+//a .vmesh file in device local buffers, valid once ticket is available on the graphics queue
+struct GpuMesh
+{
+	GpuBuffer			vertices;
+	GpuBuffer			indices;
+	GpuBuffer			meshlets;
+	GpuBuffer			meshletVertices;
+	GpuBuffer			meshletTriangles;
+	vk::DeviceAddress	vertexAddress = 0;
+	uint32_t			vertexCount = 0;
+	uint32_t			indexCount = 0;
+	uint32_t			meshletCount = 0;
+	glm::vec3			boundsMin{0.0f};
+	glm::vec3			boundsMax{0.0f};
+	uint64_t			ticket = 0;
+	uint64_t			fileBytes = 0;
+};
+
+//maps path and copies every section from the mapping straight into staging memory; the
+//indices are scanned once against the arrays they index, nothing else is parsed or copied on
+//the CPU side; throws on a malformed file
+GpuMesh LoadMesh(const std::string& path, const vk::raii::Device& device, GpuAllocator& allocator, TransferUploader& uploader);
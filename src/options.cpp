@@ -0,0 +1,164 @@
+#include "options.h"
+
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace
+{
+	//headless runs have no window to close, so they need a frame budget
+	constexpr uint32_t DEFAULT_HEADLESS_FRAMES = 1000;
+
+	uint32_t ParseUInt(std::string_view name, std::string_view value)
+	{
+		uint32_t result = 0;
+		auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+		if(ec != std::errc() || ptr != value.data() + value.size())
+			throw std::runtime_error("invalid value for " + std::string(name) + ": " + std::string(value));
+		return result;
+	}
+
+	float ParseFloat(std::string_view name, std::string_view value)
+	{
+		float result = 0.0f;
+		auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+		if(ec != std::errc() || ptr != value.data() + value.size())
+			throw std::runtime_error("invalid value for " + std::string(name) + ": " + std::string(value));
+		return result;
+	}
+
+	PresentMode ParsePresentMode(std::string_view value)
+	{
+		for(PresentMode mode : {PresentMode::Immediate, PresentMode::Mailbox, PresentMode::Fifo, PresentMode::FifoRelaxed})
+			if(value == ToString(mode))
+				return mode;
+		throw std::runtime_error("invalid value for --present-mode: " + std::string(value) + " (immediate, mailbox, fifo or fifo-relaxed)");
+	}
+}
+
+const char* ToString(PresentMode mode)
+{
+	switch(mode)
+	{
+		case PresentMode::Immediate:	return "immediate";
+		case PresentMode::Mailbox:		return "mailbox";
+		case PresentMode::Fifo:			return "fifo";
+		case PresentMode::FifoRelaxed:	return "fifo-relaxed";
+		default:						return "unknown";
+	}
+}
+
+RendererOptions ParseOptions(int argc, char** argv)
+{
+	RendererOptions options;
+	for(int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		auto value = [&]() -> std::string_view {
+			if(i + 1 >= argc)
+				throw std::runtime_error("missing value for " + std::string(arg));
+			return argv[++i];
+		};
+		if(arg == "--headless")
+			options.headless = true;
+		else if(arg == "--frames")
+			options.frameCount = ParseUInt(arg, value());
+		else if(arg == "--frames-in-flight")
+			options.framesInFlight = ParseUInt(arg, value());
+		else if(arg == "--benchmark")
+			options.benchmarkFrames = ParseUInt(arg, value());
+		else if(arg == "--warmup")
+			options.warmupFrames = ParseUInt(arg, value());
+		else if(arg == "--report")
+			options.reportPath = value();
+		else if(arg == "--pipeline-cache")
+			options.pipelineCachePath = value();
+		else if(arg == "--no-pipeline-cache")
+			options.pipelineCachePath.clear();
+		else if(arg == "--pipeline-threads")
+			options.pipelineThreads = ParseUInt(arg, value());
+		else if(arg == "--draws")
+			options.drawCount = ParseUInt(arg, value());
+		else if(arg == "--mesh")
+			options.meshPath = value();
+		else if(arg == "--gpu-driven")
+			options.gpuDriven = true;
+		else if(arg == "--texture")
+			options.texturePath = value();
+		else if(arg == "--texture-budget")
+			options.textureBudgetMB = ParseUInt(arg, value());
+		else if(arg == "--texture-bc1")
+			options.textureBc1 = true;
+		else if(arg == "--trace")
+			options.tracePath = value();
+		else if(arg == "--capture")
+			options.capturePath = value();
+		else if(arg == "--capture-raw")
+		{
+			options.capturePath = value();
+			options.captureRaw = true;
+		}
+		else if(arg == "--capture-threads")
+			options.captureThreads = ParseUInt(arg, value());
+		else if(arg == "--hud")
+			options.hud = true;
+		else if(arg == "--present-mode")
+			options.presentMode = ParsePresentMode(value());
+		else if(arg == "--swapchain-images")
+			options.swapchainImages = ParseUInt(arg, value());
+		else if(arg == "--fps-limit")
+			options.fpsLimit = ParseUInt(arg, value());
+		else if(arg == "--gpu-budget")
+			options.gpuBudgetMs = ParseFloat(arg, value());
+		else if(arg == "--render-scale-min")
+			options.renderScaleMin = ParseFloat(arg, value());
+		else if(arg == "--render-scale-max")
+			options.renderScaleMax = ParseFloat(arg, value());
+		else if(arg == "--record-threads")
+			options.recordThreads = ParseUInt(arg, value());
+		else if(arg == "--serve")
+			options.servePath = value();
+		else if(arg == "--serve-queues")
+			options.serveQueues = ParseUInt(arg, value());
+		else if(arg == "--serve-jobs")
+			options.serveJobs = ParseUInt(arg, value());
+		else if(arg == "--width")
+			options.width = ParseUInt(arg, value());
+		else if(arg == "--height")
+			options.height = ParseUInt(arg, value());
+		else
+			throw std::runtime_error("unknown option: " + std::string(arg));
+	}
+	if(options.framesInFlight < 1 || options.framesInFlight > MAX_FRAMES_IN_FLIGHT)
+		throw std::runtime_error("--frames-in-flight must be between 1 and " + std::to_string(MAX_FRAMES_IN_FLIGHT));
+	if(options.drawCount == 0)
+		throw std::runtime_error("--draws must be greater than zero");
+	if(options.gpuDriven && !options.meshPath.empty())
+		throw std::runtime_error("--mesh cannot be combined with --gpu-driven yet");
+	if(options.textureBudgetMB == 0)
+		throw std::runtime_error("--texture-budget must be greater than zero");
+	if(options.swapchainImages < 2)
+		throw std::runtime_error("--swapchain-images must be at least 2");
+	if(!(options.gpuBudgetMs >= 0.0f))
+		throw std::runtime_error("--gpu-budget must not be negative");
+	if(!(options.renderScaleMin > 0.0f && options.renderScaleMin <= options.renderScaleMax && options.renderScaleMax <= MAX_RENDER_SCALE))
+		throw std::runtime_error("render scales must satisfy 0 < --render-scale-min <= --render-scale-max <= " + std::to_string(static_cast<uint32_t>(MAX_RENDER_SCALE)));
+	if(options.width == 0 || options.height == 0)
+		throw std::runtime_error("width and height must be greater than zero");
+	if(!options.servePath.empty())
+	{
+		//jobs render the draw grid only, the scene options of a normal run do not apply
+		if(!options.meshPath.empty() || options.gpuDriven || !options.texturePath.empty())
+			throw std::runtime_error("--serve cannot be combined with --mesh, --gpu-driven or --texture");
+		if(options.benchmarkFrames > 0 || !options.capturePath.empty())
+			throw std::runtime_error("--serve cannot be combined with --benchmark or --capture, jobs name their own output");
+		options.headless = true;
+	}
+	//a benchmark run is exactly warm-up + measured frames
+	if(options.benchmarkFrames > 0)
+		options.frameCount = options.warmupFrames + options.benchmarkFrames;
+	if(options.headless && options.frameCount == 0)
+		options.frameCount = DEFAULT_HEADLESS_FRAMES;
+	return options;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+//upper bound for --frames-in-flight
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+//upper bound for --render-scale-max, 2x supersampling
+constexpr float MAX_RENDER_SCALE = 2.0f;
+
+//swapchain present modes, from lowest latency to least tearing
+enum class PresentMode : uint8_t
+{
+	//tears, never waits
+	Immediate,
+	//newest frame replaces the queued one, no tearing
+	Mailbox,
+	//vsync, always supported, the fallback for the others
+	Fifo,
+	//vsync, late frames tear instead of waiting for the next one
+	FifoRelaxed,
+	Count
+};
+const char* ToString(PresentMode mode);
+
+struct RendererOptions
+{
+	//window or offscreen
+	bool		headless	= false;
+	uint32_t	width		= 800;
+	uint32_t	height		= 600;
+	//0 = run until the window is closed
+	uint32_t	frameCount	= 0;
+	//frames the CPU may run ahead of the GPU, 1 = lowest latency
+	uint32_t	framesInFlight	= 2;
+	//benchmark: measured frames after warm-up, 0 = disabled
+	uint32_t	benchmarkFrames	= 0;
+	uint32_t	warmupFrames	= 60;
+	std::string	reportPath		= "benchmark.json";
+	//empty = no on-disk pipeline cache
+	std::string	pipelineCachePath	= "pipeline_cache.bin";
+	//pipeline compile workers, 0 = half of the hardware threads
+	uint32_t	pipelineThreads		= 0;
+	//draws in the frame's draw list, laid out on a grid
+	uint32_t	drawCount			= 1;
+	//.vmesh file drawn in place of the triangle, see tools/mesh_converter.cpp
+	std::string	meshPath;
+	//draws are culled on the GPU and issued as one indirect instanced draw
+	bool		gpuDriven			= false;
+	//image streamed in and sampled by every draw, empty = untextured
+	std::string	texturePath;
+	//device memory the streamed textures may use, in MiB
+	uint32_t	textureBudgetMB		= 256;
+	//cache textures as BC1 when the device supports it
+	bool		textureBc1			= false;
+	//Chrome trace JSON written at exit and on T, empty = tracing off
+	std::string	tracePath;
+	//<capturePath>_<frame>.png per frame, or raw RGBA8 frames into capturePath with --capture-raw; empty = no capture
+	std::string	capturePath;
+	bool		captureRaw			= false;
+	//PNG encode workers, 0 = half of the hardware threads
+	uint32_t	captureThreads		= 0;
+	//performance overlay shown from the start, H toggles it either way
+	bool		hud					= false;
+	//requested present mode, P cycles through the supported ones
+	PresentMode	presentMode			= PresentMode::Mailbox;
+	//minimum swapchain images, clamped to what the surface allows; 2 has the least queueing
+	uint32_t	swapchainImages		= 3;
+	//CPU frame cap, 0 = unlimited
+	uint32_t	fpsLimit			= 0;
+	//dynamic resolution: GPU milliseconds the scene may take, 0 = render at the window size
+	float		gpuBudgetMs			= 0.0f;
+	//render scale bounds per axis while the budget is set
+	float		renderScaleMin		= 0.5f;
+	float		renderScaleMax		= 1.0f;
+	//secondary command buffer recording threads besides the main thread, 0 = half of the hardware threads
+	uint32_t	recordThreads		= 0;
+	//batch render server: job source, "-" for stdin or a unix socket path; empty = render frames as usual
+	std::string	servePath;
+	//queues of the graphics family the server spreads jobs over, 0 = all of them
+	uint32_t	serveQueues			= 0;
+	//jobs rendering at the same time, 0 = two per queue
+	uint32_t	serveJobs			= 0;
+};
+
+//throws std::runtime_error on unknown or malformed arguments
+RendererOptions ParseOptions(int argc, char** argv);
@@ -0,0 +1,177 @@
+#include "pipeline_cache.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	constexpr uint32_t CACHE_MAGIC		= 0x43505256;	//"VRPC"
+	constexpr uint32_t CACHE_VERSION	= 1;
+
+	uint64_t Fnv1a(const uint8_t* data, size_t size)
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for(size_t i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+}
+
+void PersistentPipelineCache::Open(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, const std::string& path)
+{
+	this->device	= &device;
+	this->path		= path;
+	properties		= physicalDevice.getProperties();
+	std::string error;
+	std::vector<uint8_t> data = ReadFile(error);
+	if(!error.empty())
+		std::cerr << "pipeline cache: " << error << ", starting cold" << std::endl;
+	if(!data.empty())
+	{
+		std::error_code ec;
+		loadedWriteTime = std::filesystem::last_write_time(this->path, ec);
+		vk::PipelineCacheCreateInfo createInfo;
+		createInfo.initialDataSize	= data.size();
+		createInfo.pInitialData		= data.data();
+		try
+		{
+			cache	= vk::raii::PipelineCache(device, createInfo);
+			warm	= true;
+			return;
+		}
+		catch(const vk::SystemError& e)
+		{
+			std::cerr << "pipeline cache: driver rejected " << path << " (" << e.what() << "), starting cold" << std::endl;
+		}
+	}
+	cache = vk::raii::PipelineCache(device, vk::PipelineCacheCreateInfo());
+}
+
+std::vector<uint8_t> PersistentPipelineCache::ReadFile(std::string& error) const
+{
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if(!file.is_open())
+		return {};
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	FileHeader header{};
+	if(fileSize < sizeof(header))
+	{
+		error = "truncated header in " + path.string();
+		return {};
+	}
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if(header.magic != CACHE_MAGIC || header.version != CACHE_VERSION)
+	{
+		error = "unknown format in " + path.string();
+		return {};
+	}
+	if(header.vendorID != properties.vendorID || header.deviceID != properties.deviceID || header.driverVersion != properties.driverVersion ||
+		std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0)
+	{
+		error = "stale cache for another device or driver in " + path.string();
+		return {};
+	}
+	if(header.dataSize != fileSize - sizeof(header))
+	{
+		error = "size mismatch in " + path.string();
+		return {};
+	}
+	std::vector<uint8_t> data(header.dataSize);
+	file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	if(!file || Fnv1a(data.data(), data.size()) != header.checksum)
+	{
+		error = "checksum mismatch in " + path.string();
+		return {};
+	}
+	//the driver's own header has to agree as well
+	VkPipelineCacheHeaderVersionOne driverHeader{};
+	if(data.size() < sizeof(driverHeader))
+	{
+		error = "truncated driver header in " + path.string();
+		return {};
+	}
+	std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+	if(driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || driverHeader.vendorID != properties.vendorID || driverHeader.deviceID != properties.deviceID ||
+		std::memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0)
+	{
+		error = "driver header mismatch in " + path.string();
+		return {};
+	}
+	return data;
+}
+
+PersistentPipelineCache::FileHeader PersistentPipelineCache::MakeHeader(const std::vector<uint8_t>& data) const
+{
+	FileHeader header{};
+	header.magic			= CACHE_MAGIC;
+	header.version			= CACHE_VERSION;
+	header.vendorID			= properties.vendorID;
+	header.deviceID			= properties.deviceID;
+	header.driverVersion	= properties.driverVersion;
+	std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+	header.dataSize			= data.size();
+	header.checksum			= Fnv1a(data.data(), data.size());
+	return header;
+}
+
+bool PersistentPipelineCache::Save()
+{
+	if(device == nullptr || !*cache)
+		return false;
+	try
+	{
+		//another run may have written the file since we loaded it
+		std::error_code ec;
+		auto writeTime = std::filesystem::last_write_time(path, ec);
+		if(!ec && writeTime != loadedWriteTime)
+		{
+			std::string error;
+			std::vector<uint8_t> diskData = ReadFile(error);
+			if(!diskData.empty())
+			{
+				vk::PipelineCacheCreateInfo createInfo;
+				createInfo.initialDataSize	= diskData.size();
+				createInfo.pInitialData		= diskData.data();
+				vk::raii::PipelineCache diskCache(*device, createInfo);
+				cache.merge(*diskCache);
+			}
+		}
+		std::vector<uint8_t> data = cache.getData();
+		FileHeader header = MakeHeader(data);
+		//write next to the target and rename, readers never see a partial file
+		std::filesystem::path tempPath = path;
+		tempPath += ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if(!file.is_open())
+				throw std::runtime_error("failed to open " + tempPath.string());
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+			if(!file)
+			{
+				file.close();
+				std::filesystem::remove(tempPath, ec);
+				throw std::runtime_error("failed to write " + tempPath.string());
+			}
+		}
+		std::filesystem::rename(tempPath, path, ec);
+		if(ec)
+		{
+			std::filesystem::remove(tempPath, ec);
+			throw std::runtime_error("failed to replace " + path.string());
+		}
+		loadedWriteTime = std::filesystem::last_write_time(path, ec);
+		return true;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "pipeline cache: save failed: " << e.what() << std::endl;
+		return false;
+	}
+}
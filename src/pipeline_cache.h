@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+//VkPipelineCache persisted between runs.
+//The file is only accepted when it was written by the same vendor, device, driver version and pipelineCacheUUID;
+//anything else (stale driver, truncated or corrupt file) falls back to an empty cache.
+class PersistentPipelineCache
+{
+	public:
+		void Open(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, const std::string& path);
+		//merges whatever another process wrote since Open and replaces the file atomically
+		//returns false (and keeps the old file) on failure
+		bool Save();
+		const vk::raii::PipelineCache& Cache() const { return cache; }
+		//true if the cache was seeded from disk
+		bool IsWarm() const { return warm; }
+	private:
+		struct FileHeader
+		{
+			uint32_t	magic;
+			uint32_t	version;
+			uint32_t	vendorID;
+			uint32_t	deviceID;
+			uint32_t	driverVersion;
+			uint8_t		pipelineCacheUUID[VK_UUID_SIZE];
+			uint64_t	dataSize;
+			uint64_t	checksum;
+		};
+		//returns the cache data of a valid file, or an empty vector with the reason in error
+		std::vector<uint8_t> ReadFile(std::string& error) const;
+		FileHeader MakeHeader(const std::vector<uint8_t>& data) const;
+
+		const vk::raii::Device*				device = nullptr;
+		vk::PhysicalDeviceProperties		properties;
+		std::filesystem::path				path;
+		std::filesystem::file_time_type		loadedWriteTime{};
+		vk::raii::PipelineCache				cache = nullptr;
+		bool								warm = false;
+};
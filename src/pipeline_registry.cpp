@@ -0,0 +1,294 @@
+#include "pipeline_registry.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+
+#include "trace.h"
+
+namespace
+{
+	void HashCombine(uint64_t& hash, uint64_t value)
+	{
+		//FNV-1a over the 8 bytes of value
+		for(int i = 0; i < 8; i++)
+		{
+			hash ^= (value >> (i * 8)) & 0xff;
+			hash *= 0x100000001b3ull;
+		}
+	}
+
+	uint64_t HandleValue(auto handle)
+	{
+		return reinterpret_cast<uint64_t>(static_cast<typename decltype(handle)::CType>(handle));
+	}
+
+	double ElapsedMs(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+uint64_t PipelineDesc::Hash() const
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	HashCombine(hash, HandleValue(shaderModule));
+	HashCombine(hash, std::hash<std::string>{}(vertexEntry));
+	HashCombine(hash, std::hash<std::string>{}(fragmentEntry));
+	HashCombine(hash, HandleValue(layout));
+	HashCombine(hash, static_cast<uint64_t>(topology));
+	HashCombine(hash, static_cast<uint64_t>(polygonMode));
+	HashCombine(hash, static_cast<uint64_t>(static_cast<VkCullModeFlags>(cullMode)));
+	HashCombine(hash, static_cast<uint64_t>(frontFace));
+	HashCombine(hash, static_cast<uint64_t>(blendMode));
+	HashCombine(hash, static_cast<uint64_t>(colorFormat));
+	HashCombine(hash, static_cast<uint64_t>(depthFormat));
+	HashCombine(hash, shaderFeatures);
+	return hash;
+}
+
+void PipelineRegistry::Init(const vk::raii::Device& device, const vk::raii::PipelineCache& cache, size_t threadCount)
+{
+	this->device	= &device;
+	this->cache		= &cache;
+	pool			= std::make_unique<ThreadPool>(threadCount);
+}
+
+PipelineRegistry::Entry& PipelineRegistry::Insert(Key key, const PipelineDesc& desc)
+{
+	auto [it, inserted] = entries.try_emplace(key);
+	if(!inserted && !(it->second.desc == desc))
+		throw std::runtime_error("pipeline registry: hash collision between two pipeline descriptions");
+	if(inserted)
+	{
+		it->second.desc = desc;
+		stats.requested++;
+	}
+	return it->second;
+}
+
+PipelineRegistry::Key PipelineRegistry::Build(const PipelineDesc& desc)
+{
+	Key key = desc.Hash();
+	std::promise<vk::Pipeline> promise;
+	std::shared_future<vk::Pipeline> queued;
+	{
+		std::lock_guard lock(mutex);
+		Entry& entry = Insert(key, desc);
+		if(entry.future.valid())
+			queued = entry.future;
+		else
+		{
+			entry.future = promise.get_future().share();
+			stats.pending++;
+		}
+	}
+	if(queued.valid())
+	{
+		//already queued, waiting is cheaper than compiling twice
+		queued.get();
+		return key;
+	}
+	auto start = std::chrono::steady_clock::now();
+	try
+	{
+		promise.set_value(Finish(key, Compile(desc), ElapsedMs(start)));
+	}
+	catch(...)
+	{
+		Fail();
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+	return key;
+}
+
+std::shared_future<vk::Pipeline> PipelineRegistry::Request(const PipelineDesc& desc)
+{
+	Key key = desc.Hash();
+	std::lock_guard lock(mutex);
+	Entry& entry = Insert(key, desc);
+	if(entry.future.valid())
+		return entry.future;
+	stats.pending++;
+	//the worker looks its entry up again, the map may rehash in the meantime
+	entry.future = pool->Submit([this, key, desc]() -> vk::Pipeline {
+		auto start = std::chrono::steady_clock::now();
+		try
+		{
+			vk::raii::Pipeline pipeline = Compile(desc);
+			return Finish(key, std::move(pipeline), ElapsedMs(start));
+		}
+		catch(...)
+		{
+			Fail();
+			throw;
+		}
+	}).share();
+	return entry.future;
+}
+
+vk::Pipeline PipelineRegistry::Finish(Key key, vk::raii::Pipeline&& pipeline, double ms)
+{
+	std::lock_guard lock(mutex);
+	Entry& entry		= entries.at(key);
+	entry.pipeline		= std::make_unique<vk::raii::Pipeline>(std::move(pipeline));
+	entry.ready			= true;
+	stats.pending--;
+	stats.compiled++;
+	stats.totalCompileMs += ms;
+	stats.maxCompileMs	= std::max(stats.maxCompileMs, ms);
+	return **entry.pipeline;
+}
+
+void PipelineRegistry::Fail()
+{
+	std::lock_guard lock(mutex);
+	stats.pending--;
+	stats.failed++;
+}
+
+vk::Pipeline PipelineRegistry::Resolve(Key key, Key fallback)
+{
+	std::lock_guard lock(mutex);
+	auto it = entries.find(key);
+	if(it != entries.end() && it->second.ready)
+		return **it->second.pipeline;
+	stats.fallbackDraws++;
+	const Entry& entry = entries.at(fallback);
+	assert(entry.ready && "fallback pipeline has to be built synchronously");
+	return **entry.pipeline;
+}
+
+bool PipelineRegistry::IsReady(Key key) const
+{
+	std::lock_guard lock(mutex);
+	auto it = entries.find(key);
+	return it != entries.end() && it->second.ready;
+}
+
+PipelineRegistryStats PipelineRegistry::Stats() const
+{
+	std::lock_guard lock(mutex);
+	return stats;
+}
+
+void PipelineRegistry::Clear()
+{
+	std::vector<std::shared_future<vk::Pipeline>> futures;
+	{
+		std::lock_guard lock(mutex);
+		for(auto& [key, entry] : entries)
+			if(entry.future.valid())
+				futures.push_back(entry.future);
+	}
+	for(auto& future : futures)
+		future.wait();
+	std::lock_guard lock(mutex);
+	entries.clear();
+}
+
+vk::raii::Pipeline PipelineRegistry::Compile(const PipelineDesc& desc) const
+{
+	TRACE_ZONE("CompilePipeline");
+	//every feature is specialized in both stages, constants a stage does not declare are ignored
+	constexpr uint32_t featureCount = static_cast<uint32_t>(ShaderFeature::Count);
+	std::array<vk::Bool32, featureCount> featureValues;
+	std::array<vk::SpecializationMapEntry, featureCount> featureEntries;
+	for(uint32_t i = 0; i < featureCount; i++)
+	{
+		featureValues[i]	= (desc.shaderFeatures >> i) & 1u;
+		featureEntries[i]	= vk::SpecializationMapEntry(i, i * sizeof(vk::Bool32), sizeof(vk::Bool32));
+	}
+	vk::SpecializationInfo specializationInfo(featureCount, featureEntries.data(), sizeof(featureValues), featureValues.data());
+
+	vk::PipelineShaderStageCreateInfo vertShaderStageInfo{};
+	vertShaderStageInfo.stage = vk::ShaderStageFlagBits::eVertex;
+	vertShaderStageInfo.module = desc.shaderModule;
+	vertShaderStageInfo.pName = desc.vertexEntry.c_str();
+	vertShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+	vk::PipelineShaderStageCreateInfo fragShaderStageInfo{};
+	fragShaderStageInfo.stage = vk::ShaderStageFlagBits::eFragment;
+	fragShaderStageInfo.module = desc.shaderModule;
+	fragShaderStageInfo.pName = desc.fragmentEntry.c_str();
+	fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+	vk::PipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+	//vertexMerge
+	vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
+	vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+	inputAssembly.topology = desc.topology;
+
+	vk::PipelineViewportStateCreateInfo viewportState;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	vk::PipelineRasterizationStateCreateInfo rasterizer;
+	rasterizer.depthClampEnable = vk::False;
+	rasterizer.rasterizerDiscardEnable = vk::False;
+	rasterizer.polygonMode = desc.polygonMode;
+	rasterizer.cullMode = desc.cullMode;
+	rasterizer.frontFace = desc.frontFace;
+	rasterizer.depthBiasEnable = vk::False;
+	rasterizer.depthBiasSlopeFactor = 1.0f;
+	rasterizer.lineWidth = 1.0f;
+
+	vk::PipelineMultisampleStateCreateInfo multisampling;
+	multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
+	multisampling.sampleShadingEnable = vk::False;
+
+	vk::PipelineDepthStencilStateCreateInfo depthStencil;
+	depthStencil.depthTestEnable = desc.depthFormat != vk::Format::eUndefined;
+	depthStencil.depthWriteEnable = desc.depthFormat != vk::Format::eUndefined && desc.blendMode == BlendMode::Opaque;
+	depthStencil.depthCompareOp = vk::CompareOp::eLessOrEqual;
+
+	vk::PipelineColorBlendAttachmentState colorBlendAttachemnt;
+	colorBlendAttachemnt.blendEnable = desc.blendMode != BlendMode::Opaque;
+	colorBlendAttachemnt.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+	colorBlendAttachemnt.dstColorBlendFactor = desc.blendMode == BlendMode::Additive ? vk::BlendFactor::eOne : vk::BlendFactor::eOneMinusSrcAlpha;
+	colorBlendAttachemnt.colorBlendOp = vk::BlendOp::eAdd;
+	colorBlendAttachemnt.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+	colorBlendAttachemnt.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+	colorBlendAttachemnt.alphaBlendOp = vk::BlendOp::eAdd;
+	colorBlendAttachemnt.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+
+	vk::PipelineColorBlendStateCreateInfo colorBlending;
+	colorBlending.logicOpEnable = vk::False;
+	colorBlending.logicOp = vk::LogicOp::eCopy;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachemnt;
+
+	std::vector dynamicStates={
+		vk::DynamicState::eViewport,
+		vk::DynamicState::eScissor
+	};
+	vk::PipelineDynamicStateCreateInfo dynamicState;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	vk::GraphicsPipelineCreateInfo gpinfo;
+	gpinfo.stageCount = 2;
+	gpinfo.pStages = shaderStages;
+	gpinfo.pVertexInputState = &vertexInputInfo;
+	gpinfo.pInputAssemblyState = &inputAssembly;
+	gpinfo.pViewportState = &viewportState;
+	gpinfo.pRasterizationState = &rasterizer;
+	gpinfo.pMultisampleState = &multisampling;
+	gpinfo.pDepthStencilState = &depthStencil;
+	gpinfo.pColorBlendState = &colorBlending;
+	gpinfo.pDynamicState = &dynamicState;
+	gpinfo.layout = desc.layout;
+	gpinfo.renderPass = nullptr;
+
+	vk::PipelineRenderingCreateInfo pginfo;
+	pginfo.colorAttachmentCount = 1;
+	pginfo.pColorAttachmentFormats = &desc.colorFormat;
+	pginfo.depthAttachmentFormat = desc.depthFormat;
+
+	vk::StructureChain<vk::GraphicsPipelineCreateInfo, vk::PipelineRenderingCreateInfo> pipelineCreateInfoChain = {gpinfo, pginfo};
+	//pipeline creation is thread safe, the cache synchronizes internally
+	return vk::raii::Pipeline(*device, *cache, pipelineCreateInfoChain.get<vk::GraphicsPipelineCreateInfo>());
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "thread_pool.h"
+
+enum class BlendMode : uint32_t
+{
+	Opaque,
+	Alpha,
+	Additive
+};
+
+//Shader variants, ShaderFeature n is the VkBool32 specialization constant [vk::constant_id(n)] in shader.slang.
+//One module serves every combination, the driver folds the constants away at pipeline compile time.
+enum class ShaderFeature : uint32_t
+{
+	//sample the bindless texture in fragMain
+	Texture,
+	//interpolated vertex color, white without it
+	VertexColor,
+	//output the tint alpha instead of 1, for the blended modes
+	TintAlpha,
+	Count
+};
+
+constexpr uint32_t ShaderFeatureBit(ShaderFeature feature)
+{
+	return 1u << static_cast<uint32_t>(feature);
+}
+
+//Full description of a graphics pipeline variant, the registry key is its hash
+struct PipelineDesc
+{
+	vk::ShaderModule		shaderModule;
+	std::string				vertexEntry		= "vertMain";
+	std::string				fragmentEntry	= "fragMain";
+	vk::PipelineLayout		layout;
+	vk::PrimitiveTopology	topology		= vk::PrimitiveTopology::eTriangleList;
+	vk::PolygonMode			polygonMode		= vk::PolygonMode::eFill;
+	vk::CullModeFlags		cullMode		= vk::CullModeFlagBits::eBack;
+	vk::FrontFace			frontFace		= vk::FrontFace::eClockwise;
+	BlendMode				blendMode		= BlendMode::Opaque;
+	vk::Format				colorFormat		= vk::Format::eUndefined;
+	vk::Format				depthFormat		= vk::Format::eUndefined;
+	//ShaderFeatureBit mask
+	uint32_t				shaderFeatures	= ShaderFeatureBit(ShaderFeature::VertexColor);
+
+	uint64_t Hash() const;
+	bool operator==(const PipelineDesc&) const = default;
+};
+
+struct PipelineRegistryStats
+{
+	uint32_t	requested		= 0;
+	uint32_t	compiled		= 0;
+	uint32_t	failed			= 0;
+	uint32_t	pending			= 0;
+	double		totalCompileMs	= 0.0;
+	double		maxCompileMs	= 0.0;
+	//Resolve calls answered with the fallback pipeline
+	uint64_t	fallbackDraws	= 0;
+};
+
+//Owns every pipeline variant. Variants compile on a worker pool; until one is ready
+//Resolve hands out the fallback so the frame loop never waits on the driver.
+class PipelineRegistry
+{
+	public:
+		using Key = uint64_t;
+		void Init(const vk::raii::Device& device, const vk::raii::PipelineCache& cache, size_t threadCount);
+		//compiles on the calling thread, for the fallback pipeline that has to exist before the first frame
+		Key Build(const PipelineDesc& desc);
+		//queues an asynchronous compile, requesting a known variant returns its existing future
+		std::shared_future<vk::Pipeline> Request(const PipelineDesc& desc);
+		//ready pipeline for key, otherwise the fallback
+		vk::Pipeline Resolve(Key key, Key fallback);
+		bool IsReady(Key key) const;
+		PipelineRegistryStats Stats() const;
+		//blocks until every queued variant finished, then destroys them
+		void Clear();
+	private:
+		struct Entry
+		{
+			PipelineDesc						desc;
+			std::shared_future<vk::Pipeline>	future;
+			std::unique_ptr<vk::raii::Pipeline>	pipeline;
+			bool								ready = false;
+		};
+		vk::raii::Pipeline Compile(const PipelineDesc& desc) const;
+		vk::Pipeline Finish(Key key, vk::raii::Pipeline&& pipeline, double ms);
+		void Fail();
+		Entry& Insert(Key key, const PipelineDesc& desc);
+
+		const vk::raii::Device*				device = nullptr;
+		const vk::raii::PipelineCache*		cache = nullptr;
+		mutable std::mutex					mutex;
+		std::unordered_map<Key, Entry>		entries;
+		PipelineRegistryStats				stats;
+		//declared last: joins the workers before the entries they write to go away
+		std::unique_ptr<ThreadPool>			pool;
+};
@@ -0,0 +1,477 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+#include "trace.h"
+
+namespace
+{
+	struct UsageInfo
+	{
+		vk::PipelineStageFlags2	stages;
+		vk::AccessFlags2		access;
+		//eUndefined for the buffer only usages
+		vk::ImageLayout			layout = vk::ImageLayout::eUndefined;
+		bool					write = false;
+		vk::ImageUsageFlags		imageUsage;
+	};
+
+	constexpr vk::AccessFlags2 WRITE_ACCESS = vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+											  vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferWrite;
+
+	UsageInfo Describe(ResourceUsage usage)
+	{
+		using Stage = vk::PipelineStageFlagBits2;
+		using Access = vk::AccessFlagBits2;
+		using Layout = vk::ImageLayout;
+		using Image = vk::ImageUsageFlagBits;
+		switch(usage)
+		{
+			case ResourceUsage::None:
+				return {};
+			case ResourceUsage::ColorAttachment:
+				return {Stage::eColorAttachmentOutput, Access::eColorAttachmentRead | Access::eColorAttachmentWrite, Layout::eColorAttachmentOptimal, true, Image::eColorAttachment};
+			case ResourceUsage::DepthAttachment:
+				return {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite,
+						Layout::eDepthAttachmentOptimal, true, Image::eDepthStencilAttachment};
+			case ResourceUsage::SampledFragment:
+				return {Stage::eFragmentShader, Access::eShaderSampledRead, Layout::eShaderReadOnlyOptimal, false, Image::eSampled};
+			case ResourceUsage::StorageReadCompute:
+				return {Stage::eComputeShader, Access::eShaderStorageRead, Layout::eGeneral, false, Image::eStorage};
+			case ResourceUsage::StorageWriteCompute:
+				return {Stage::eComputeShader, Access::eShaderStorageRead | Access::eShaderStorageWrite, Layout::eGeneral, true, Image::eStorage};
+			case ResourceUsage::IndirectRead:
+				return {Stage::eDrawIndirect, Access::eIndirectCommandRead};
+			case ResourceUsage::StorageReadVertex:
+				return {Stage::eVertexShader, Access::eShaderStorageRead, Layout::eGeneral, false, Image::eStorage};
+			//all transfer stages, vkCmdUpdateBuffer and the clears included
+			case ResourceUsage::TransferSrc:
+				return {Stage::eAllTransfer, Access::eTransferRead, Layout::eTransferSrcOptimal, false, Image::eTransferSrc};
+			case ResourceUsage::TransferDst:
+				return {Stage::eAllTransfer, Access::eTransferWrite, Layout::eTransferDstOptimal, true, Image::eTransferDst};
+			case ResourceUsage::Present:
+				return {Stage::eBottomOfPipe, {}, Layout::ePresentSrcKHR};
+			case ResourceUsage::HostRead:
+				return {Stage::eHost, Access::eHostRead};
+		}
+		return {};
+	}
+
+	void HashCombine(uint64_t& hash, uint64_t value)
+	{
+		//FNV-1a over the 8 bytes of value
+		for(int i = 0; i < 8; i++)
+		{
+			hash ^= (value >> (i * 8)) & 0xff;
+			hash *= 0x100000001b3ull;
+		}
+	}
+
+	//what a transient needs over the whole frame, the passes it lives in included
+	struct TransientInfo
+	{
+		uint32_t				resource = 0;
+		uint32_t				firstPass = ~0u;
+		uint32_t				lastPass = 0;
+		vk::ImageUsageFlags		usage;
+		vk::PipelineStageFlags2	stages;
+		vk::AccessFlags2		access;
+	};
+
+	struct Placement
+	{
+		uint32_t		heap = 0;
+		vk::DeviceSize	offset = 0;
+		vk::DeviceSize	size = 0;
+	};
+
+	struct Heap
+	{
+		uint32_t				typeBits = ~0u;
+		vk::DeviceSize			alignment = 1;
+		vk::DeviceSize			size = 0;
+		std::vector<uint32_t>	members;
+	};
+
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool LifetimesOverlap(const TransientInfo& a, const TransientInfo& b)
+	{
+		return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+	}
+
+	bool MemoryOverlaps(const Placement& a, const Placement& b)
+	{
+		return a.heap == b.heap && a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+	}
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Use(Resource resource, ResourceUsage usage)
+{
+	graph.passes[pass].uses.push_back({resource, usage});
+	return *this;
+}
+
+RenderGraph::TransientSet::~TransientSet()
+{
+	//the images go before the memory they are bound to
+	views.clear();
+	images.clear();
+	for(GpuAllocation& allocation : memory)
+		allocator->Free(allocation);
+}
+
+void RenderGraph::Init(const vk::raii::Device& device, GpuAllocator& allocator, DeferredDeletionQueue& deletionQueue)
+{
+	this->device		= &device;
+	this->allocator		= &allocator;
+	this->deletionQueue	= &deletionQueue;
+}
+
+void RenderGraph::Reset()
+{
+	resources.clear();
+	passes.clear();
+}
+
+RenderGraph::Resource RenderGraph::ImportImage(const char* name, const ImportedImage& image)
+{
+	ResourceEntry& entry	= resources.emplace_back();
+	entry.name				= name;
+	entry.isImage			= true;
+	entry.image				= image.image;
+	entry.view				= image.view;
+	entry.aspect			= image.aspect;
+	entry.finalUsage		= image.finalUsage;
+	entry.state.layout		= image.initialLayout;
+	entry.state.writeStages	= image.initialStages;
+	return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::ImportBuffer(const char* name, const BufferRange& range, ResourceUsage finalUsage)
+{
+	ResourceEntry& entry	= resources.emplace_back();
+	entry.name				= name;
+	entry.buffer			= range;
+	entry.finalUsage		= finalUsage;
+	return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::CreateImage(const char* name, const TransientImageDesc& desc)
+{
+	ResourceEntry& entry	= resources.emplace_back();
+	entry.name				= name;
+	entry.isImage			= true;
+	entry.transient			= true;
+	entry.aspect			= desc.aspect;
+	entry.desc				= desc;
+	return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::AddPass(const char* name, RecordFunction record)
+{
+	Pass& pass	= passes.emplace_back();
+	pass.name	= name;
+	pass.record	= std::move(record);
+	return PassBuilder(*this, static_cast<uint32_t>(passes.size() - 1));
+}
+
+vk::Image RenderGraph::Image(Resource resource) const
+{
+	return resources[resource].image;
+}
+
+vk::ImageView RenderGraph::View(Resource resource) const
+{
+	return resources[resource].view;
+}
+
+void RenderGraph::RealizeTransients(uint64_t retireValue)
+{
+	std::vector<TransientInfo> infos;
+	for(uint32_t i = 0; i < resources.size(); i++)
+	{
+		if(resources[i].transient)
+			infos.push_back({i});
+	}
+	if(infos.empty())
+		return;
+	for(uint32_t p = 0; p < passes.size(); p++)
+	{
+		for(const ResourceUse& use : passes[p].uses)
+		{
+			auto info = std::ranges::find(infos, use.resource, &TransientInfo::resource);
+			if(info == infos.end())
+				continue;
+			UsageInfo usage		= Describe(use.usage);
+			info->firstPass		= std::min(info->firstPass, p);
+			info->lastPass		= std::max(info->lastPass, p);
+			info->usage			|= usage.imageUsage;
+			info->stages		|= usage.stages;
+			info->access		|= usage.access & WRITE_ACCESS;
+		}
+	}
+	//no pass uses it, nothing to create
+	std::erase_if(infos, [](const TransientInfo& info){ return info.firstPass == ~0u; });
+	//the frame layout repeats, the images and their aliasing only change with it
+	uint64_t signature = 0xcbf29ce484222325ull;
+	for(const TransientInfo& info : infos)
+	{
+		const TransientImageDesc& desc = resources[info.resource].desc;
+		HashCombine(signature, static_cast<uint64_t>(desc.format));
+		HashCombine(signature, (static_cast<uint64_t>(desc.extent.width) << 32) | desc.extent.height);
+		HashCombine(signature, static_cast<uint64_t>(static_cast<VkImageAspectFlags>(desc.aspect)));
+		HashCombine(signature, (static_cast<uint64_t>(info.firstPass) << 32) | info.lastPass);
+		HashCombine(signature, static_cast<uint64_t>(static_cast<VkImageUsageFlags>(info.usage)));
+		HashCombine(signature, static_cast<uint64_t>(info.stages));
+		HashCombine(signature, static_cast<uint64_t>(info.access));
+	}
+	if(!transients || transients->signature != signature)
+	{
+		auto set		= std::make_unique<TransientSet>();
+		set->allocator	= allocator;
+		set->signature	= signature;
+		std::vector<vk::MemoryRequirements> requirements;
+		for(const TransientInfo& info : infos)
+		{
+			const TransientImageDesc& desc = resources[info.resource].desc;
+			vk::ImageCreateInfo imageInfo;
+			imageInfo.imageType		= vk::ImageType::e2D;
+			imageInfo.format		= desc.format;
+			imageInfo.extent		= vk::Extent3D{desc.extent.width, desc.extent.height, 1};
+			imageInfo.mipLevels		= 1;
+			imageInfo.arrayLayers	= 1;
+			imageInfo.samples		= vk::SampleCountFlagBits::e1;
+			imageInfo.tiling		= vk::ImageTiling::eOptimal;
+			imageInfo.usage			= info.usage;
+			imageInfo.sharingMode	= vk::SharingMode::eExclusive;
+			imageInfo.initialLayout	= vk::ImageLayout::eUndefined;
+			set->images.emplace_back(*device, imageInfo);
+			requirements.push_back(set->images.back().getMemoryRequirements());
+			set->requestedBytes += requirements.back().size;
+		}
+		//largest first, each one at the lowest offset no transient alive at the same time occupies
+		std::vector<uint32_t> order(infos.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::ranges::stable_sort(order, std::greater{}, [&requirements](uint32_t i){ return requirements[i].size; });
+		std::vector<Placement> placements(infos.size());
+		std::vector<Heap> heaps;
+		for(uint32_t i : order)
+		{
+			const vk::MemoryRequirements& required = requirements[i];
+			auto heap = std::ranges::find_if(heaps, [&required](const Heap& heap){ return (heap.typeBits & required.memoryTypeBits) != 0; });
+			if(heap == heaps.end())
+				heap = heaps.emplace(heaps.end());
+			Placement placement;
+			placement.heap	= static_cast<uint32_t>(heap - heaps.begin());
+			placement.size	= required.size;
+			//candidates are the start of the heap and the end of every member, the lowest free one wins
+			std::vector<vk::DeviceSize> candidates{0};
+			for(uint32_t member : heap->members)
+				candidates.push_back(AlignUp(placements[member].offset + placements[member].size, required.alignment));
+			std::ranges::sort(candidates);
+			for(vk::DeviceSize candidate : candidates)
+			{
+				placement.offset = candidate;
+				bool collides = std::ranges::any_of(heap->members, [&](uint32_t member){
+					return LifetimesOverlap(infos[i], infos[member]) && MemoryOverlaps(placement, placements[member]); });
+				if(!collides)
+					break;
+			}
+			placements[i]	= placement;
+			heap->typeBits	&= required.memoryTypeBits;
+			heap->alignment	= std::max(heap->alignment, required.alignment);
+			heap->size		= std::max(heap->size, placement.offset + placement.size);
+			heap->members.push_back(i);
+		}
+		for(const Heap& heap : heaps)
+		{
+			vk::MemoryRequirements heapRequirements(heap.size, heap.alignment, heap.typeBits);
+			set->memory.push_back(allocator->Allocate(heapRequirements, vk::MemoryPropertyFlagBits::eDeviceLocal, {}, ResourceTiling::Optimal));
+			set->boundBytes += heap.size;
+		}
+		for(size_t i = 0; i < infos.size(); i++)
+		{
+			const GpuAllocation& memory = set->memory[placements[i].heap];
+			set->images[i].bindMemory(memory.memory, memory.offset + placements[i].offset);
+			const TransientImageDesc& desc = resources[infos[i].resource].desc;
+			vk::ImageViewCreateInfo viewInfo;
+			viewInfo.image				= *set->images[i];
+			viewInfo.viewType			= vk::ImageViewType::e2D;
+			viewInfo.format				= desc.format;
+			viewInfo.subresourceRange	= vk::ImageSubresourceRange(desc.aspect, 0, 1, 0, 1);
+			set->views.emplace_back(*device, viewInfo);
+			//whatever used the memory last, earlier in this frame or in the previous one, has to be done with it
+			vk::PipelineStageFlags2 stages;
+			vk::AccessFlags2 access;
+			for(size_t j = 0; j < infos.size(); j++)
+			{
+				if(MemoryOverlaps(placements[i], placements[j]))
+				{
+					stages |= infos[j].stages;
+					access |= infos[j].access;
+				}
+			}
+			set->aliasStages.push_back(stages);
+			set->aliasAccess.push_back(access);
+		}
+		if(transients)
+			deletionQueue->Push(retireValue, std::move(transients));
+		transients = std::move(set);
+	}
+	for(uint32_t i = 0; i < infos.size(); i++)
+	{
+		ResourceEntry& entry	= resources[infos[i].resource];
+		entry.physical			= i;
+		entry.image				= *transients->images[i];
+		entry.view				= *transients->views[i];
+		entry.state				= State{};
+		entry.state.writeStages	= transients->aliasStages[i];
+		entry.state.writeAccess	= transients->aliasAccess[i];
+	}
+	stats.transientImages	= static_cast<uint32_t>(infos.size());
+	stats.transientBytes	= transients->requestedBytes;
+	stats.transientMemory	= transients->boundBytes;
+}
+
+void RenderGraph::AddBarrier(ResourceEntry& resource, vk::PipelineStageFlags2 stages, vk::AccessFlags2 access, vk::ImageLayout layout, bool write)
+{
+	State& state = resource.state;
+	bool transition = resource.isImage && layout != state.layout;
+	vk::PipelineStageFlags2 srcStages;
+	if(transition || write)
+	{
+		//write after write, write after read and layout changes wait for every earlier access
+		srcStages = state.writeStages | state.readStages;
+		if(!transition && !srcStages)
+		{
+			state.writeStages	= stages;
+			state.writeAccess	= access & WRITE_ACCESS;
+			state.visibleStages	= stages;
+			state.visibleAccess	= access;
+			return;
+		}
+	}
+	else
+	{
+		//read after read needs nothing, a read the last barrier already covers neither
+		state.readStages |= stages;
+		if(!state.writeStages || ((stages & ~state.visibleStages) == vk::PipelineStageFlags2{} && (access & ~state.visibleAccess) == vk::AccessFlags2{}))
+			return;
+		srcStages = state.writeStages;
+	}
+	if(resource.isImage)
+	{
+		vk::ImageMemoryBarrier2& barrier = imageBarriers.emplace_back();
+		barrier.srcStageMask		= srcStages;
+		barrier.srcAccessMask		= state.writeAccess;
+		barrier.dstStageMask		= stages;
+		barrier.dstAccessMask		= access;
+		barrier.oldLayout			= state.layout;
+		barrier.newLayout			= layout;
+		barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.image				= resource.image;
+		barrier.subresourceRange	= vk::ImageSubresourceRange(resource.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS);
+	}
+	else
+	{
+		vk::BufferMemoryBarrier2& barrier = bufferBarriers.emplace_back();
+		barrier.srcStageMask		= srcStages;
+		barrier.srcAccessMask		= state.writeAccess;
+		barrier.dstStageMask		= stages;
+		barrier.dstAccessMask		= access;
+		barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer				= resource.buffer.buffer;
+		barrier.offset				= resource.buffer.offset;
+		barrier.size				= resource.buffer.size;
+	}
+	if(transition || write)
+	{
+		//a transition is a write too, later readers in other stages wait for it
+		state.layout		= resource.isImage ? layout : state.layout;
+		state.writeStages	= stages;
+		state.writeAccess	= access & WRITE_ACCESS;
+		state.readStages	= write ? vk::PipelineStageFlags2{} : stages;
+		state.visibleStages	= stages;
+		state.visibleAccess	= access;
+	}
+	else
+	{
+		state.visibleStages	|= stages;
+		state.visibleAccess	|= access;
+	}
+}
+
+void RenderGraph::FlushBarriers(const vk::raii::CommandBuffer& commandBuffer)
+{
+	if(imageBarriers.empty() && bufferBarriers.empty())
+		return;
+	vk::DependencyInfo dependencyInfo;
+	dependencyInfo.imageMemoryBarrierCount	= static_cast<uint32_t>(imageBarriers.size());
+	dependencyInfo.pImageMemoryBarriers		= imageBarriers.data();
+	dependencyInfo.bufferMemoryBarrierCount	= static_cast<uint32_t>(bufferBarriers.size());
+	dependencyInfo.pBufferMemoryBarriers	= bufferBarriers.data();
+	commandBuffer.pipelineBarrier2(dependencyInfo);
+	stats.barriers += static_cast<uint32_t>(imageBarriers.size() + bufferBarriers.size());
+	stats.barrierBatches++;
+	imageBarriers.clear();
+	bufferBarriers.clear();
+}
+
+void RenderGraph::Execute(const vk::raii::CommandBuffer& commandBuffer, uint64_t retireValue)
+{
+	stats = {};
+	stats.passes = static_cast<uint32_t>(passes.size());
+	RealizeTransients(retireValue);
+	for(const Pass& pass : passes)
+	{
+		//uses of the same resource merge into one access, they have to agree on the layout
+		std::vector<ResourceUse> uses = pass.uses;
+		std::ranges::sort(uses, {}, &ResourceUse::resource);
+		for(size_t i = 0; i < uses.size();)
+		{
+			ResourceEntry& resource = resources[uses[i].resource];
+			UsageInfo merged = Describe(uses[i].usage);
+			size_t next = i + 1;
+			for(; next < uses.size() && uses[next].resource == uses[i].resource; next++)
+			{
+				UsageInfo usage = Describe(uses[next].usage);
+				if(resource.isImage && usage.layout != merged.layout)
+					throw std::runtime_error(std::string("render graph: conflicting layouts for ") + resource.name + " in pass " + pass.name);
+				merged.stages	|= usage.stages;
+				merged.access	|= usage.access;
+				merged.write	= merged.write || usage.write;
+			}
+			AddBarrier(resource, merged.stages, merged.access, merged.layout, merged.write);
+			i = next;
+		}
+		FlushBarriers(commandBuffer);
+		TRACE_ZONE(pass.name);
+		pass.record(commandBuffer);
+	}
+	//hand imported resources over in the state their next user expects
+	for(ResourceEntry& resource : resources)
+	{
+		if(resource.finalUsage != ResourceUsage::None)
+		{
+			UsageInfo usage = Describe(resource.finalUsage);
+			AddBarrier(resource, usage.stages, usage.access, usage.layout, usage.write);
+		}
+	}
+	FlushBarriers(commandBuffer);
+}
+
+void RenderGraph::PrintStats(std::ostream& out) const
+{
+	out << "render graph: " << stats.passes << " passes, " << stats.barriers << " barriers in " << stats.barrierBatches << " batches, "
+		<< stats.transientImages << " transient images, " << static_cast<double>(stats.transientBytes) / (1024.0 * 1024.0) << " MiB in "
+		<< static_cast<double>(stats.transientMemory) / (1024.0 * 1024.0) << " MiB of memory" << std::endl;
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "deferred_deletion.h"
+#include "gpu_allocator.h"
+
+//How a pass touches a resource; each one stands for the stages, access and image layout a barrier needs
+enum class ResourceUsage : uint8_t
+{
+	None,
+	ColorAttachment,
+	DepthAttachment,
+	SampledFragment,
+	StorageReadCompute,
+	//read and write
+	StorageWriteCompute,
+	IndirectRead,
+	StorageReadVertex,
+	TransferSrc,
+	TransferDst,
+	Present,
+	//mapped memory read after the frame completed
+	HostRead
+};
+
+struct BufferRange
+{
+	vk::Buffer		buffer;
+	vk::DeviceSize	offset	= 0;
+	vk::DeviceSize	size	= VK_WHOLE_SIZE;
+};
+
+//image owned outside the graph, the swapchain image for one
+struct ImportedImage
+{
+	vk::Image				image;
+	vk::ImageView			view;
+	vk::ImageAspectFlags	aspect			= vk::ImageAspectFlagBits::eColor;
+	vk::ImageLayout			initialLayout	= vk::ImageLayout::eUndefined;
+	//stages a semaphore wait already covers, the first barrier chains onto them
+	vk::PipelineStageFlags2	initialStages;
+	//state the image is left in after the last pass, None keeps whatever the last pass used
+	ResourceUsage			finalUsage		= ResourceUsage::None;
+};
+
+//image that only lives within the frame, created by the graph
+struct TransientImageDesc
+{
+	vk::Format				format	= vk::Format::eUndefined;
+	vk::Extent2D			extent;
+	vk::ImageAspectFlags	aspect	= vk::ImageAspectFlagBits::eColor;
+};
+
+struct RenderGraphStats
+{
+	uint32_t		passes				= 0;
+	uint32_t		barriers			= 0;
+	//pipelineBarrier2 calls, at most one per pass plus one for the final states
+	uint32_t		barrierBatches		= 0;
+	uint32_t		transientImages		= 0;
+	//transient bytes without aliasing and the memory actually bound
+	vk::DeviceSize	transientBytes		= 0;
+	vk::DeviceSize	transientMemory		= 0;
+};
+
+//Per frame render graph. Passes are declared in execution order together with the resources
+//they use; Execute derives the barriers from those declarations, merges every barrier in front
+//of a pass into one DependencyInfo and drops the ones a previous barrier already covers.
+//Transient images whose passes do not overlap share memory. Their memory is reused by every
+//frame: the first barrier of a transient waits on all uses of the memory it aliases.
+class RenderGraph
+{
+	public:
+		using Resource = uint32_t;
+		using RecordFunction = std::function<void(const vk::raii::CommandBuffer&)>;
+
+		class PassBuilder
+		{
+			public:
+				PassBuilder(RenderGraph& graph, uint32_t pass) : graph(graph), pass(pass){}
+				PassBuilder& Use(Resource resource, ResourceUsage usage);
+			private:
+				RenderGraph&	graph;
+				uint32_t		pass;
+		};
+
+		void Init(const vk::raii::Device& device, GpuAllocator& allocator, DeferredDeletionQueue& deletionQueue);
+		//starts declaring the next frame
+		void Reset();
+		Resource ImportImage(const char* name, const ImportedImage& image);
+		//buffers keep no layout, only the accesses of this frame are tracked; finalUsage as for images
+		Resource ImportBuffer(const char* name, const BufferRange& range, ResourceUsage finalUsage = ResourceUsage::None);
+		Resource CreateImage(const char* name, const TransientImageDesc& desc);
+		//record runs inside Execute, after the pass's barriers
+		PassBuilder AddPass(const char* name, RecordFunction record);
+		//records every pass; retireValue is the frame timeline value after which
+		//transient memory replaced by this call is no longer used
+		void Execute(const vk::raii::CommandBuffer& commandBuffer, uint64_t retireValue);
+		//valid for transients once Execute started, that is inside the record functions
+		vk::Image Image(Resource resource) const;
+		vk::ImageView View(Resource resource) const;
+		const RenderGraphStats& Stats() const { return stats; }
+		void PrintStats(std::ostream& out) const;
+	private:
+		//stages and accesses since the last write of a resource
+		struct State
+		{
+			vk::ImageLayout			layout = vk::ImageLayout::eUndefined;
+			vk::PipelineStageFlags2	writeStages;
+			vk::AccessFlags2		writeAccess;
+			//reads since the write, a later write has to wait for them
+			vk::PipelineStageFlags2	readStages;
+			//stages and accesses the last write is already visible to
+			vk::PipelineStageFlags2	visibleStages;
+			vk::AccessFlags2		visibleAccess;
+		};
+		struct ResourceEntry
+		{
+			const char*				name = "";
+			bool					isImage = false;
+			bool					transient = false;
+			vk::Image				image;
+			vk::ImageView			view;
+			vk::ImageAspectFlags	aspect;
+			BufferRange				buffer;
+			ResourceUsage			finalUsage = ResourceUsage::None;
+			TransientImageDesc		desc;
+			//index into the realized transients
+			uint32_t				physical = ~0u;
+			State					state;
+		};
+		struct ResourceUse
+		{
+			Resource		resource;
+			ResourceUsage	usage;
+		};
+		struct Pass
+		{
+			const char*			name = "";
+			RecordFunction		record;
+			std::vector<ResourceUse>	uses;
+		};
+		//the transients of one frame layout with their shared memory, retired as a whole
+		struct TransientSet
+		{
+			GpuAllocator*						allocator = nullptr;
+			uint64_t							signature = 0;
+			std::vector<vk::raii::Image>		images;
+			std::vector<vk::raii::ImageView>	views;
+			std::vector<GpuAllocation>			memory;
+			//stages and accesses of every transient overlapping each image's memory
+			std::vector<vk::PipelineStageFlags2>	aliasStages;
+			std::vector<vk::AccessFlags2>		aliasAccess;
+			vk::DeviceSize						requestedBytes = 0;
+			vk::DeviceSize						boundBytes = 0;
+			~TransientSet();
+		};
+		void RealizeTransients(uint64_t retireValue);
+		void AddBarrier(ResourceEntry& resource, vk::PipelineStageFlags2 stages, vk::AccessFlags2 access, vk::ImageLayout layout, bool write);
+		void FlushBarriers(const vk::raii::CommandBuffer& commandBuffer);
+
+		const vk::raii::Device*			device = nullptr;
+		GpuAllocator*					allocator = nullptr;
+		DeferredDeletionQueue*			deletionQueue = nullptr;
+		std::vector<ResourceEntry>		resources;
+		std::vector<Pass>				passes;
+		std::unique_ptr<TransientSet>	transients;
+		//barriers of the pass being recorded, kept to reuse their capacity
+		std::vector<vk::ImageMemoryBarrier2>	imageBarriers;
+		std::vector<vk::BufferMemoryBarrier2>	bufferBarriers;
+		RenderGraphStats				stats;
+};
@@ -0,0 +1,657 @@
+#include "render_server.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include "deferred_deletion.h"
+#include "draw_constants.h"
+#include "render_graph.h"
+#include "scene.h"
+#include "trace.h"
+#include "upload_ring.h"
+
+namespace
+{
+	//frames one worker keeps in flight, each with its own color target and command buffer
+	constexpr uint32_t JOB_FRAMES_IN_FLIGHT = 2;
+	//begin and end of every frame
+	constexpr uint32_t TIMESTAMPS_PER_FRAME = 2;
+	//per draw FrameData of one frame, bounds the draws of a job
+	constexpr vk::DeviceSize UPLOAD_REGION_SIZE = 16ull << 20;
+	//job frames are spaced like a 60 Hz run, the output only depends on the job
+	constexpr float JOB_FRAME_SECONDS = 1.0f / 60.0f;
+	//how often the socket listener checks whether a client asked to quit
+	constexpr int ACCEPT_POLL_MS = 100;
+
+	uint32_t ParseJobUInt(std::string_view key, std::string_view value)
+	{
+		uint32_t result = 0;
+		auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+		if(ec != std::errc() || ptr != value.data() + value.size())
+			throw std::runtime_error("invalid value for " + std::string(key) + ": " + std::string(value));
+		return result;
+	}
+
+	std::string_view Trim(std::string_view text)
+	{
+		constexpr std::string_view WHITESPACE = " \t\r\n";
+		size_t begin = text.find_first_not_of(WHITESPACE);
+		if(begin == std::string_view::npos)
+			return {};
+		return text.substr(begin, text.find_last_not_of(WHITESPACE) - begin + 1);
+	}
+
+	//the interactive renderer's zooming camera, jobs look like headless runs of the same grid
+	glm::mat4 JobCamera(float seconds)
+	{
+		float zoom = 1.25f + 0.75f * std::sin(seconds * 0.5f);
+		glm::mat4 camera(1.0f);
+		camera[0][0] = zoom;
+		camera[1][1] = zoom;
+		return camera;
+	}
+
+	double Milliseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+#ifndef _WIN32
+#ifdef MSG_NOSIGNAL
+	//a client that disconnected early must not take the server down with SIGPIPE
+	constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+	constexpr int SEND_FLAGS = 0;
+#endif
+
+	//one connected client, closed once its reader and every job answering to it are done
+	struct Client
+	{
+		int					fd = -1;
+		std::mutex			mutex;
+		std::atomic<bool>	done = false;
+		~Client()
+		{
+			if(fd >= 0)
+				close(fd);
+		}
+		void Send(const std::string& message)
+		{
+			std::string line = message + '\n';
+			std::lock_guard lock(mutex);
+			for(size_t sent = 0; sent < line.size();)
+			{
+				ssize_t written = send(fd, line.data() + sent, line.size() - sent, SEND_FLAGS);
+				//gone, its jobs still run to completion
+				if(written <= 0)
+					return;
+				sent += static_cast<size_t>(written);
+			}
+		}
+	};
+#endif
+}
+
+RenderJob ParseRenderJob(std::string_view line, const RenderJobLimits& limits)
+{
+	RenderJob job;
+	for(size_t pos = line.find_first_not_of(" \t"); pos != std::string_view::npos; pos = line.find_first_not_of(" \t", pos))
+	{
+		size_t end = std::min(line.find_first_of(" \t", pos), line.size());
+		std::string_view pair = line.substr(pos, end - pos);
+		pos = end;
+		size_t equals = pair.find('=');
+		if(equals == std::string_view::npos)
+			throw std::runtime_error("expected key=value: " + std::string(pair));
+		std::string_view key	= pair.substr(0, equals);
+		std::string_view value	= pair.substr(equals + 1);
+		if(key == "draws")
+			job.draws = ParseJobUInt(key, value);
+		else if(key == "width")
+			job.width = ParseJobUInt(key, value);
+		else if(key == "height")
+			job.height = ParseJobUInt(key, value);
+		else if(key == "frames")
+			job.frames = ParseJobUInt(key, value);
+		else if(key == "output")
+			job.output = value;
+		else if(key == "format")
+		{
+			if(value == "png")
+				job.format = CaptureFormat::Png;
+			else if(value == "raw")
+				job.format = CaptureFormat::Raw;
+			else
+				throw std::runtime_error("invalid value for format: " + std::string(value) + " (png or raw)");
+		}
+		//the server renders with the pipeline it started with, per job content is not supported yet
+		else if(key == "mesh" || key == "scene" || key == "texture")
+			throw std::runtime_error("jobs render the draw grid only, " + std::string(key) + " is not supported");
+		else
+			throw std::runtime_error("unknown job key: " + std::string(key));
+	}
+	if(job.output.empty())
+		throw std::runtime_error("job without output");
+	if(job.frames == 0)
+		throw std::runtime_error("frames must be greater than zero");
+	if(job.draws == 0 || job.draws > limits.maxDraws)
+		throw std::runtime_error("draws must be between 1 and " + std::to_string(limits.maxDraws));
+	if(job.width == 0 || job.height == 0 || job.width > limits.maxExtent || job.height > limits.maxExtent)
+		throw std::runtime_error("width and height must be between 1 and " + std::to_string(limits.maxExtent));
+	return job;
+}
+
+struct RenderServer::Worker
+{
+	uint32_t									queueSlot = 0;
+	const vk::raii::Queue*						queue = nullptr;
+	std::mutex*									queueMutex = nullptr;
+	//frame N of this worker signals value N, across jobs
+	vk::raii::Semaphore							timeline = nullptr;
+	uint64_t									submitted = 0;
+	std::array<uint64_t, JOB_FRAMES_IN_FLIGHT>	slotValues{};
+	vk::raii::QueryPool							timestamps = nullptr;
+	UploadRing									uploadRing;
+	//transients a job of another size replaced, until the worker's timeline passes them
+	DeferredDeletionQueue						deletionQueue;
+	RenderGraph									renderGraph;
+	std::thread									thread;
+
+	void WaitFor(const vk::raii::Device& device, uint64_t value) const
+	{
+		if(value == 0)
+			return;
+		vk::SemaphoreWaitInfo waitInfo;
+		waitInfo.semaphoreCount	= 1;
+		waitInfo.pSemaphores	= &*timeline;
+		waitInfo.pValues		= &value;
+		if(device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess)
+			throw std::runtime_error("render server: failed to wait for a worker timeline");
+	}
+};
+
+RenderServer::RenderServer() = default;
+
+RenderServer::~RenderServer() = default;
+
+void RenderServer::Run(const RenderServerDevice& device, const RenderServerConfig& config)
+{
+	if(device.queues.empty())
+		throw std::runtime_error("render server: no queues");
+	this->device = device;
+	for(size_t i = 0; i < device.queues.size(); i++)
+		queueMutexes.push_back(std::make_unique<std::mutex>());
+	stats.queueGpuMs.assign(device.queues.size(), 0.0);
+	//two jobs per queue: one records and reads back while the other one's frames execute
+	uint32_t workerCount = config.concurrentJobs != 0 ? config.concurrentJobs : static_cast<uint32_t>(2 * device.queues.size());
+	for(uint32_t i = 0; i < workerCount; i++)
+	{
+		auto worker = std::make_unique<Worker>();
+		worker->queueSlot	= i % static_cast<uint32_t>(device.queues.size());
+		worker->queue		= device.queues[worker->queueSlot];
+		worker->queueMutex	= queueMutexes[worker->queueSlot].get();
+		vk::SemaphoreTypeCreateInfo typeInfo;
+		typeInfo.semaphoreType	= vk::SemaphoreType::eTimeline;
+		typeInfo.initialValue	= 0;
+		vk::SemaphoreCreateInfo semaphoreInfo;
+		semaphoreInfo.pNext = &typeInfo;
+		worker->timeline = vk::raii::Semaphore(*device.device, semaphoreInfo);
+		if(device.timestampValidBits != 0)
+		{
+			vk::QueryPoolCreateInfo queryPoolInfo;
+			queryPoolInfo.queryType		= vk::QueryType::eTimestamp;
+			queryPoolInfo.queryCount	= TIMESTAMPS_PER_FRAME * JOB_FRAMES_IN_FLIGHT;
+			worker->timestamps = vk::raii::QueryPool(*device.device, queryPoolInfo);
+		}
+		worker->uploadRing.Init(*device.allocator, *device.physicalDevice, *device.device, UPLOAD_REGION_SIZE, JOB_FRAMES_IN_FLIGHT,
+								vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress);
+		worker->renderGraph.Init(*device.device, *device.allocator, worker->deletionQueue);
+		workers.push_back(std::move(worker));
+	}
+	//every visible draw pushes one FrameData into the worker's ring region of the frame
+	jobLimits.maxDraws	= static_cast<uint32_t>(std::min<vk::DeviceSize>(workers.front()->uploadRing.Capacity(sizeof(FrameData)), UINT32_MAX));
+	jobLimits.maxExtent	= device.physicalDevice->getProperties().limits.maxImageDimension2D;
+	for(auto& worker : workers)
+		worker->thread = std::thread([this, worker = worker.get()](){ WorkerLoop(*worker); });
+	std::cout << "render server: " << workerCount << " concurrent jobs on " << device.queues.size() << " queues, jobs from "
+			  << (config.source == "-" ? std::string("stdin") : config.source) << std::endl;
+
+	//accepted jobs finish even when the source fails
+	auto finish = [this](){
+		{
+			std::lock_guard lock(mutex);
+			closed = true;
+		}
+		jobAdded.notify_all();
+		for(auto& worker : workers)
+			worker->thread.join();
+		//every worker waited for its last frame, nothing is in use by the GPU anymore
+		workers.clear();
+	};
+	try
+	{
+		if(config.source == "-")
+			ReadStdin();
+		else
+			ServeSocket(config.source);
+	}
+	catch(...)
+	{
+		finish();
+		throw;
+	}
+	finish();
+}
+
+bool RenderServer::HandleLine(std::string_view line, const Reply& reply)
+{
+	line = Trim(line);
+	if(line.empty() || line.front() == '#')
+		return true;
+	if(line == "quit")
+		return false;
+	if(line == "stats")
+	{
+		reply(StatsLine());
+		return true;
+	}
+	try
+	{
+		RenderJob job = ParseRenderJob(line, jobLimits);
+		job.id = nextJobId++;
+		reply("queued " + std::to_string(job.id));
+		{
+			std::lock_guard lock(mutex);
+			if(!started)
+			{
+				firstJob	= std::chrono::steady_clock::now();
+				started		= true;
+			}
+			jobs.push_back({std::move(job), reply});
+		}
+		jobAdded.notify_one();
+	}
+	catch(const std::exception& e)
+	{
+		reply(std::string("error ") + e.what());
+	}
+	return true;
+}
+
+void RenderServer::ReadStdin()
+{
+	auto output = std::make_shared<std::mutex>();
+	Reply reply = [output](const std::string& message){
+		std::lock_guard lock(*output);
+		std::cout << message << std::endl;
+	};
+	std::string line;
+	while(std::getline(std::cin, line) && HandleLine(line, reply)){}
+}
+
+#ifdef _WIN32
+void RenderServer::ServeSocket(const std::string& path)
+{
+	throw std::runtime_error("render server: unix sockets are not supported on this platform, read jobs from stdin with --serve -");
+}
+#else
+void RenderServer::ServeSocket(const std::string& path)
+{
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("render server: socket path too long: " + path);
+	std::ranges::copy(path, address.sun_path);
+	//a socket file left behind by an earlier run fails the bind, anything else at the path is not ours to remove
+	struct stat existing;
+	if(lstat(path.c_str(), &existing) == 0)
+	{
+		if(!S_ISSOCK(existing.st_mode))
+			throw std::runtime_error("render server: " + path + " exists and is not a socket");
+		unlink(path.c_str());
+	}
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listener < 0)
+		throw std::runtime_error("render server: failed to create a socket");
+	if(bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+	{
+		close(listener);
+		throw std::runtime_error("render server: failed to listen on " + path);
+	}
+	struct Connection
+	{
+		std::shared_ptr<Client>	client;
+		std::thread				reader;
+	};
+	std::vector<Connection> connections;
+	std::atomic<bool> stopping = false;
+	while(!stopping)
+	{
+		//readers of closed connections are joined as new ones arrive
+		std::erase_if(connections, [](Connection& connection){
+			if(!connection.client->done)
+				return false;
+			connection.reader.join();
+			return true;
+		});
+		pollfd listening{listener, POLLIN, 0};
+		if(poll(&listening, 1, ACCEPT_POLL_MS) <= 0)
+			continue;
+		int fd = accept(listener, nullptr, nullptr);
+		if(fd < 0)
+			continue;
+		auto client = std::make_shared<Client>();
+		client->fd = fd;
+		std::thread reader([this, client, &stopping](){
+			TRACE_THREAD_NAME("render server client");
+			//jobs keep the client alive until they answered
+			Reply reply = [client](const std::string& message){ client->Send(message); };
+			std::string pending;
+			std::array<char, 4096> buffer;
+			for(ssize_t received = recv(client->fd, buffer.data(), buffer.size(), 0); received > 0 && !stopping;
+				received = recv(client->fd, buffer.data(), buffer.size(), 0))
+			{
+				pending.append(buffer.data(), static_cast<size_t>(received));
+				for(size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n'))
+				{
+					std::string line = pending.substr(0, end);
+					pending.erase(0, end + 1);
+					if(!HandleLine(line, reply))
+					{
+						stopping = true;
+						break;
+					}
+				}
+			}
+			client->done = true;
+		});
+		connections.push_back({std::move(client), std::move(reader)});
+	}
+	//readers blocked in recv return once their socket is shut down
+	for(Connection& connection : connections)
+	{
+		shutdown(connection.client->fd, SHUT_RD);
+		connection.reader.join();
+	}
+	close(listener);
+	if(lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+		unlink(path.c_str());
+}
+#endif
+
+void RenderServer::WorkerLoop(Worker& worker)
+{
+	TRACE_THREAD_NAME("render server worker");
+	for(;;)
+	{
+		QueuedJob queued;
+		{
+			std::unique_lock lock(mutex);
+			jobAdded.wait(lock, [this](){ return !jobs.empty() || closed; });
+			if(jobs.empty())
+				return;
+			queued = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		auto start = std::chrono::steady_clock::now();
+		double gpuMs = 0.0;
+		std::string error;
+		try
+		{
+			RenderJobFrames(worker, queued.job, gpuMs);
+		}
+		catch(const std::exception& e)
+		{
+			error = e.what();
+		}
+		auto end = std::chrono::steady_clock::now();
+		{
+			std::lock_guard lock(mutex);
+			if(error.empty())
+			{
+				stats.jobs++;
+				stats.frames += queued.job.frames;
+			}
+			else
+				stats.failed++;
+			stats.queueGpuMs[worker.queueSlot] += gpuMs;
+			lastDone = end;
+		}
+		std::ostringstream message;
+		message << std::fixed << std::setprecision(3);
+		if(error.empty())
+			message << "done " << queued.job.id << " frames=" << queued.job.frames << " ms=" << Milliseconds(end - start) << " gpu_ms=" << gpuMs;
+		else
+			message << "failed " << queued.job.id << " " << error;
+		queued.reply(message.str());
+	}
+}
+
+void RenderServer::RenderJobFrames(Worker& worker, const RenderJob& job, double& gpuMs)
+{
+	TRACE_ZONE("RenderServer::RenderJobFrames");
+	const vk::raii::Device& vkDevice = *device.device;
+	vk::Extent2D extent{job.width, job.height};
+	//the job's own targets, one per frame in flight so a frame never waits for the previous readback
+	vk::ImageCreateInfo imageInfo;
+	imageInfo.imageType		= vk::ImageType::e2D;
+	imageInfo.format		= device.colorFormat;
+	imageInfo.extent		= vk::Extent3D{extent.width, extent.height, 1};
+	imageInfo.mipLevels		= 1;
+	imageInfo.arrayLayers	= 1;
+	imageInfo.samples		= vk::SampleCountFlagBits::e1;
+	imageInfo.tiling		= vk::ImageTiling::eOptimal;
+	imageInfo.usage			= vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+	imageInfo.sharingMode	= vk::SharingMode::eExclusive;
+	imageInfo.initialLayout	= vk::ImageLayout::eUndefined;
+	std::vector<GpuImage> colors;
+	std::vector<vk::raii::ImageView> views;
+	for(uint32_t i = 0; i < JOB_FRAMES_IN_FLIGHT; i++)
+	{
+		const GpuImage& image = colors.emplace_back(device.allocator->CreateImage(imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal));
+		vk::ImageViewCreateInfo viewInfo;
+		viewInfo.image				= *image;
+		viewInfo.viewType			= vk::ImageViewType::e2D;
+		viewInfo.format				= device.colorFormat;
+		viewInfo.subresourceRange	= {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+		views.emplace_back(vkDevice, viewInfo);
+	}
+	vk::CommandPoolCreateInfo poolInfo;
+	poolInfo.flags				= vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+	poolInfo.queueFamilyIndex	= device.queueFamily;
+	vk::raii::CommandPool commandPool(vkDevice, poolInfo);
+	vk::CommandBufferAllocateInfo allocateInfo(*commandPool, vk::CommandBufferLevel::ePrimary, JOB_FRAMES_IN_FLIGHT);
+	vk::raii::CommandBuffers commandBuffers(vkDevice, allocateInfo);
+	FrameCaptureConfig captureConfig;
+	captureConfig.format		= job.format;
+	captureConfig.path			= job.output;
+	captureConfig.encodeThreads	= 1;
+	FrameCapture capture;
+	capture.Init(*device.physicalDevice, vkDevice, *device.allocator, device.colorFormat, JOB_FRAMES_IN_FLIGHT, captureConfig);
+	Scene scene;
+	AddDrawGrid(scene, job.draws, TRIANGLE_RADIUS);
+	scene.UpdateTransforms();
+	std::vector<Scene::Node> visible;
+
+	//frame GPU time, read once the slot's frame has completed
+	std::array<bool, JOB_FRAMES_IN_FLIGHT> timed{};
+	uint64_t timestampMask = device.timestampValidBits >= 64 ? ~0ull : (1ull << device.timestampValidBits) - 1;
+	auto collectTimestamps = [&](uint32_t slot){
+		if(!timed[slot])
+			return;
+		timed[slot] = false;
+		auto [result, ticks] = worker.timestamps.getResults<uint64_t>(TIMESTAMPS_PER_FRAME * slot, TIMESTAMPS_PER_FRAME, TIMESTAMPS_PER_FRAME * sizeof(uint64_t),
+																	  sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+		if(result == vk::Result::eSuccess)
+			gpuMs += static_cast<double>(((ticks[1] & timestampMask) - (ticks[0] & timestampMask)) & timestampMask) * device.timestampPeriod / 1e6;
+	};
+	try
+	{
+		for(uint32_t frame = 0; frame < job.frames; frame++)
+		{
+			uint32_t slot = frame % JOB_FRAMES_IN_FLIGHT;
+			worker.WaitFor(vkDevice, worker.slotValues[slot]);
+			collectTimestamps(slot);
+			uint64_t completed = worker.timeline.getCounterValue();
+			worker.deletionQueue.Collect(completed);
+			capture.Collect(completed);
+			worker.uploadRing.BeginFrame(slot);
+
+			float seconds = static_cast<float>(frame) * JOB_FRAME_SECONDS;
+			glm::mat4 camera = JobCamera(seconds);
+			scene.Cull(camera, visible);
+			const vk::raii::CommandBuffer& commandBuffer = commandBuffers[slot];
+			commandBuffer.reset();
+			commandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+			if(*worker.timestamps)
+			{
+				commandBuffer.resetQueryPool(*worker.timestamps, TIMESTAMPS_PER_FRAME * slot, TIMESTAMPS_PER_FRAME);
+				commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *worker.timestamps, TIMESTAMPS_PER_FRAME * slot);
+			}
+			RenderGraph& renderGraph = worker.renderGraph;
+			renderGraph.Reset();
+			ImportedImage target;
+			target.image	= *colors[slot];
+			target.view		= *views[slot];
+			RenderGraph::Resource color = renderGraph.ImportImage("job color", target);
+			RenderGraph::Resource depth = renderGraph.CreateImage("depth", {device.depthFormat, extent, vk::ImageAspectFlagBits::eDepth});
+			renderGraph.AddPass("scene", [&](const vk::raii::CommandBuffer& commandBuffer){
+				vk::RenderingAttachmentInfo attachmentInfo;
+				attachmentInfo.imageView	= renderGraph.View(color);
+				attachmentInfo.imageLayout	= vk::ImageLayout::eColorAttachmentOptimal;
+				attachmentInfo.loadOp		= vk::AttachmentLoadOp::eClear;
+				attachmentInfo.storeOp		= vk::AttachmentStoreOp::eStore;
+				attachmentInfo.clearValue	= vk::ClearColorValue(1.0f, 1.0f, 1.0f, 1.0f);
+				vk::RenderingAttachmentInfo depthInfo;
+				depthInfo.imageView			= renderGraph.View(depth);
+				depthInfo.imageLayout		= vk::ImageLayout::eDepthAttachmentOptimal;
+				depthInfo.loadOp			= vk::AttachmentLoadOp::eClear;
+				depthInfo.storeOp			= vk::AttachmentStoreOp::eDontCare;
+				depthInfo.clearValue		= vk::ClearDepthStencilValue(1.0f, 0);
+				vk::RenderingInfo renderingInfo;
+				renderingInfo.renderArea			= vk::Rect2D(vk::Offset2D{0, 0}, extent);
+				renderingInfo.layerCount			= 1;
+				renderingInfo.colorAttachmentCount	= 1;
+				renderingInfo.pColorAttachments		= &attachmentInfo;
+				renderingInfo.pDepthAttachment		= &depthInfo;
+				commandBuffer.beginRendering(renderingInfo);
+				commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, device.pipeline);
+				commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f));
+				commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
+				device.bindless->Bind(commandBuffer, vk::PipelineBindPoint::eGraphics, device.layout);
+				for(Scene::Node node : visible)
+				{
+					FrameData frameData;
+					frameData.transform	= camera * scene.World(node);
+					frameData.tint		= scene.Tint(node);
+					frameData.time		= seconds;
+					DrawConstants constants;
+					constants.frameData	= worker.uploadRing.DeviceAddress() + worker.uploadRing.Push(frameData).offset;
+					commandBuffer.pushConstants<DrawConstants>(device.layout, DRAW_CONSTANT_STAGES, 0, constants);
+					commandBuffer.draw(3, 1, 0, 0);
+				}
+				commandBuffer.endRendering();
+			}).Use(color, ResourceUsage::ColorAttachment).Use(depth, ResourceUsage::DepthAttachment);
+			//every frame is kept, the job waits for the encoders rather than dropping one
+			uint32_t captureSlot = capture.Acquire(extent, frame);
+			RenderGraph::Resource readback = renderGraph.ImportBuffer("readback", capture.Target(captureSlot), ResourceUsage::HostRead);
+			renderGraph.AddPass("readback", [&](const vk::raii::CommandBuffer& commandBuffer){
+				capture.RecordCopy(commandBuffer, captureSlot, renderGraph.Image(color));
+			}).Use(color, ResourceUsage::TransferSrc).Use(readback, ResourceUsage::TransferDst);
+			renderGraph.Execute(commandBuffer, worker.submitted);
+			if(*worker.timestamps)
+				commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *worker.timestamps, TIMESTAMPS_PER_FRAME * slot + 1);
+			commandBuffer.end();
+			worker.uploadRing.Flush();
+
+			uint64_t frameValue = worker.submitted + 1;
+			vk::CommandBufferSubmitInfo commandBufferInfo(*commandBuffer);
+			vk::SemaphoreSubmitInfo signalInfo(*worker.timeline, frameValue, vk::PipelineStageFlagBits2::eAllCommands);
+			vk::SubmitInfo2 submitInfo;
+			submitInfo.commandBufferInfoCount	= 1;
+			submitInfo.pCommandBufferInfos		= &commandBufferInfo;
+			submitInfo.signalSemaphoreInfoCount	= 1;
+			submitInfo.pSignalSemaphoreInfos	= &signalInfo;
+			{
+				TRACE_ZONE("queue.submit");
+				std::lock_guard lock(*worker.queueMutex);
+				worker.queue->submit2(submitInfo);
+			}
+			worker.submitted			= frameValue;
+			worker.slotValues[slot]		= frameValue;
+			timed[slot]					= static_cast<bool>(*worker.timestamps);
+			capture.Submitted(captureSlot, frameValue);
+		}
+	}
+	catch(...)
+	{
+		//the targets and the command pool go away with the job
+		worker.WaitFor(vkDevice, worker.submitted);
+		throw;
+	}
+	worker.WaitFor(vkDevice, worker.submitted);
+	for(uint32_t slot = 0; slot < JOB_FRAMES_IN_FLIGHT; slot++)
+		collectTimestamps(slot);
+	worker.deletionQueue.Collect(worker.submitted);
+	capture.Finish(worker.submitted);
+	FrameCaptureStats captureStats = capture.Stats();
+	if(captureStats.failed != 0)
+		throw std::runtime_error("failed to write " + std::to_string(captureStats.failed) + " frames to " + job.output);
+}
+
+RenderServerStats RenderServer::Stats() const
+{
+	std::lock_guard lock(mutex);
+	RenderServerStats result = stats;
+	result.activeMs = started ? std::max(Milliseconds(lastDone - firstJob), 0.0) : 0.0;
+	return result;
+}
+
+std::string RenderServer::StatsLine() const
+{
+	RenderServerStats s = Stats();
+	double gpuMs = 0.0;
+	for(double ms : s.queueGpuMs)
+		gpuMs += ms;
+	double seconds = s.activeMs / 1000.0;
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(3);
+	line << "stats jobs=" << s.jobs << " failed=" << s.failed << " frames=" << s.frames
+		 << " jobs_per_s=" << (seconds > 0.0 ? s.jobs / seconds : 0.0)
+		 << " gpu_utilization=" << (s.activeMs > 0.0 && !s.queueGpuMs.empty() ? gpuMs / (s.activeMs * s.queueGpuMs.size()) : 0.0);
+	return line.str();
+}
+
+void RenderServer::PrintStats(std::ostream& out) const
+{
+	RenderServerStats s = Stats();
+	double seconds = s.activeMs / 1000.0;
+	out << "render server: " << s.jobs << " jobs (" << s.failed << " failed), " << s.frames << " frames in " << seconds << " s, "
+		<< (seconds > 0.0 ? s.jobs / seconds : 0.0) << " jobs/s, " << (seconds > 0.0 ? s.frames / seconds : 0.0) << " frames/s" << std::endl;
+	if(device.timestampValidBits == 0)
+	{
+		out << "render server GPU utilization: no timestamps on this queue family" << std::endl;
+		return;
+	}
+	//GPU time of the frames over the time jobs were running, per queue
+	out << "render server GPU utilization:";
+	for(size_t i = 0; i < s.queueGpuMs.size(); i++)
+		out << (i == 0 ? " " : ", ") << "queue " << i << " " << (s.activeMs > 0.0 ? 100.0 * s.queueGpuMs[i] / s.activeMs : 0.0) << "%";
+	out << std::endl;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "bindless.h"
+#include "frame_capture.h"
+#include "gpu_allocator.h"
+
+//one render request: the draw grid at a resolution for a number of frames, every frame
+//written to <output>_<frame>.png, or back to back into output with format=raw. Jobs cannot
+//name a mesh, scene or texture, every job draws the built-in grid with the server's pipeline.
+struct RenderJob
+{
+	uint64_t		id		= 0;
+	uint32_t		draws	= 1;
+	uint32_t		width	= 800;
+	uint32_t		height	= 600;
+	uint32_t		frames	= 1;
+	std::string		output;
+	CaptureFormat	format	= CaptureFormat::Png;
+};
+//what a job may ask for on the device it is rendered with
+struct RenderJobLimits
+{
+	//per draw data of a frame has to fit into one upload ring region
+	uint32_t	maxDraws	= UINT32_MAX;
+	uint32_t	maxExtent	= UINT32_MAX;
+};
+//key=value pairs separated by spaces, e.g. "draws=100 width=640 height=480 frames=10 output=out/job";
+//throws std::runtime_error on unknown keys, malformed values and values beyond limits
+RenderJob ParseRenderJob(std::string_view line, const RenderJobLimits& limits);
+
+struct RenderServerConfig
+{
+	//"-" reads jobs from stdin and answers on stdout, anything else is a unix socket path
+	std::string	source		= "-";
+	//jobs rendering at the same time, spread over the queues; 0 = two per queue
+	uint32_t	concurrentJobs	= 0;
+};
+
+//what the server renders with, created once by the renderer
+struct RenderServerDevice
+{
+	const vk::raii::PhysicalDevice*		physicalDevice	= nullptr;
+	const vk::raii::Device*				device			= nullptr;
+	GpuAllocator*						allocator		= nullptr;
+	const BindlessDescriptors*			bindless		= nullptr;
+	//queues of one graphics family, jobs submit to queues[job slot % size]
+	uint32_t							queueFamily		= 0;
+	std::vector<const vk::raii::Queue*>	queues;
+	vk::Pipeline						pipeline;
+	vk::PipelineLayout					layout;
+	vk::Format							colorFormat		= vk::Format::eUndefined;
+	vk::Format							depthFormat		= vk::Format::eUndefined;
+	//0 valid bits = no GPU timings
+	uint32_t							timestampValidBits	= 0;
+	float								timestampPeriod		= 1.0f;
+};
+
+struct RenderServerStats
+{
+	uint64_t			jobs	= 0;
+	uint64_t			failed	= 0;
+	uint64_t			frames	= 0;
+	//from the first job accepted until the last one finished
+	double				activeMs	= 0.0;
+	//summed GPU time of the frames submitted to each queue
+	std::vector<double>	queueGpuMs;
+};
+
+//Long-lived batch renderer. The device, pipelines and bindless set are created once; jobs arrive
+//as lines on stdin or a unix socket and are rendered by a fixed set of workers, each job with its
+//own color targets and command pool, the depth target and upload ring kept per worker. Workers
+//share the queues round robin, submits to one queue are serialized. Every job is answered with a
+//"done" or "failed" line; "stats" answers with the running totals and "quit" stops accepting jobs,
+//as does the end of stdin. Run returns once every accepted job has finished.
+class RenderServer
+{
+	public:
+		RenderServer();
+		~RenderServer();
+		void Run(const RenderServerDevice& device, const RenderServerConfig& config);
+		RenderServerStats Stats() const;
+		void PrintStats(std::ostream& out) const;
+	private:
+		using Reply = std::function<void(const std::string&)>;
+		struct QueuedJob
+		{
+			RenderJob	job;
+			Reply		reply;
+		};
+		struct Worker;
+
+		//parses one line of a client, false once it asked the server to stop
+		bool HandleLine(std::string_view line, const Reply& reply);
+		void ReadStdin();
+		void ServeSocket(const std::string& path);
+		void WorkerLoop(Worker& worker);
+		//renders every frame of the job, throws on failure after the GPU is done with it
+		void RenderJobFrames(Worker& worker, const RenderJob& job, double& gpuMs);
+		std::string StatsLine() const;
+
+		RenderServerDevice						device;
+		RenderJobLimits							jobLimits;
+		std::vector<std::unique_ptr<std::mutex>>	queueMutexes;
+		std::vector<std::unique_ptr<Worker>>	workers;
+		std::atomic<uint64_t>					nextJobId = 1;
+		//pending jobs, closed once no more can arrive
+		mutable std::mutex						mutex;
+		std::condition_variable					jobAdded;
+		std::deque<QueuedJob>					jobs;
+		bool									closed = false;
+		RenderServerStats						stats;
+		std::chrono::steady_clock::time_point	firstJob;
+		std::chrono::steady_clock::time_point	lastDone;
+		bool									started = false;
+};
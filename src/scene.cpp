@@ -0,0 +1,431 @@
+#include "scene.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <future>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCENE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+//MSVC compiles AVX intrinsics without a target switch
+#define SCENE_TARGET_AVX2
+#else
+#define SCENE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define SCENE_X86 0
+#endif
+
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace
+{
+	//widest SIMD batch, the bounds arrays are padded to it
+	constexpr uint32_t BATCH = 8;
+	//nodes per task of the transform update and the cull, a multiple of BATCH
+	constexpr uint32_t TRANSFORM_CHUNK = 4096;
+	constexpr uint32_t CULL_CHUNK = 16384;
+	//fails every plane test: padding and nodes without a render handle
+	constexpr float NO_BOUNDS = -std::numeric_limits<float>::infinity();
+
+	//plane i is (x, y, z, w) = planes[i], inside where dot(xyz, p) + w >= -radius
+	using Planes = std::array<glm::vec4, 6>;
+
+	Planes FrustumPlanes(const glm::mat4& m)
+	{
+		//rows of the column major matrix, clip space is -w <= x, y <= w and 0 <= z <= w
+		auto row = [&m](int i){ return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+		Planes planes{row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2)};
+		//unit normals, the radius is compared in world units
+		for(glm::vec4& plane : planes)
+		{
+			float length = glm::length(glm::vec3(plane));
+			if(length > 0.0f)
+				plane /= length;
+		}
+		return planes;
+	}
+
+	//every kernel writes the visible indices of [begin, end) to out and returns their count;
+	//begin and end are multiples of BATCH within the padded bounds
+	uint32_t CullScalar(const float* x, const float* y, const float* z, const float* r, uint32_t begin, uint32_t end, const Planes& planes, Scene::Node* out)
+	{
+		uint32_t count = 0;
+		for(uint32_t i = begin; i < end; i++)
+		{
+			bool inside = true;
+			//summed in the order of the SIMD kernels, every kernel agrees on spheres touching a plane
+			for(const glm::vec4& plane : planes)
+				inside &= (plane.x * x[i] + plane.y * y[i]) + (plane.z * z[i] + (plane.w + r[i])) >= 0.0f;
+			//written either way, only counted when inside
+			out[count] = i;
+			count += inside;
+		}
+		return count;
+	}
+
+#if SCENE_X86
+	//for every 8 bit lane mask, the set lanes in order
+	struct alignas(32) LaneList : std::array<uint32_t, 8>{};
+	constexpr std::array<LaneList, 256> COMPACT_LANES = [](){
+		std::array<LaneList, 256> table{};
+		for(uint32_t mask = 0; mask < 256; mask++)
+		{
+			uint32_t count = 0;
+			for(uint32_t lane = 0; lane < 8; lane++)
+				if(mask & (1u << lane))
+					table[mask][count++] = lane;
+		}
+		return table;
+	}();
+
+	uint32_t CullSse(const float* x, const float* y, const float* z, const float* r, uint32_t begin, uint32_t end, const Planes& planes, Scene::Node* out)
+	{
+		__m128 px[6], py[6], pz[6], pw[6];
+		for(int p = 0; p < 6; p++)
+		{
+			px[p] = _mm_set1_ps(planes[p].x);
+			py[p] = _mm_set1_ps(planes[p].y);
+			pz[p] = _mm_set1_ps(planes[p].z);
+			pw[p] = _mm_set1_ps(planes[p].w);
+		}
+		const __m128 zero = _mm_setzero_ps();
+		uint32_t count = 0;
+		for(uint32_t i = begin; i < end; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(x + i);
+			__m128 cy = _mm_loadu_ps(y + i);
+			__m128 cz = _mm_loadu_ps(z + i);
+			__m128 cr = _mm_loadu_ps(r + i);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for(int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)), _mm_add_ps(_mm_mul_ps(pz[p], cz), _mm_add_ps(pw[p], cr)));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+			}
+			//branchless like the scalar kernel, every lane is written and only the visible ones counted
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+			for(uint32_t lane = 0; lane < 4; lane++)
+			{
+				out[count] = i + lane;
+				count += (mask >> lane) & 1;
+			}
+		}
+		return count;
+	}
+
+	SCENE_TARGET_AVX2 uint32_t CullAvx2(const float* x, const float* y, const float* z, const float* r, uint32_t begin, uint32_t end, const Planes& planes, Scene::Node* out)
+	{
+		__m256 px[6], py[6], pz[6], pw[6];
+		for(int p = 0; p < 6; p++)
+		{
+			px[p] = _mm256_set1_ps(planes[p].x);
+			py[p] = _mm256_set1_ps(planes[p].y);
+			pz[p] = _mm256_set1_ps(planes[p].z);
+			pw[p] = _mm256_set1_ps(planes[p].w);
+		}
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		uint32_t count = 0;
+		for(uint32_t i = begin; i < end; i += 8)
+		{
+			__m256 cx = _mm256_loadu_ps(x + i);
+			__m256 cy = _mm256_loadu_ps(y + i);
+			__m256 cz = _mm256_loadu_ps(z + i);
+			__m256 cr = _mm256_loadu_ps(r + i);
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for(int p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], cx), _mm256_mul_ps(py[p], cy)), _mm256_add_ps(_mm256_mul_ps(pz[p], cz), _mm256_add_ps(pw[p], cr)));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+			}
+			//the visible lanes' indices packed to the front and stored whole, the tail is overwritten by
+			//the next batch; out has room since count never exceeds i - begin
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+			__m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), lanes);
+			__m256i packed = _mm256_permutevar8x32_epi32(indices, _mm256_load_si256(reinterpret_cast<const __m256i*>(COMPACT_LANES[mask].data())));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + count), packed);
+			count += static_cast<uint32_t>(std::popcount(mask));
+		}
+		return count;
+	}
+
+	bool CpuHasAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuidex(info, 0, 0);
+		if(info[0] < 7)
+			return false;
+		__cpuidex(info, 1, 0);
+		//OSXSAVE and AVX, then the OS has to save the YMM registers
+		if((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	//out = a * b, out must not alias the inputs
+	void Multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+	{
+#if SCENE_X86
+		//every column of out is the columns of a weighted by one column of b
+		__m128 a0 = _mm_loadu_ps(&a[0][0]);
+		__m128 a1 = _mm_loadu_ps(&a[1][0]);
+		__m128 a2 = _mm_loadu_ps(&a[2][0]);
+		__m128 a3 = _mm_loadu_ps(&a[3][0]);
+		for(int c = 0; c < 4; c++)
+		{
+			const float* column = &b[c][0];
+			__m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(column[0])), _mm_mul_ps(a1, _mm_set1_ps(column[1]))),
+									   _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(column[2])), _mm_mul_ps(a3, _mm_set1_ps(column[3]))));
+			_mm_storeu_ps(&out[c][0], result);
+		}
+#else
+		out = a * b;
+#endif
+	}
+
+	//runs body(i) for i in [0, count) on the calling thread and the pool's workers
+	template<typename F>
+	void ParallelFor(ThreadPool* pool, uint32_t count, const F& body)
+	{
+		if(pool == nullptr || count <= 1)
+		{
+			for(uint32_t i = 0; i < count; i++)
+				body(i);
+			return;
+		}
+		std::atomic<uint32_t> next = 0;
+		auto work = [&](){
+			for(uint32_t i = next.fetch_add(1, std::memory_order_relaxed); i < count; i = next.fetch_add(1, std::memory_order_relaxed))
+				body(i);
+		};
+		std::vector<std::future<void>> helpers;
+		size_t helperCount = std::min<size_t>(pool->Size(), count - 1);
+		helpers.reserve(helperCount);
+		for(size_t i = 0; i < helperCount; i++)
+			helpers.push_back(pool->Submit(work));
+		work();
+		for(auto& helper : helpers)
+			helper.get();
+	}
+
+	uint32_t ChunkCount(uint32_t count, uint32_t chunk)
+	{
+		return (count + chunk - 1) / chunk;
+	}
+}
+
+const char* ToString(CullKernel kernel)
+{
+	switch(kernel)
+	{
+		case CullKernel::Auto:		return "auto";
+		case CullKernel::Scalar:	return "scalar";
+		case CullKernel::Sse:		return "sse";
+		case CullKernel::Avx2:		return "avx2";
+		default:					return "unknown";
+	}
+}
+
+void Scene::Reserve(size_t count)
+{
+	parents.reserve(count);
+	locals.reserve(count);
+	worlds.reserve(count);
+	radii.reserve(count);
+	renderHandles.reserve(count);
+	tints.reserve(count);
+	depths.reserve(count);
+	dirty.reserve(count);
+}
+
+void Scene::Clear()
+{
+	*this = Scene();
+}
+
+Scene::Node Scene::Add(const glm::mat4& local, float radius, uint32_t renderHandle, const glm::vec4& tint, Node parent)
+{
+	Node node = static_cast<Node>(parents.size());
+	assert(parent == NO_PARENT || parent < node);
+	parents.push_back(parent);
+	locals.push_back(local);
+	worlds.push_back(local);
+	radii.push_back(radius);
+	renderHandles.push_back(renderHandle);
+	tints.push_back(tint);
+	depths.push_back(parent == NO_PARENT ? 0 : depths[parent] + 1);
+	dirty.push_back(1);
+	levelsDirty		= true;
+	transformsDirty	= true;
+	return node;
+}
+
+void Scene::SetLocal(Node node, const glm::mat4& local)
+{
+	locals[node]	= local;
+	dirty[node]		= 1;
+	transformsDirty	= true;
+}
+
+uint32_t Scene::LevelCount() const
+{
+	return levelStarts.empty() ? 0 : static_cast<uint32_t>(levelStarts.size() - 1);
+}
+
+void Scene::RebuildLevels()
+{
+	//counting sort by depth, stable so every level streams through the pools in order
+	uint32_t levels = depths.empty() ? 0 : *std::ranges::max_element(depths) + 1;
+	levelStarts.assign(levels + 1, 0);
+	for(uint32_t depth : depths)
+		levelStarts[depth + 1]++;
+	for(uint32_t i = 0; i < levels; i++)
+		levelStarts[i + 1] += levelStarts[i];
+	std::vector<uint32_t> cursor(levelStarts.begin(), levelStarts.end() - 1);
+	levelOrder.resize(depths.size());
+	for(Node node = 0; node < depths.size(); node++)
+		levelOrder[cursor[depths[node]]++] = node;
+	//spheres past the end fail every test, the kernels never need a tail loop
+	size_t padded = (depths.size() + BATCH - 1) / BATCH * BATCH;
+	boundsX.assign(padded, 0.0f);
+	boundsY.assign(padded, 0.0f);
+	boundsZ.assign(padded, 0.0f);
+	boundsR.assign(padded, NO_BOUNDS);
+	//the bounds start over, so every node is derived again
+	std::ranges::fill(dirty, 1);
+	levelsDirty = false;
+}
+
+void Scene::UpdateNodes(uint32_t begin, uint32_t end)
+{
+	for(uint32_t i = begin; i < end; i++)
+	{
+		Node node = levelOrder[i];
+		Node parent = parents[node];
+		//a moved parent moves the whole subtree, the flag is passed down one level at a time
+		if(parent != NO_PARENT && dirty[parent])
+			dirty[node] = 1;
+		else if(!dirty[node])
+			continue;
+		glm::mat4& world = worlds[node];
+		if(parent == NO_PARENT)
+			world = locals[node];
+		else
+			Multiply(worlds[parent], locals[node], world);
+		boundsX[node] = world[3].x;
+		boundsY[node] = world[3].y;
+		boundsZ[node] = world[3].z;
+		if(renderHandles[node] == NO_RENDER)
+			continue;
+		//the sphere grows by the largest singular value of the linear part. Its square is bounded by
+		//the largest Gershgorin row sum of the columns' Gram matrix, which is the largest axis scale
+		//when the columns are orthogonal (rotation and axis scale) and only grows under shear, and
+		//by the summed squared axis scales, whichever is smaller
+		glm::vec3 axisX(world[0]), axisY(world[1]), axisZ(world[2]);
+		float xx = glm::dot(axisX, axisX), yy = glm::dot(axisY, axisY), zz = glm::dot(axisZ, axisZ);
+		float xy = std::abs(glm::dot(axisX, axisY)), xz = std::abs(glm::dot(axisX, axisZ)), yz = std::abs(glm::dot(axisY, axisZ));
+		float gershgorin = std::max({xx + xy + xz, yy + xy + yz, zz + xz + yz});
+		boundsR[node] = radii[node] * std::sqrt(std::min(gershgorin, xx + yy + zz));
+	}
+}
+
+void Scene::UpdateTransforms(ThreadPool* pool)
+{
+	if(!transformsDirty)
+		return;
+	TRACE_ZONE("Scene::UpdateTransforms");
+	if(levelsDirty)
+		RebuildLevels();
+	//a level only reads the one above it, which is complete by then
+	for(uint32_t level = 0; level < LevelCount(); level++)
+	{
+		uint32_t begin	= levelStarts[level];
+		uint32_t end	= levelStarts[level + 1];
+		ParallelFor(pool, ChunkCount(end - begin, TRANSFORM_CHUNK), [&](uint32_t chunk){
+			uint32_t chunkBegin = begin + chunk * TRANSFORM_CHUNK;
+			UpdateNodes(chunkBegin, std::min(chunkBegin + TRANSFORM_CHUNK, end));
+		});
+	}
+	std::ranges::fill(dirty, 0);
+	transformsDirty = false;
+}
+
+void AddDrawGrid(Scene& scene, uint32_t count, float radius, uint32_t renderHandle)
+{
+	uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	float cell = 2.0f / static_cast<float>(columns);
+	float scale = count == 1 ? 1.0f : cell;
+	scene.Reserve(scene.Size() + count);
+	for(uint32_t i = 0; i < count; i++)
+	{
+		float x = -1.0f + cell * (static_cast<float>(i % columns) + 0.5f);
+		float y = -1.0f + cell * (static_cast<float>(i / columns) + 0.5f);
+		glm::mat4 local(1.0f);
+		local[0][0]	= scale;
+		local[1][1]	= scale;
+		local[3]	= glm::vec4(x, y, 0.0f, 1.0f);
+		scene.Add(local, radius, renderHandle);
+	}
+}
+
+CullKernel Scene::BestKernel()
+{
+#if SCENE_X86
+	static const CullKernel best = CpuHasAvx2() ? CullKernel::Avx2 : CullKernel::Sse;
+	return best;
+#else
+	return CullKernel::Scalar;
+#endif
+}
+
+void Scene::Cull(const glm::mat4& viewProjection, std::vector<Node>& visible, ThreadPool* pool, CullKernel kernel) const
+{
+	TRACE_ZONE("Scene::Cull");
+	assert(!transformsDirty);
+	if(kernel == CullKernel::Auto || (kernel == CullKernel::Avx2 && BestKernel() != CullKernel::Avx2))
+		kernel = BestKernel();
+#if !SCENE_X86
+	kernel = CullKernel::Scalar;
+#endif
+	auto cull = CullScalar;
+#if SCENE_X86
+	if(kernel == CullKernel::Sse)
+		cull = CullSse;
+	else if(kernel == CullKernel::Avx2)
+		cull = CullAvx2;
+#endif
+	Planes planes = FrustumPlanes(viewProjection);
+	uint32_t padded = static_cast<uint32_t>(boundsR.size());
+	//every chunk writes into its own stretch of the output, the stretches are closed up after
+	visible.resize(padded);
+	uint32_t chunks = ChunkCount(padded, CULL_CHUNK);
+	std::vector<uint32_t> counts(chunks);
+	ParallelFor(pool, chunks, [&](uint32_t chunk){
+		uint32_t begin = chunk * CULL_CHUNK;
+		counts[chunk] = cull(boundsX.data(), boundsY.data(), boundsZ.data(), boundsR.data(), begin, std::min(begin + CULL_CHUNK, padded), planes, visible.data() + begin);
+	});
+	uint32_t count = 0;
+	for(uint32_t chunk = 0; chunk < chunks; chunk++)
+	{
+		uint32_t begin = chunk * CULL_CHUNK;
+		if(count != begin)
+			std::copy_n(visible.begin() + begin, counts[chunk], visible.begin() + count);
+		count += counts[chunk];
+	}
+	visible.resize(count);
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+//frustum culling kernels, Auto picks the widest one the CPU supports
+enum class CullKernel : uint8_t
+{
+	Auto,
+	Scalar,
+	//4 spheres per instruction
+	Sse,
+	//8 spheres per instruction
+	Avx2
+};
+const char* ToString(CullKernel kernel);
+
+//Scene objects as structure of arrays: one contiguous pool per attribute, indexed by Node.
+//World transforms are derived level by level, every level split across the pool's workers, and
+//the world bounding spheres are kept one array per component so the culling kernels test several
+//spheres per instruction. Cull produces the compact list of visible nodes the renderer draws.
+class Scene
+{
+	public:
+		using Node = uint32_t;
+		static constexpr Node NO_PARENT = ~0u;
+		//nodes without a render handle only carry a transform for their children
+		static constexpr uint32_t NO_RENDER = ~0u;
+
+		void Reserve(size_t count);
+		void Clear();
+		//parent has to be added before; radius bounds the object around its local origin
+		Node Add(const glm::mat4& local, float radius, uint32_t renderHandle, const glm::vec4& tint = glm::vec4(1.0f), Node parent = NO_PARENT);
+		void SetLocal(Node node, const glm::mat4& local);
+		size_t Size() const { return parents.size(); }
+		uint32_t LevelCount() const;
+		//valid after UpdateTransforms
+		const glm::mat4& World(Node node) const { return worlds[node]; }
+		//world space bounding sphere, xyz center and w radius
+		glm::vec4 Bounds(Node node) const { return {boundsX[node], boundsY[node], boundsZ[node], boundsR[node]}; }
+		uint32_t RenderHandle(Node node) const { return renderHandles[node]; }
+		const glm::vec4& Tint(Node node) const { return tints[node]; }
+		//derives world transforms and bounds of the nodes added or moved since the last call and
+		//of everything below them, a no-op when nothing changed
+		void UpdateTransforms(ThreadPool* pool = nullptr);
+		//renderable nodes whose bounding sphere touches the view volume of viewProjection
+		//(Vulkan clip space, 0 <= z <= w), in node order; needs UpdateTransforms first
+		void Cull(const glm::mat4& viewProjection, std::vector<Node>& visible, ThreadPool* pool = nullptr, CullKernel kernel = CullKernel::Auto) const;
+		static CullKernel BestKernel();
+	private:
+		void RebuildLevels();
+		void UpdateNodes(uint32_t begin, uint32_t end);
+
+		std::vector<Node>		parents;
+		std::vector<glm::mat4>	locals;
+		std::vector<glm::mat4>	worlds;
+		std::vector<float>		radii;
+		std::vector<uint32_t>	renderHandles;
+		std::vector<glm::vec4>	tints;
+		std::vector<uint32_t>	depths;
+		//local transform changed since the last update, uint8_t so levels can set it in parallel
+		std::vector<uint8_t>	dirty;
+		//world bounding spheres, padded to whole SIMD batches with spheres nothing sees
+		std::vector<float>		boundsX;
+		std::vector<float>		boundsY;
+		std::vector<float>		boundsZ;
+		std::vector<float>		boundsR;
+		//nodes grouped by depth in node order, depth d is levelOrder[levelStarts[d], levelStarts[d + 1])
+		std::vector<Node>		levelOrder;
+		std::vector<uint32_t>	levelStarts;
+		bool					levelsDirty = false;
+		bool					transformsDirty = false;
+};
+
+//count renderable roots on a square grid over [-1, 1] in x and y, each scaled to its cell
+void AddDrawGrid(Scene& scene, uint32_t count, float radius, uint32_t renderHandle = 0);
@@ -0,0 +1,87 @@
+#include "shader_watcher.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <utility>
+
+namespace
+{
+	//stat is cheap, a quarter second is below what an editor save to reload feels like
+	constexpr auto POLL_INTERVAL = std::chrono::milliseconds(250);
+
+	std::filesystem::file_time_type LastWrite(const std::filesystem::path& path)
+	{
+		std::error_code error;
+		auto time = std::filesystem::last_write_time(path, error);
+		return error ? std::filesystem::file_time_type::min() : time;
+	}
+}
+
+ShaderWatcher::ShaderWatcher(std::filesystem::path sourcePath, std::string compileCommand)
+	: sourcePath(std::move(sourcePath)), compileCommand(std::move(compileCommand))
+{
+	outputPath	= std::filesystem::temp_directory_path() / "shader_hot_reload.spv";
+	lastWrite	= LastWrite(this->sourcePath);
+	thread		= std::thread([this](){ Run(); });
+	std::cout << "shader hot reload: watching " << this->sourcePath.string() << std::endl;
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	thread.join();
+}
+
+std::optional<std::vector<uint32_t>> ShaderWatcher::TakeUpdate()
+{
+	std::lock_guard lock(mutex);
+	return std::exchange(update, std::nullopt);
+}
+
+void ShaderWatcher::Run()
+{
+	std::unique_lock lock(mutex);
+	while(!condition.wait_for(lock, POLL_INTERVAL, [this](){ return stopping; }))
+	{
+		auto time = LastWrite(sourcePath);
+		if(time == lastWrite)
+			continue;
+		lastWrite = time;
+		//the compiler runs for a while, TakeUpdate must not wait on it
+		lock.unlock();
+		Compile();
+		lock.lock();
+	}
+}
+
+void ShaderWatcher::Compile()
+{
+	auto start = std::chrono::steady_clock::now();
+	std::string command = compileCommand + " -o \"" + outputPath.string() + "\"";
+	if(std::system(command.c_str()) != 0)
+	{
+		std::cerr << "shader hot reload: compile failed, keeping the current shaders" << std::endl;
+		return;
+	}
+	std::ifstream file(outputPath, std::ios::ate | std::ios::binary);
+	size_t bytes = file.is_open() ? static_cast<size_t>(file.tellg()) : 0;
+	if(bytes == 0 || bytes % sizeof(uint32_t) != 0)
+	{
+		std::cerr << "shader hot reload: " << outputPath.string() << " is not SPIR-V" << std::endl;
+		return;
+	}
+	std::vector<uint32_t> code(bytes / sizeof(uint32_t));
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(bytes));
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "shader hot reload: recompiled in " << ms << " ms" << std::endl;
+	std::lock_guard lock(mutex);
+	update = std::move(code);
+}
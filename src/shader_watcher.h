@@ -0,0 +1,38 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Development helper: polls a shader source on its own thread, recompiles it with the given
+//command when it changes and keeps the newest SPIR-V for the render thread to pick up.
+//Compile errors are printed and leave the last good module in place.
+class ShaderWatcher
+{
+	public:
+		//compileCommand gets "-o <output>" appended
+		ShaderWatcher(std::filesystem::path sourcePath, std::string compileCommand);
+		~ShaderWatcher();
+		ShaderWatcher(const ShaderWatcher&) = delete;
+		ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+		//SPIR-V compiled since the last call, if any
+		std::optional<std::vector<uint32_t>> TakeUpdate();
+	private:
+		void Run();
+		void Compile();
+
+		std::filesystem::path					sourcePath;
+		std::filesystem::path					outputPath;
+		std::string								compileCommand;
+		std::filesystem::file_time_type			lastWrite;
+		std::mutex								mutex;
+		std::condition_variable					condition;
+		bool									stopping = false;
+		std::optional<std::vector<uint32_t>>	update;
+		//declared last, started once everything above is initialized
+		std::thread								thread;
+};
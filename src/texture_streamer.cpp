@@ -0,0 +1,549 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "trace.h"
+
+namespace
+{
+	constexpr uint64_t MIP_ALIGNMENT = 16;
+
+	struct Image
+	{
+		uint32_t				width = 0;
+		uint32_t				height = 0;
+		std::vector<uint8_t>	rgba;
+	};
+
+	float SrgbToLinear(uint8_t value)
+	{
+		static const auto table = [](){
+			std::array<float, 256> result;
+			for(int i = 0; i < 256; i++)
+			{
+				float c = static_cast<float>(i) / 255.0f;
+				result[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return result;
+		}();
+		return table[value];
+	}
+
+	uint8_t LinearToSrgb(float value)
+	{
+		float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+		return static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+	}
+
+	//2x2 box filter in linear space, odd edges clamp
+	Image Downsample(const Image& source)
+	{
+		Image result;
+		result.width	= std::max(source.width / 2, 1u);
+		result.height	= std::max(source.height / 2, 1u);
+		result.rgba.resize(size_t(result.width) * result.height * 4);
+		for(uint32_t y = 0; y < result.height; y++)
+		{
+			uint32_t y0 = std::min(y * 2, source.height - 1);
+			uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+			for(uint32_t x = 0; x < result.width; x++)
+			{
+				uint32_t x0 = std::min(x * 2, source.width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+				const uint8_t* texels[4] = {
+					&source.rgba[(size_t(y0) * source.width + x0) * 4], &source.rgba[(size_t(y0) * source.width + x1) * 4],
+					&source.rgba[(size_t(y1) * source.width + x0) * 4], &source.rgba[(size_t(y1) * source.width + x1) * 4]};
+				uint8_t* out = &result.rgba[(size_t(y) * result.width + x) * 4];
+				for(int c = 0; c < 3; c++)
+					out[c] = LinearToSrgb((SrgbToLinear(texels[0][c]) + SrgbToLinear(texels[1][c]) + SrgbToLinear(texels[2][c]) + SrgbToLinear(texels[3][c])) * 0.25f);
+				out[3] = static_cast<uint8_t>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+			}
+		}
+		return result;
+	}
+
+	uint16_t To565(const int color[3])
+	{
+		return static_cast<uint16_t>(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+	}
+
+	void From565(uint16_t value, int color[3])
+	{
+		int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	//bounding box endpoints inset by 1/16, good enough for streaming, not for hero assets
+	void EncodeBc1Block(const uint8_t texels[16][4], uint8_t out[8])
+	{
+		int minimum[3] = {255, 255, 255}, maximum[3] = {0, 0, 0};
+		for(int i = 0; i < 16; i++)
+		{
+			for(int c = 0; c < 3; c++)
+			{
+				minimum[c] = std::min<int>(minimum[c], texels[i][c]);
+				maximum[c] = std::max<int>(maximum[c], texels[i][c]);
+			}
+		}
+		for(int c = 0; c < 3; c++)
+		{
+			int inset = (maximum[c] - minimum[c]) / 16;
+			minimum[c] += inset;
+			maximum[c] -= inset;
+		}
+		uint16_t color0 = To565(maximum), color1 = To565(minimum);
+		uint32_t indices = 0;
+		//equal endpoints would select the 3 color mode, index 0 is right there as well
+		if(color0 != color1)
+		{
+			if(color0 < color1)
+				std::swap(color0, color1);
+			int palette[4][3];
+			From565(color0, palette[0]);
+			From565(color1, palette[1]);
+			for(int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for(int i = 0; i < 16; i++)
+			{
+				int best = 0, bestError = INT32_MAX;
+				for(int p = 0; p < 4; p++)
+				{
+					int error = 0;
+					for(int c = 0; c < 3; c++)
+						error += (texels[i][c] - palette[p][c]) * (texels[i][c] - palette[p][c]);
+					if(error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= static_cast<uint32_t>(best) << (i * 2);
+			}
+		}
+		out[0] = static_cast<uint8_t>(color0);
+		out[1] = static_cast<uint8_t>(color0 >> 8);
+		out[2] = static_cast<uint8_t>(color1);
+		out[3] = static_cast<uint8_t>(color1 >> 8);
+		for(int i = 0; i < 4; i++)
+			out[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+
+	std::vector<uint8_t> EncodeBc1(const Image& image)
+	{
+		uint32_t blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+		std::vector<uint8_t> result(size_t(blocksX) * blocksY * 8);
+		uint8_t texels[16][4];
+		for(uint32_t by = 0; by < blocksY; by++)
+		{
+			for(uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				//partial blocks repeat their edge texels
+				for(uint32_t i = 0; i < 16; i++)
+				{
+					uint32_t x = std::min(bx * 4 + i % 4, image.width - 1);
+					uint32_t y = std::min(by * 4 + i / 4, image.height - 1);
+					std::memcpy(texels[i], &image.rgba[(size_t(y) * image.width + x) * 4], 4);
+				}
+				EncodeBc1Block(texels, &result[(size_t(by) * blocksX + bx) * 8]);
+			}
+		}
+		return result;
+	}
+
+	int64_t SourceTime(const std::filesystem::path& path)
+	{
+		return static_cast<int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+	}
+
+	//levels halve down to 1x1 at most, sizes match the format and the levels are packed coarsest
+	//first inside the file, which is what the single staged upload in StartUpload relies on
+	bool IsLayoutValid(const TextureFileHeader& header, uint64_t fileSize)
+	{
+		if(header.format != TextureFileFormat::Rgba8Srgb && header.format != TextureFileFormat::Bc1Srgb)
+			return false;
+		if(header.mipCount == 0 || header.mipCount > TEXTURE_MAX_MIPS)
+			return false;
+		for(uint32_t i = 0; i < header.mipCount; i++)
+		{
+			const TextureFileMip& mip = header.mips[i];
+			if(mip.width == 0 || mip.height == 0)
+				return false;
+			if(i > 0)
+			{
+				const TextureFileMip& parent = header.mips[i - 1];
+				if((parent.width == 1 && parent.height == 1) || mip.width != std::max(parent.width / 2, 1u) || mip.height != std::max(parent.height / 2, 1u))
+					return false;
+			}
+			//counted in texels or blocks so nothing overflows before the comparison
+			bool bc1 = header.format == TextureFileFormat::Bc1Srgb;
+			uint64_t units = bc1 ? uint64_t((mip.width + 3) / 4) * ((mip.height + 3) / 4) : uint64_t(mip.width) * mip.height;
+			uint64_t unitSize = bc1 ? 8 : 4;
+			if(mip.size % unitSize != 0 || mip.size / unitSize != units)
+				return false;
+			if(mip.offset < sizeof(TextureFileHeader) || mip.offset > fileSize || mip.size > fileSize - mip.offset)
+				return false;
+			if(i + 1 < header.mipCount && mip.offset < header.mips[i + 1].offset + header.mips[i + 1].size)
+				return false;
+		}
+		return true;
+	}
+
+	bool IsCacheValid(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime, TextureFileFormat format)
+	{
+		std::ifstream file(cachePath, std::ios::binary);
+		TextureFileHeader header;
+		if(!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+			return false;
+		if(header.magic != TEXTURE_FILE_MAGIC || header.version != TEXTURE_FILE_VERSION || header.format != format ||
+		   header.sourceSize != sourceSize || header.sourceTime != sourceTime)
+			return false;
+		//a damaged or foreign cache is decoded again rather than trusted
+		std::error_code error;
+		uint64_t fileSize = std::filesystem::file_size(cachePath, error);
+		return !error && IsLayoutValid(header, fileSize);
+	}
+
+	//runs on a decode worker; returns true when the existing cache could be used as is
+	bool BuildCache(const std::string& sourcePath, const std::string& cachePath, TextureFileFormat format)
+	{
+		TRACE_ZONE("BuildTextureCache");
+		uint64_t sourceSize = std::filesystem::file_size(sourcePath);
+		int64_t sourceTime = SourceTime(sourcePath);
+		if(IsCacheValid(cachePath, sourceSize, sourceTime, format))
+			return true;
+
+		int width = 0, height = 0, channels = 0;
+		stbi_uc* pixels = stbi_load(sourcePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if(pixels == nullptr)
+			throw std::runtime_error("texture: failed to decode " + sourcePath + ": " + stbi_failure_reason());
+		std::vector<Image> mips(1);
+		mips[0].width	= static_cast<uint32_t>(width);
+		mips[0].height	= static_cast<uint32_t>(height);
+		mips[0].rgba.assign(pixels, pixels + size_t(width) * height * 4);
+		stbi_image_free(pixels);
+		while((mips.back().width > 1 || mips.back().height > 1) && mips.size() < TEXTURE_MAX_MIPS)
+			mips.push_back(Downsample(mips.back()));
+
+		std::vector<std::vector<uint8_t>> levels(mips.size());
+		for(size_t i = 0; i < mips.size(); i++)
+			levels[i] = format == TextureFileFormat::Bc1Srgb ? EncodeBc1(mips[i]) : std::move(mips[i].rgba);
+
+		TextureFileHeader header;
+		header.format		= format;
+		header.mipCount		= static_cast<uint32_t>(levels.size());
+		header.sourceSize	= sourceSize;
+		header.sourceTime	= sourceTime;
+		uint64_t offset = (sizeof(TextureFileHeader) + MIP_ALIGNMENT - 1) / MIP_ALIGNMENT * MIP_ALIGNMENT;
+		for(size_t i = levels.size(); i-- > 0;)
+		{
+			header.mips[i].offset	= offset;
+			header.mips[i].size		= levels[i].size();
+			header.mips[i].width	= mips[i].width;
+			header.mips[i].height	= mips[i].height;
+			offset = (offset + levels[i].size() + MIP_ALIGNMENT - 1) / MIP_ALIGNMENT * MIP_ALIGNMENT;
+		}
+
+		//written next to the target and renamed, a reader never sees a half written cache
+		std::string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if(!file.is_open())
+				throw std::runtime_error("texture: failed to write " + tempPath);
+			const char zeros[MIP_ALIGNMENT] = {};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			uint64_t written = sizeof(header);
+			for(size_t i = levels.size(); i-- > 0;)
+			{
+				file.write(zeros, static_cast<std::streamsize>(header.mips[i].offset - written));
+				file.write(reinterpret_cast<const char*>(levels[i].data()), static_cast<std::streamsize>(levels[i].size()));
+				written = header.mips[i].offset + levels[i].size();
+			}
+			if(!file)
+				throw std::runtime_error("texture: failed to write " + tempPath);
+		}
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+		if(error)
+		{
+			std::filesystem::remove(tempPath, error);
+			throw std::runtime_error("texture: failed to replace " + cachePath);
+		}
+		return false;
+	}
+}
+
+TextureStreamer::Residency::~Residency()
+{
+	if(slot != BindlessDescriptors::INVALID_INDEX)
+		bindless->ReleaseImage(slot);
+}
+
+void TextureStreamer::Init(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, GpuAllocator& allocator, TransferUploader& uploader,
+							BindlessDescriptors& bindless, DeferredDeletionQueue& deletionQueue, const TextureStreamerConfig& config)
+{
+	this->device		= &device;
+	this->allocator		= &allocator;
+	this->uploader		= &uploader;
+	this->bindless		= &bindless;
+	this->deletionQueue	= &deletionQueue;
+	this->config		= config;
+	//BC1 needs the feature enabled at device creation and sampling support for the format
+	bool bcSupported = physicalDevice.getFeatures().textureCompressionBC &&
+					   (physicalDevice.getFormatProperties(vk::Format::eBc1RgbSrgbBlock).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage);
+	compress = config.compress && bcSupported;
+	if(config.compress && !bcSupported)
+		std::cerr << "texture streamer: BC1 is not supported, caching RGBA8" << std::endl;
+
+	vk::SamplerCreateInfo samplerInfo;
+	samplerInfo.magFilter		= vk::Filter::eLinear;
+	samplerInfo.minFilter		= vk::Filter::eLinear;
+	samplerInfo.mipmapMode		= vk::SamplerMipmapMode::eLinear;
+	samplerInfo.addressModeU	= vk::SamplerAddressMode::eRepeat;
+	samplerInfo.addressModeV	= vk::SamplerAddressMode::eRepeat;
+	samplerInfo.addressModeW	= vk::SamplerAddressMode::eRepeat;
+	samplerInfo.maxLod			= VK_LOD_CLAMP_NONE;
+	sampler		= vk::raii::Sampler(device, samplerInfo);
+	samplerSlot	= bindless.RegisterSampler(*sampler);
+	pool		= std::make_unique<ThreadPool>(config.decodeThreads != 0 ? config.decodeThreads : ThreadPool::DefaultThreadCount());
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	//outstanding decodes write files only, they just have to finish before the textures go away
+	pool.reset();
+}
+
+TextureStreamer::Handle TextureStreamer::Request(const std::string& path)
+{
+	auto texture	= std::make_unique<Texture>();
+	texture->path	= path;
+	texture->decode	= pool->Submit([path, format = compress ? TextureFileFormat::Bc1Srgb : TextureFileFormat::Rgba8Srgb](){
+		return BuildCache(path, path + ".vtex", format);
+	});
+	textures.push_back(std::move(texture));
+	stats.textures++;
+	return static_cast<Handle>(textures.size() - 1);
+}
+
+uint32_t TextureStreamer::DescriptorIndex(Handle handle)
+{
+	if(handle >= textures.size())
+		return BindlessDescriptors::INVALID_INDEX;
+	Texture& texture = *textures[handle];
+	texture.lastUsed = frame;
+	return texture.current ? texture.current->slot : BindlessDescriptors::INVALID_INDEX;
+}
+
+void TextureStreamer::FinishDecode(Texture& texture)
+{
+	try
+	{
+		bool cacheHit = texture.decode.get();
+		texture.file = std::make_unique<MappedFile>(texture.path + ".vtex");
+		if(texture.file->Size() < sizeof(TextureFileHeader))
+			throw std::runtime_error("texture: truncated cache for " + texture.path);
+		std::memcpy(&texture.header, texture.file->Data(), sizeof(TextureFileHeader));
+		const TextureFileHeader& header = texture.header;
+		//checked again on the mapping, the file could have been replaced since the decode looked at it
+		if(!IsLayoutValid(header, texture.file->Size()))
+			throw std::runtime_error("texture: corrupt cache for " + texture.path);
+		//the tail is every level up to tailSize, at least the last one
+		texture.tailLevel = header.mipCount - 1;
+		while(texture.tailLevel > 0 && std::max(header.mips[texture.tailLevel - 1].width, header.mips[texture.tailLevel - 1].height) <= config.tailSize)
+			texture.tailLevel--;
+		texture.state = State::Ready;
+		(cacheHit ? stats.cacheHits : stats.decoded)++;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		texture.file.reset();
+		texture.state = State::Failed;
+		stats.failed++;
+	}
+}
+
+vk::DeviceSize TextureStreamer::EstimateBytes(const Texture& texture, uint32_t topLevel) const
+{
+	vk::DeviceSize bytes = 0;
+	for(uint32_t i = topLevel; i < texture.header.mipCount; i++)
+		bytes += texture.header.mips[i].size;
+	return bytes;
+}
+
+vk::DeviceSize TextureStreamer::CommittedBytes(const Texture& texture)
+{
+	if(texture.pending)
+		return texture.pending->bytes;
+	return texture.current ? texture.current->bytes : 0;
+}
+
+void TextureStreamer::StartUpload(Texture& texture, uint32_t topLevel)
+{
+	const TextureFileHeader& header = texture.header;
+	uint32_t levels = header.mipCount - topLevel;
+	vk::ImageCreateInfo imageInfo;
+	imageInfo.imageType		= vk::ImageType::e2D;
+	imageInfo.format		= header.format == TextureFileFormat::Bc1Srgb ? vk::Format::eBc1RgbSrgbBlock : vk::Format::eR8G8B8A8Srgb;
+	imageInfo.extent		= vk::Extent3D{header.mips[topLevel].width, header.mips[topLevel].height, 1};
+	imageInfo.mipLevels		= levels;
+	imageInfo.arrayLayers	= 1;
+	imageInfo.samples		= vk::SampleCountFlagBits::e1;
+	imageInfo.tiling		= vk::ImageTiling::eOptimal;
+	imageInfo.usage			= vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+	imageInfo.sharingMode	= vk::SharingMode::eExclusive;
+	imageInfo.initialLayout	= vk::ImageLayout::eUndefined;
+
+	auto residency		= std::make_unique<Residency>();
+	residency->bindless	= bindless;
+	residency->topLevel	= topLevel;
+	residency->image	= allocator->CreateImage(imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	residency->bytes	= residency->image.Allocation().size;
+	vk::ImageViewCreateInfo viewInfo;
+	viewInfo.image				= *residency->image;
+	viewInfo.viewType			= vk::ImageViewType::e2D;
+	viewInfo.format				= imageInfo.format;
+	viewInfo.subresourceRange	= vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, levels, 0, 1);
+	residency->view = vk::raii::ImageView(*device, viewInfo);
+
+	//coarsest first on disk: levels topLevel..mipCount-1 are one contiguous run ending at topLevel
+	const TextureFileMip& coarsest = header.mips[header.mipCount - 1];
+	const TextureFileMip& finest = header.mips[topLevel];
+	TransferUploader::ImageUpload upload;
+	upload.image	= *residency->image;
+	upload.range	= viewInfo.subresourceRange;
+	for(uint32_t level = topLevel; level < header.mipCount; level++)
+	{
+		vk::BufferImageCopy region;
+		region.bufferOffset		= header.mips[level].offset - coarsest.offset;
+		region.imageSubresource	= vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - topLevel, 0, 1);
+		region.imageExtent		= vk::Extent3D{header.mips[level].width, header.mips[level].height, 1};
+		upload.regions.push_back(region);
+	}
+	residency->ticket	= uploader->UploadImage(upload, texture.file->Data() + coarsest.offset, finest.offset + finest.size - coarsest.offset);
+	residency->slot		= bindless->RegisterImage(*residency->view);
+
+	//callers only step textures without a pending version, so nothing in flight is replaced here
+	assert(!texture.pending);
+	vk::DeviceSize before = CommittedBytes(texture);
+	texture.pending = std::move(residency);
+	committedBytes = committedBytes - before + CommittedBytes(texture);
+	stats.uploads++;
+}
+
+bool TextureStreamer::EvictOne(uint64_t usedBefore)
+{
+	Texture* victim = nullptr;
+	for(auto& texture : textures)
+	{
+		//only settled textures above their tail, the tail always stays
+		if(texture->state != State::Ready || !texture->current || texture->pending || texture->current->topLevel >= texture->tailLevel)
+			continue;
+		if(texture->lastUsed >= usedBefore)
+			continue;
+		if(victim == nullptr || texture->lastUsed < victim->lastUsed)
+			victim = texture.get();
+	}
+	if(victim == nullptr)
+		return false;
+	StartUpload(*victim, victim->current->topLevel + 1);
+	stats.evictions++;
+	return true;
+}
+
+void TextureStreamer::Update(uint64_t retireValue)
+{
+	TRACE_ZONE("TextureStreamer::Update");
+	frame++;
+	for(auto& texture : textures)
+	{
+		if(texture->state == State::Decoding && texture->decode.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			FinishDecode(*texture);
+		//swap in finished uploads, frames recorded from now on sample the new image
+		if(texture->pending && uploader->IsAvailable(texture->pending->ticket))
+		{
+			if(texture->current)
+				deletionQueue->Push(retireValue, std::move(texture->current));
+			texture->current = std::move(texture->pending);
+		}
+	}
+
+	//most recently used first, they are what is on screen
+	std::vector<Texture*> candidates;
+	for(auto& texture : textures)
+	{
+		if(texture->state != State::Ready || texture->pending)
+			continue;
+		bool active = frame - texture->lastUsed <= config.activeFrames;
+		//the tail goes up as soon as the cache is mapped, finer levels only while in use
+		if(!texture->current || (active && texture->current->topLevel > 0))
+			candidates.push_back(texture.get());
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Texture* a, const Texture* b){ return a->lastUsed > b->lastUsed; });
+	uint32_t started = 0;
+	for(Texture* texture : candidates)
+	{
+		if(started >= config.maxUploadsPerUpdate)
+			break;
+		//an eviction for an earlier candidate may have started this one stepping down already
+		if(texture->pending)
+			continue;
+		uint32_t topLevel = texture->current ? texture->current->topLevel - 1 : texture->tailLevel;
+		vk::DeviceSize estimate = EstimateBytes(*texture, topLevel);
+		vk::DeviceSize growth = estimate > CommittedBytes(*texture) ? estimate - CommittedBytes(*texture) : 0;
+		//the tail is admitted regardless, a texture without any mips would be worse than going over
+		bool fits = !texture->current;
+		while(!fits && committedBytes + growth > config.budgetBytes)
+		{
+			if(!EvictOne(texture->lastUsed))
+				break;
+			started++;
+		}
+		fits = fits || committedBytes + growth <= config.budgetBytes;
+		if(!fits)
+			continue;
+		StartUpload(*texture, topLevel);
+		started++;
+	}
+}
+
+TextureStreamerStats TextureStreamer::Stats() const
+{
+	TextureStreamerStats result = stats;
+	result.committedBytes = committedBytes;
+	for(const auto& texture : textures)
+	{
+		if(texture->current)
+			result.residentBytes += texture->current->bytes;
+		if(texture->pending)
+			result.residentBytes += texture->pending->bytes;
+	}
+	return result;
+}
+
+void TextureStreamer::PrintStats(std::ostream& out) const
+{
+	TextureStreamerStats s = Stats();
+	constexpr double MiB = 1024.0 * 1024.0;
+	out << "textures: " << s.textures << " (" << s.cacheHits << " cached, " << s.decoded << " decoded, " << s.failed << " failed), "
+		<< s.residentBytes / MiB << " MiB resident / " << config.budgetBytes / MiB << " MiB budget, "
+		<< s.uploads << " uploads, " << s.evictions << " evictions" << (compress ? ", BC1" : "") << std::endl;
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "bindless.h"
+#include "deferred_deletion.h"
+#include "gpu_allocator.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "transfer_queue.h"
+
+struct TextureStreamerConfig
+{
+	//device memory all resident mips may use together
+	vk::DeviceSize	budgetBytes			= 256ull << 20;
+	//BC1 when the device supports it, RGBA8 otherwise
+	bool			compress			= false;
+	//decode workers, 0 = half of the hardware threads
+	size_t			decodeThreads		= 0;
+	//every mip up to this size goes up in the first upload
+	uint32_t		tailSize			= 64;
+	//new uploads started per Update, bounds the staging traffic per frame
+	uint32_t		maxUploadsPerUpdate	= 4;
+	//textures not used for this many frames stop streaming in and become eviction candidates
+	uint32_t		activeFrames		= 8;
+};
+
+//On disk layout of the <source>.vtex cache next to every streamed image.
+//Mips are stored coarsest first, so any resident range finest..coarsest is one contiguous upload.
+constexpr uint32_t TEXTURE_FILE_MAGIC	= 0x58455456;	//"VTEX"
+constexpr uint32_t TEXTURE_FILE_VERSION	= 1;
+constexpr uint32_t TEXTURE_MAX_MIPS		= 16;
+
+enum class TextureFileFormat : uint32_t
+{
+	Rgba8Srgb,
+	Bc1Srgb
+};
+
+struct TextureFileMip
+{
+	uint64_t	offset	= 0;
+	uint64_t	size	= 0;
+	uint32_t	width	= 0;
+	uint32_t	height	= 0;
+};
+
+struct TextureFileHeader
+{
+	uint32_t			magic		= TEXTURE_FILE_MAGIC;
+	uint32_t			version		= TEXTURE_FILE_VERSION;
+	TextureFileFormat	format		= TextureFileFormat::Rgba8Srgb;
+	uint32_t			mipCount	= 0;
+	//the source file the cache was built from, a mismatch triggers a new decode
+	uint64_t			sourceSize	= 0;
+	int64_t				sourceTime	= 0;
+	TextureFileMip		mips[TEXTURE_MAX_MIPS];
+};
+
+struct TextureStreamerStats
+{
+	uint32_t		textures		= 0;
+	uint32_t		decoded			= 0;
+	uint32_t		cacheHits		= 0;
+	uint32_t		failed			= 0;
+	uint64_t		uploads			= 0;
+	uint64_t		evictions		= 0;
+	vk::DeviceSize	residentBytes	= 0;
+	vk::DeviceSize	committedBytes	= 0;
+};
+
+//Streams images in on demand. Decoding, mip generation and block compression run on a worker
+//pool and end up in a GPU ready cache file; later runs map that file and skip decoding.
+//Each texture first gets its mip tail, then one finer level per step while it is in use and
+//the budget allows; over budget the least recently used textures lose their finest level.
+//A new resolution is a new image, the old one is retired through the frame timeline.
+//Everything but the decode workers runs on the render thread.
+class TextureStreamer
+{
+	public:
+		using Handle = uint32_t;
+		static constexpr Handle INVALID_HANDLE = ~0u;
+
+		void Init(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device, GpuAllocator& allocator, TransferUploader& uploader,
+					BindlessDescriptors& bindless, DeferredDeletionQueue& deletionQueue, const TextureStreamerConfig& config = {});
+		~TextureStreamer();
+		//queues decoding or cache validation, never blocks
+		Handle Request(const std::string& path);
+		//bindless image index of the best resident version, INVALID_INDEX until the first mips land;
+		//marks the texture as used this frame
+		uint32_t DescriptorIndex(Handle handle);
+		uint32_t SamplerIndex() const { return samplerSlot; }
+		//once per frame: finishes decodes and uploads, streams mips in and evicts over budget.
+		//retireValue is the frame timeline value after which replaced images are unused
+		void Update(uint64_t retireValue);
+		TextureStreamerStats Stats() const;
+		void PrintStats(std::ostream& out) const;
+		bool Compresses() const { return compress; }
+	private:
+		struct Residency
+		{
+			BindlessDescriptors*	bindless = nullptr;
+			GpuImage				image;
+			vk::raii::ImageView		view = nullptr;
+			uint32_t				slot = BindlessDescriptors::INVALID_INDEX;
+			uint32_t				topLevel = 0;
+			vk::DeviceSize			bytes = 0;
+			uint64_t				ticket = 0;
+			~Residency();
+		};
+		enum class State
+		{
+			Decoding,
+			Ready,
+			Failed
+		};
+		struct Texture
+		{
+			std::string					path;
+			State						state = State::Decoding;
+			std::future<bool>			decode;
+			std::unique_ptr<MappedFile>	file;
+			TextureFileHeader			header;
+			uint32_t					tailLevel = 0;
+			std::unique_ptr<Residency>	current;
+			std::unique_ptr<Residency>	pending;
+			uint64_t					lastUsed = 0;
+		};
+		void FinishDecode(Texture& texture);
+		//uploads mips topLevel..mipCount-1 as the texture's pending version
+		void StartUpload(Texture& texture, uint32_t topLevel);
+		vk::DeviceSize EstimateBytes(const Texture& texture, uint32_t topLevel) const;
+		static vk::DeviceSize CommittedBytes(const Texture& texture);
+		//drops the finest level of the least recently used texture used before usedBefore
+		bool EvictOne(uint64_t usedBefore);
+
+		const vk::raii::Device*						device = nullptr;
+		GpuAllocator*								allocator = nullptr;
+		TransferUploader*							uploader = nullptr;
+		BindlessDescriptors*						bindless = nullptr;
+		DeferredDeletionQueue*						deletionQueue = nullptr;
+		TextureStreamerConfig						config;
+		bool										compress = false;
+		vk::raii::Sampler							sampler = nullptr;
+		uint32_t									samplerSlot = BindlessDescriptors::INVALID_INDEX;
+		std::vector<std::unique_ptr<Texture>>		textures;
+		uint64_t									frame = 0;
+		//what the resident set adds up to once every pending upload has replaced its texture
+		vk::DeviceSize								committedBytes = 0;
+		TextureStreamerStats						stats;
+		//declared last, joined before anything the jobs could touch goes away
+		std::unique_ptr<ThreadPool>					pool;
+};
@@ -0,0 +1,48 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+#include "trace.h"
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+	threadCount = std::max<size_t>(threadCount, 1);
+	workers.reserve(threadCount);
+	for(size_t i = 0; i < threadCount; i++)
+		workers.emplace_back([this](){ WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	//queued tasks still run, their futures must not be left broken
+	for(auto& worker : workers)
+		worker.join();
+}
+
+size_t ThreadPool::DefaultThreadCount()
+{
+	return std::max<size_t>(std::thread::hardware_concurrency() / 2, 1);
+}
+
+void ThreadPool::WorkerLoop()
+{
+	TRACE_THREAD_NAME("pool worker");
+	while(true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock lock(mutex);
+			condition.wait(lock, [this](){ return stopping || !tasks.empty(); });
+			if(tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//Fixed size FIFO worker pool, shared by the subsystems that push work off the main thread
+class ThreadPool
+{
+	public:
+		explicit ThreadPool(size_t threadCount);
+		~ThreadPool();
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		template<typename F>
+		auto Submit(F&& function) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+		{
+			using Result = std::invoke_result_t<std::decay_t<F>>;
+			//std::function needs a copyable target, packaged_task is move only
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+			std::future<Result> future = task->get_future();
+			{
+				std::lock_guard lock(mutex);
+				tasks.emplace_back([task](){ (*task)(); });
+			}
+			condition.notify_one();
+			return future;
+		}
+		size_t Size() const { return workers.size(); }
+		//half of the hardware threads, at least one
+		static size_t DefaultThreadCount();
+	private:
+		void WorkerLoop();
+
+		std::vector<std::thread>			workers;
+		std::deque<std::function<void()>>	tasks;
+		std::mutex							mutex;
+		std::condition_variable				condition;
+		bool								stopping = false;
+};
@@ -0,0 +1,196 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	//24 bytes per event, 1.5 MiB per recording thread
+	constexpr uint64_t RING_CAPACITY = 1 << 16;
+
+	//fields are relaxed atomics so a snapshot racing the writer is not undefined behaviour,
+	//the head check in Snapshot drops anything that may have been overwritten meanwhile
+	struct Slot
+	{
+		std::atomic<const char*>	name{nullptr};
+		std::atomic<uint64_t>		begin{0};
+		std::atomic<uint64_t>		end{0};
+	};
+
+	struct ThreadRing
+	{
+		uint32_t					id = 0;
+		std::atomic<const char*>	threadName{nullptr};
+		//events ever written, the next one goes to head % RING_CAPACITY
+		std::atomic<uint64_t>		head{0};
+		std::unique_ptr<Slot[]>		slots = std::make_unique<Slot[]>(RING_CAPACITY);
+
+		void Push(const char* name, uint64_t begin, uint64_t end)
+		{
+			uint64_t index = head.load(std::memory_order_relaxed);
+			//pairs with the fence in Snapshot: a reader that sees any of the stores below also sees
+			//head at index, free on x86
+			std::atomic_thread_fence(std::memory_order_release);
+			Slot& slot = slots[index % RING_CAPACITY];
+			slot.name.store(name, std::memory_order_relaxed);
+			slot.begin.store(begin, std::memory_order_relaxed);
+			slot.end.store(end, std::memory_order_relaxed);
+			head.store(index + 1, std::memory_order_release);
+		}
+	};
+
+	struct Event
+	{
+		const char*	name;
+		uint64_t	begin;
+		uint64_t	end;
+	};
+
+	std::atomic<bool>							enabled{false};
+	//rings outlive their threads so a late WriteJson still sees pool workers that exited
+	std::mutex									ringsMutex;
+	std::vector<std::unique_ptr<ThreadRing>>	rings;
+	std::unique_ptr<ThreadRing>					gpuRing;
+	uint64_t									startNs = 0;
+	thread_local ThreadRing*					localRing = nullptr;
+
+	ThreadRing& LocalRing()
+	{
+		if(localRing == nullptr)
+		{
+			std::lock_guard lock(ringsMutex);
+			rings.push_back(std::make_unique<ThreadRing>());
+			rings.back()->id = static_cast<uint32_t>(rings.size());
+			localRing = rings.back().get();
+		}
+		return *localRing;
+	}
+
+	std::vector<Event> Snapshot(const ThreadRing& ring)
+	{
+		uint64_t head = ring.head.load(std::memory_order_acquire);
+		uint64_t first = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+		std::vector<Event> events;
+		events.reserve(head - first);
+		for(uint64_t i = first; i < head; i++)
+		{
+			const Slot& slot = ring.slots[i % RING_CAPACITY];
+			events.push_back({slot.name.load(std::memory_order_relaxed), slot.begin.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed)});
+		}
+		//the writer may have lapped the copy, those slots hold newer events or torn ones; the event
+		//at after is being written and already overwrites after - RING_CAPACITY
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t after = ring.head.load(std::memory_order_relaxed);
+		uint64_t overwritten = after + 1 > RING_CAPACITY ? after + 1 - RING_CAPACITY : 0;
+		if(overwritten > first)
+			events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(std::min(overwritten - first, head - first)));
+		return events;
+	}
+
+	std::string Escape(const char* text)
+	{
+		std::string result;
+		for(; text != nullptr && *text != '\0'; text++)
+		{
+			if(*text == '"' || *text == '\\')
+				result += '\\';
+			if(static_cast<unsigned char>(*text) >= 0x20)
+				result += *text;
+		}
+		return result;
+	}
+
+	void WriteThread(std::ostream& out, const ThreadRing& ring, const char* fallbackName, bool& first)
+	{
+		const char* name = ring.threadName.load(std::memory_order_relaxed);
+		out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << ring.id
+			<< ",\"args\":{\"name\":\"" << Escape(name != nullptr ? name : fallbackName) << "\"}}";
+		first = false;
+		for(const Event& event : Snapshot(ring))
+		{
+			if(event.name == nullptr || event.end < event.begin || event.begin < startNs)
+				continue;
+			//microseconds, three decimals keep the nanoseconds
+			out << ",\n{\"ph\":\"X\",\"name\":\"" << Escape(event.name) << "\",\"pid\":1,\"tid\":" << ring.id
+				<< ",\"ts\":" << static_cast<double>(event.begin - startNs) / 1000.0
+				<< ",\"dur\":" << static_cast<double>(event.end - event.begin) / 1000.0 << "}";
+		}
+	}
+}
+
+bool Tracer::Start()
+{
+#if TRACING_ENABLED
+	{
+		std::lock_guard lock(ringsMutex);
+		if(!gpuRing)
+		{
+			gpuRing = std::make_unique<ThreadRing>();
+			//far away from the CPU thread ids
+			gpuRing->id = 1000;
+			gpuRing->threadName.store("GPU", std::memory_order_relaxed);
+			startNs = Now();
+		}
+	}
+	enabled.store(true, std::memory_order_relaxed);
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool Tracer::IsEnabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t Tracer::Now()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Tracer::Record(const char* name, uint64_t beginNs, uint64_t endNs)
+{
+	LocalRing().Push(name, beginNs, endNs);
+}
+
+void Tracer::RecordGpu(const char* name, uint64_t beginNs, uint64_t endNs)
+{
+	//only the render thread collects GPU timestamps, the ring keeps a single writer
+	if(IsEnabled())
+		gpuRing->Push(name, beginNs, endNs);
+}
+
+void Tracer::SetThreadName(const char* name)
+{
+	if(IsEnabled())
+		LocalRing().threadName.store(name, std::memory_order_relaxed);
+}
+
+void Tracer::WriteJson(const std::string& path)
+{
+	if(!IsEnabled())
+		return;
+	std::ofstream file(path, std::ios::trunc);
+	if(!file.is_open())
+		throw std::runtime_error("failed to open trace file: " + path);
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	bool first = true;
+	{
+		std::lock_guard lock(ringsMutex);
+		for(const auto& ring : rings)
+			WriteThread(file, *ring, "worker", first);
+		WriteThread(file, *gpuRing, "GPU", first);
+	}
+	file << "\n]}\n";
+	if(!file)
+		throw std::runtime_error("failed to write trace file: " + path);
+}
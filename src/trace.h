@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+//Builds without -DTRACING=OFF record zones; with it every TRACE_ macro expands to nothing.
+#ifndef TRACING_ENABLED
+#define TRACING_ENABLED 1
+#endif
+
+//Scoped CPU zones in per-thread rings, written out as Chrome trace event JSON
+//(chrome://tracing, ui.perfetto.dev). Recording is off until Start; a disabled zone
+//is one relaxed atomic load. Each thread only writes its own ring, no locks after the
+//first event of a thread. Old events are overwritten once a ring is full.
+class Tracer
+{
+	public:
+		//false when tracing is compiled out
+		static bool Start();
+		static bool IsEnabled();
+		//nanoseconds on the steady clock, CLOCK_MONOTONIC on Linux
+		static uint64_t Now();
+		//name has to outlive the tracer, string literals in practice
+		static void Record(const char* name, uint64_t beginNs, uint64_t endNs);
+		//GPU work converted to Now() time, shown on its own track
+		static void RecordGpu(const char* name, uint64_t beginNs, uint64_t endNs);
+		//label of the calling thread's track
+		static void SetThreadName(const char* name);
+		//snapshot of every ring, may run while other threads keep recording
+		static void WriteJson(const std::string& path);
+};
+
+class TraceZone
+{
+	public:
+		explicit TraceZone(const char* name) : name(name), begin(Tracer::IsEnabled() ? Tracer::Now() : 0){}
+		~TraceZone()
+		{
+			if(begin != 0)
+				Tracer::Record(name, begin, Tracer::Now());
+		}
+		TraceZone(const TraceZone&) = delete;
+		TraceZone& operator=(const TraceZone&) = delete;
+	private:
+		const char*	name;
+		uint64_t	begin;
+};
+
+#if TRACING_ENABLED
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Tracer::SetThreadName(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
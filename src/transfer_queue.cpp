@@ -0,0 +1,354 @@
+#include "transfer_queue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "trace.h"
+
+namespace
+{
+	//covers bufferOffset rules of buffer to image copies for every uncompressed and block format
+	constexpr vk::DeviceSize STAGING_ALIGNMENT = 16;
+	constexpr vk::DeviceSize INVALID_OFFSET = ~0ull;
+
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+void TransferUploader::Init(const vk::raii::Device& device, GpuAllocator& allocator, const vk::raii::Queue& transferQueue, uint32_t transferFamily,
+							uint32_t graphicsFamily, vk::DeviceSize stagingSize)
+{
+	this->device			= &device;
+	this->allocator			= &allocator;
+	this->queue				= *transferQueue;
+	this->transferFamily	= transferFamily;
+	this->graphicsFamily	= graphicsFamily;
+	renderThread			= std::this_thread::get_id();
+
+	vk::CommandPoolCreateInfo poolInfo;
+	poolInfo.flags				= vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient;
+	poolInfo.queueFamilyIndex	= transferFamily;
+	commandPool = vk::raii::CommandPool(device, poolInfo);
+
+	vk::SemaphoreTypeCreateInfo typeInfo;
+	typeInfo.semaphoreType	= vk::SemaphoreType::eTimeline;
+	typeInfo.initialValue	= 0;
+	vk::SemaphoreCreateInfo semaphoreInfo;
+	semaphoreInfo.pNext = &typeInfo;
+	timeline = vk::raii::Semaphore(device, semaphoreInfo);
+
+	vk::BufferCreateInfo bufferInfo;
+	bufferInfo.size			= AlignUp(stagingSize, STAGING_ALIGNMENT);
+	bufferInfo.usage		= vk::BufferUsageFlagBits::eTransferSrc;
+	bufferInfo.sharingMode	= vk::SharingMode::eExclusive;
+	staging			= allocator.CreateBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	stagingMapped	= static_cast<uint8_t*>(staging.Mapped());
+	this->stagingSize = bufferInfo.size;
+}
+
+vk::DeviceSize TransferUploader::TryAllocateStaging(vk::DeviceSize size)
+{
+	size = AlignUp(size, STAGING_ALIGNMENT);
+	if(stagingUsed == 0)
+		stagingHead = stagingTail = 0;
+	bool full = stagingUsed > 0 && stagingHead == stagingTail;
+	if(full)
+		return INVALID_OFFSET;
+	if(stagingHead >= stagingTail)
+	{
+		if(stagingHead + size <= stagingSize)
+		{
+			vk::DeviceSize offset = stagingHead;
+			stagingHead += size;
+			stagingUsed += size;
+			current.stagingBytes += size;
+			current.stagingEnd = stagingHead;
+			return offset;
+		}
+		//wrap around, the unused tail end is accounted to this batch
+		if(size <= stagingTail)
+		{
+			vk::DeviceSize waste = stagingSize - stagingHead;
+			stagingHead = size;
+			stagingUsed += waste + size;
+			current.stagingBytes += waste + size;
+			current.stagingEnd = stagingHead;
+			return 0;
+		}
+		return INVALID_OFFSET;
+	}
+	if(stagingHead + size <= stagingTail)
+	{
+		vk::DeviceSize offset = stagingHead;
+		stagingHead += size;
+		stagingUsed += size;
+		current.stagingBytes += size;
+		current.stagingEnd = stagingHead;
+		return offset;
+	}
+	return INVALID_OFFSET;
+}
+
+std::pair<vk::Buffer, vk::DeviceSize> TransferUploader::Stage(const void* data, vk::DeviceSize size, std::unique_lock<std::mutex>& lock)
+{
+	//larger than the whole ring: a one-off staging buffer that lives as long as the batch
+	if(AlignUp(size, STAGING_ALIGNMENT) > stagingSize)
+	{
+		vk::BufferCreateInfo bufferInfo;
+		bufferInfo.size			= size;
+		bufferInfo.usage		= vk::BufferUsageFlagBits::eTransferSrc;
+		bufferInfo.sharingMode	= vk::SharingMode::eExclusive;
+		GpuBuffer& buffer = current.oversized.emplace_back(allocator->CreateBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+		std::memcpy(buffer.Mapped(), data, size);
+		return {*buffer, 0};
+	}
+	vk::DeviceSize offset = TryAllocateStaging(size);
+	while(offset == INVALID_OFFSET)
+	{
+		//the ring is full of queued or in flight copies, queued ones are submitted by the render
+		//thread only, it may be sharing the queue with this upload
+		bool renderThreadCall = std::this_thread::get_id() == renderThread;
+		if(!pending.empty() && renderThreadCall)
+			SubmitLocked();
+		else if(!inFlight.empty())
+			WaitOldest(lock);
+		else
+			stagingChanged.wait(lock);
+		offset = TryAllocateStaging(size);
+	}
+	std::memcpy(stagingMapped + offset, data, size);
+	return {*staging, offset};
+}
+
+uint64_t TransferUploader::UploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size)
+{
+	std::unique_lock lock(mutex);
+	auto [source, sourceOffset] = Stage(data, size, lock);
+	PendingCopy copy;
+	copy.source			= source;
+	copy.sourceOffset	= sourceOffset;
+	copy.dstBuffer		= dst;
+	copy.dstOffset		= dstOffset;
+	copy.size			= size;
+	pending.push_back(std::move(copy));
+	return nextValue;
+}
+
+uint64_t TransferUploader::UploadImage(const ImageUpload& upload, const void* data, vk::DeviceSize size)
+{
+	std::unique_lock lock(mutex);
+	auto [source, sourceOffset] = Stage(data, size, lock);
+	PendingCopy copy;
+	copy.source			= source;
+	copy.sourceOffset	= sourceOffset;
+	copy.size			= size;
+	copy.isImage		= true;
+	copy.image			= upload;
+	for(auto& region : copy.image.regions)
+		region.bufferOffset += sourceOffset;
+	pending.push_back(std::move(copy));
+	return nextValue;
+}
+
+uint64_t TransferUploader::Submit()
+{
+	TRACE_ZONE("TransferUploader::Submit");
+	std::lock_guard lock(mutex);
+	Reclaim();
+	return SubmitLocked();
+}
+
+uint64_t TransferUploader::SubmitLocked()
+{
+	if(pending.empty())
+		return 0;
+	if(freeCommandBuffers.empty())
+	{
+		vk::CommandBufferAllocateInfo allocInfo;
+		allocInfo.commandPool			= commandPool;
+		allocInfo.level					= vk::CommandBufferLevel::ePrimary;
+		allocInfo.commandBufferCount	= 1;
+		freeCommandBuffers.push_back(std::move(vk::raii::CommandBuffers(*device, allocInfo).front()));
+	}
+	current.commandBuffer = std::move(freeCommandBuffers.back());
+	freeCommandBuffers.pop_back();
+	auto& commandBuffer = current.commandBuffer;
+	commandBuffer.reset();
+	vk::CommandBufferBeginInfo beginInfo;
+	beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+	commandBuffer.begin(beginInfo);
+
+	bool transferOwnership = transferFamily != graphicsFamily;
+	std::vector<vk::ImageMemoryBarrier2> toTransferDst;
+	for(const auto& copy : pending)
+	{
+		if(!copy.isImage)
+			continue;
+		vk::ImageMemoryBarrier2 barrier;
+		barrier.srcStageMask		= vk::PipelineStageFlagBits2::eNone;
+		barrier.dstStageMask		= vk::PipelineStageFlagBits2::eCopy;
+		barrier.dstAccessMask		= vk::AccessFlagBits2::eTransferWrite;
+		barrier.oldLayout			= vk::ImageLayout::eUndefined;
+		barrier.newLayout			= vk::ImageLayout::eTransferDstOptimal;
+		barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.image				= copy.image.image;
+		barrier.subresourceRange	= copy.image.range;
+		toTransferDst.push_back(barrier);
+	}
+	if(!toTransferDst.empty())
+	{
+		vk::DependencyInfo dependencyInfo;
+		dependencyInfo.imageMemoryBarrierCount	= static_cast<uint32_t>(toTransferDst.size());
+		dependencyInfo.pImageMemoryBarriers		= toTransferDst.data();
+		commandBuffer.pipelineBarrier2(dependencyInfo);
+	}
+
+	std::vector<vk::BufferMemoryBarrier2> bufferReleases;
+	std::vector<vk::ImageMemoryBarrier2> imageReleases;
+	for(const auto& copy : pending)
+	{
+		if(copy.isImage)
+		{
+			commandBuffer.copyBufferToImage(copy.source, copy.image.image, vk::ImageLayout::eTransferDstOptimal, copy.image.regions);
+			//release to the graphics family, or just the final layout when there is only one family
+			vk::ImageMemoryBarrier2 release;
+			release.srcStageMask		= vk::PipelineStageFlagBits2::eCopy;
+			release.srcAccessMask		= vk::AccessFlagBits2::eTransferWrite;
+			release.oldLayout			= vk::ImageLayout::eTransferDstOptimal;
+			release.newLayout			= copy.image.finalLayout;
+			release.srcQueueFamilyIndex	= transferOwnership ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+			release.dstQueueFamilyIndex	= transferOwnership ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+			release.image				= copy.image.image;
+			release.subresourceRange	= copy.image.range;
+			imageReleases.push_back(release);
+			if(transferOwnership)
+			{
+				vk::ImageMemoryBarrier2 acquire = release;
+				acquire.srcStageMask	= vk::PipelineStageFlagBits2::eNone;
+				acquire.srcAccessMask	= {};
+				acquire.dstStageMask	= vk::PipelineStageFlagBits2::eAllCommands;
+				acquire.dstAccessMask	= vk::AccessFlagBits2::eMemoryRead;
+				current.imageAcquires.push_back(acquire);
+			}
+		}
+		else
+		{
+			vk::BufferCopy region(copy.sourceOffset, copy.dstOffset, copy.size);
+			commandBuffer.copyBuffer(copy.source, copy.dstBuffer, region);
+			if(transferOwnership)
+			{
+				vk::BufferMemoryBarrier2 release;
+				release.srcStageMask		= vk::PipelineStageFlagBits2::eCopy;
+				release.srcAccessMask		= vk::AccessFlagBits2::eTransferWrite;
+				release.srcQueueFamilyIndex	= transferFamily;
+				release.dstQueueFamilyIndex	= graphicsFamily;
+				release.buffer				= copy.dstBuffer;
+				release.offset				= copy.dstOffset;
+				release.size				= copy.size;
+				bufferReleases.push_back(release);
+				vk::BufferMemoryBarrier2 acquire = release;
+				acquire.srcStageMask	= vk::PipelineStageFlagBits2::eNone;
+				acquire.srcAccessMask	= {};
+				acquire.dstStageMask	= vk::PipelineStageFlagBits2::eAllCommands;
+				acquire.dstAccessMask	= vk::AccessFlagBits2::eMemoryRead;
+				current.bufferAcquires.push_back(acquire);
+			}
+		}
+	}
+	if(!bufferReleases.empty() || !imageReleases.empty())
+	{
+		vk::DependencyInfo dependencyInfo;
+		dependencyInfo.bufferMemoryBarrierCount	= static_cast<uint32_t>(bufferReleases.size());
+		dependencyInfo.pBufferMemoryBarriers	= bufferReleases.data();
+		dependencyInfo.imageMemoryBarrierCount	= static_cast<uint32_t>(imageReleases.size());
+		dependencyInfo.pImageMemoryBarriers		= imageReleases.data();
+		commandBuffer.pipelineBarrier2(dependencyInfo);
+	}
+	commandBuffer.end();
+
+	current.value = nextValue++;
+	vk::CommandBufferSubmitInfo commandBufferInfo(*commandBuffer);
+	vk::SemaphoreSubmitInfo signalInfo(*timeline, current.value, vk::PipelineStageFlagBits2::eAllCommands);
+	vk::SubmitInfo2 submitInfo;
+	submitInfo.commandBufferInfoCount	= 1;
+	submitInfo.pCommandBufferInfos		= &commandBufferInfo;
+	submitInfo.signalSemaphoreInfoCount	= 1;
+	submitInfo.pSignalSemaphoreInfos	= &signalInfo;
+	queue.submit2(submitInfo);
+
+	uint64_t value = current.value;
+	pending.clear();
+	inFlight.push_back(std::move(current));
+	current = Batch{};
+	stagingChanged.notify_all();
+	return value;
+}
+
+void TransferUploader::Reclaim()
+{
+	uint64_t completed = timeline.getCounterValue();
+	if(!inFlight.empty() && inFlight.front().value <= completed)
+		stagingChanged.notify_all();
+	while(!inFlight.empty() && inFlight.front().value <= completed)
+	{
+		Batch& batch = inFlight.front();
+		stagingTail = batch.stagingBytes > 0 ? batch.stagingEnd : stagingTail;
+		stagingUsed -= batch.stagingBytes;
+		readyBufferAcquires.insert(readyBufferAcquires.end(), batch.bufferAcquires.begin(), batch.bufferAcquires.end());
+		readyImageAcquires.insert(readyImageAcquires.end(), batch.imageAcquires.begin(), batch.imageAcquires.end());
+		readyValue = batch.value;
+		freeCommandBuffers.push_back(std::move(batch.commandBuffer));
+		inFlight.pop_front();
+	}
+}
+
+void TransferUploader::WaitOldest(std::unique_lock<std::mutex>& lock)
+{
+	if(inFlight.empty())
+		return;
+	//other threads keep staging and the render thread keeps submitting meanwhile
+	uint64_t value = inFlight.front().value;
+	lock.unlock();
+	vk::SemaphoreWaitInfo waitInfo;
+	waitInfo.semaphoreCount	= 1;
+	waitInfo.pSemaphores	= &*timeline;
+	waitInfo.pValues		= &value;
+	vk::Result result = device->waitSemaphores(waitInfo, UINT64_MAX);
+	lock.lock();
+	if(result != vk::Result::eSuccess)
+		throw std::runtime_error("failed to wait for transfer timeline!");
+	Reclaim();
+}
+
+uint64_t TransferUploader::RecordAcquireBarriers(const vk::raii::CommandBuffer& commandBuffer)
+{
+	std::lock_guard lock(mutex);
+	Reclaim();
+	if(readyValue <= acquiredValue)
+		return 0;
+	if(!readyBufferAcquires.empty() || !readyImageAcquires.empty())
+	{
+		vk::DependencyInfo dependencyInfo;
+		dependencyInfo.bufferMemoryBarrierCount	= static_cast<uint32_t>(readyBufferAcquires.size());
+		dependencyInfo.pBufferMemoryBarriers	= readyBufferAcquires.data();
+		dependencyInfo.imageMemoryBarrierCount	= static_cast<uint32_t>(readyImageAcquires.size());
+		dependencyInfo.pImageMemoryBarriers		= readyImageAcquires.data();
+		commandBuffer.pipelineBarrier2(dependencyInfo);
+		readyBufferAcquires.clear();
+		readyImageAcquires.clear();
+	}
+	acquiredValue = readyValue;
+	return readyValue;
+}
+
+void TransferUploader::WaitIdle()
+{
+	std::unique_lock lock(mutex);
+	SubmitLocked();
+	while(!inFlight.empty())
+		WaitOldest(lock);
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "gpu_allocator.h"
+
+//Batches staging copies onto a dedicated transfer queue when the device has one.
+//Every submitted batch signals the next value of a timeline semaphore; the graphics
+//queue takes ownership of finished uploads in RecordAcquireBarriers and waits on that
+//value, so uploads never stall the frame that is being rendered.
+//Upload* are thread safe, Submit/RecordAcquireBarriers belong to the render thread, the one
+//that called Init. Only the render thread submits: without a dedicated family the transfer
+//queue is the graphics queue, so other threads with a full staging ring wait for its Submit.
+class TransferUploader
+{
+	public:
+		struct ImageUpload
+		{
+			vk::Image							image;
+			vk::ImageSubresourceRange			range;
+			std::vector<vk::BufferImageCopy>	regions;	//bufferOffset relative to the uploaded data
+			vk::ImageLayout						finalLayout	= vk::ImageLayout::eShaderReadOnlyOptimal;
+		};
+		void Init(const vk::raii::Device& device, GpuAllocator& allocator, const vk::raii::Queue& transferQueue, uint32_t transferFamily,
+					uint32_t graphicsFamily, vk::DeviceSize stagingSize);
+		//copies data into staging memory right away; returns the ticket the copy completes with
+		uint64_t UploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size);
+		uint64_t UploadImage(const ImageUpload& upload, const void* data, vk::DeviceSize size);
+		//submits everything queued since the last call, returns its ticket or 0
+		uint64_t Submit();
+		//acquires ownership of every finished upload and returns the timeline value to wait for, or 0
+		uint64_t RecordAcquireBarriers(const vk::raii::CommandBuffer& commandBuffer);
+		//true once ticket is owned by the graphics queue
+		bool IsAvailable(uint64_t ticket) const { return ticket <= acquiredValue; }
+		vk::Semaphore Timeline() const { return *timeline; }
+		bool HasDedicatedQueue() const { return transferFamily != graphicsFamily; }
+		void WaitIdle();
+	private:
+		struct Batch
+		{
+			uint64_t							value = 0;
+			vk::DeviceSize						stagingEnd = 0;
+			vk::DeviceSize						stagingBytes = 0;
+			std::vector<GpuBuffer>				oversized;
+			vk::raii::CommandBuffer				commandBuffer = nullptr;
+			std::vector<vk::BufferMemoryBarrier2>	bufferAcquires;
+			std::vector<vk::ImageMemoryBarrier2>	imageAcquires;
+		};
+		struct PendingCopy
+		{
+			vk::Buffer				source;
+			vk::DeviceSize			sourceOffset = 0;
+			vk::Buffer				dstBuffer;
+			vk::DeviceSize			dstOffset = 0;
+			vk::DeviceSize			size = 0;
+			bool					isImage = false;
+			ImageUpload				image;
+		};
+		//returns the staging offset or ~0 when the ring is full
+		vk::DeviceSize TryAllocateStaging(vk::DeviceSize size);
+		//stages data, submits or waits for older batches when the ring is full; returns the source buffer and offset
+		std::pair<vk::Buffer, vk::DeviceSize> Stage(const void* data, vk::DeviceSize size, std::unique_lock<std::mutex>& lock);
+		uint64_t SubmitLocked();
+		void Reclaim();
+		//blocks on the oldest batch in flight with lock released
+		void WaitOldest(std::unique_lock<std::mutex>& lock);
+
+		const vk::raii::Device*		device = nullptr;
+		GpuAllocator*				allocator = nullptr;
+		vk::Queue					queue;
+		uint32_t					transferFamily = 0;
+		uint32_t					graphicsFamily = 0;
+		vk::raii::CommandPool		commandPool = nullptr;
+		std::vector<vk::raii::CommandBuffer> freeCommandBuffers;
+		vk::raii::Semaphore			timeline = nullptr;
+		GpuBuffer					staging;
+		uint8_t*					stagingMapped = nullptr;
+		vk::DeviceSize				stagingSize = 0;
+		vk::DeviceSize				stagingHead = 0;
+		vk::DeviceSize				stagingTail = 0;
+		vk::DeviceSize				stagingUsed = 0;
+		std::thread::id				renderThread;
+		std::mutex					mutex;
+		//a batch was submitted or staging was reclaimed
+		std::condition_variable		stagingChanged;
+		Batch						current;
+		std::vector<PendingCopy>	pending;
+		std::deque<Batch>			inFlight;
+		//finished batches whose ownership the graphics queue still has to acquire
+		std::vector<vk::BufferMemoryBarrier2>	readyBufferAcquires;
+		std::vector<vk::ImageMemoryBarrier2>	readyImageAcquires;
+		uint64_t					readyValue = 0;
+		uint64_t					nextValue = 1;
+		uint64_t					acquiredValue = 0;
+};
@@ -0,0 +1,84 @@
+#include "upload_ring.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+void UploadRing::Init(GpuAllocator& allocator, const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device,
+						vk::DeviceSize regionSize, uint32_t regionCount, vk::BufferUsageFlags usage)
+{
+	auto limits			= physicalDevice.getProperties().limits;
+	this->device		= &device;
+	defaultAlignment	= std::max({limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, vk::DeviceSize(16)});
+	nonCoherentAtomSize	= limits.nonCoherentAtomSize;
+	//every region starts on an alignment and flush boundary
+	this->regionSize	= AlignUp(AlignUp(regionSize, defaultAlignment), nonCoherentAtomSize);
+
+	vk::BufferCreateInfo bufferInfo;
+	bufferInfo.size			= this->regionSize * regionCount;
+	bufferInfo.usage		= usage;
+	bufferInfo.sharingMode	= vk::SharingMode::eExclusive;
+	//device local host visible memory (ReBAR/UMA) when there is some, plain host memory otherwise
+	buffer = allocator.CreateBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eHostVisible,
+									vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostCoherent);
+	mapped		= static_cast<uint8_t*>(buffer.Mapped());
+	coherent	= static_cast<bool>(allocator.MemoryProperties().memoryTypes[buffer.Allocation().memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent);
+	//slices can be handed to shaders as pointers, e.g. through push constants
+	if(usage & vk::BufferUsageFlagBits::eShaderDeviceAddress)
+		deviceAddress = device.getBufferAddress(vk::BufferDeviceAddressInfo(*buffer));
+	BeginFrame(0);
+}
+
+void UploadRing::BeginFrame(uint32_t frameSlot)
+{
+	regionBegin = regionSize * frameSlot;
+	head.store(regionBegin, std::memory_order_relaxed);
+}
+
+vk::DeviceSize UploadRing::Capacity(vk::DeviceSize size, vk::DeviceSize reserved) const
+{
+	if(size == 0 || reserved >= regionSize)
+		return 0;
+	return (regionSize - reserved) / AlignUp(size, defaultAlignment);
+}
+
+UploadRing::Slice UploadRing::Allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	alignment = alignment == 0 ? defaultAlignment : alignment;
+	vk::DeviceSize current = head.load(std::memory_order_relaxed);
+	vk::DeviceSize offset;
+	do
+	{
+		offset = AlignUp(current, alignment);
+		if(offset + size > regionBegin + regionSize)
+			throw std::runtime_error("upload ring: frame region of " + std::to_string(regionSize) + " bytes exhausted");
+	}
+	while(!head.compare_exchange_weak(current, offset + size, std::memory_order_relaxed));
+	return Slice{mapped + offset, offset, size};
+}
+
+void UploadRing::Flush()
+{
+	vk::DeviceSize used = head.load(std::memory_order_relaxed) - regionBegin;
+	peakBytes = std::max(peakBytes, used);
+	if(coherent || used == 0)
+		return;
+	vk::MappedMemoryRange range;
+	range.memory	= buffer.Allocation().memory;
+	range.offset	= buffer.Allocation().offset + regionBegin;
+	range.size		= AlignUp(used, nonCoherentAtomSize);
+	device->flushMappedMemoryRanges(range);
+}
+
+void UploadRing::PrintStats(std::ostream& out) const
+{
+	out << "upload ring: peak " << peakBytes << " / " << regionSize << " bytes per frame ("
+		<< (coherent ? "coherent" : "flushed") << ")" << std::endl;
+}
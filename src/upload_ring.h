@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "gpu_allocator.h"
+
+//Host visible, persistently mapped buffer split into one region per frame in flight.
+//A region is rewritten only after the frame that used it has completed, so uploads
+//are a plain memcpy into mapped memory with no per-frame allocation or extra copy.
+class UploadRing
+{
+	public:
+		struct Slice
+		{
+			void*			data	= nullptr;
+			vk::DeviceSize	offset	= 0;
+			vk::DeviceSize	size	= 0;
+		};
+		void Init(GpuAllocator& allocator, const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::Device& device,
+					vk::DeviceSize regionSize, uint32_t regionCount, vk::BufferUsageFlags usage);
+		//call once the frame that last used frameSlot has completed
+		void BeginFrame(uint32_t frameSlot);
+		//lock free, may be called from recording threads; throws when the region is exhausted
+		Slice Allocate(vk::DeviceSize size, vk::DeviceSize alignment = 0);
+		template<typename T>
+		Slice Push(const T& value)
+		{
+			Slice slice = Allocate(sizeof(T));
+			std::memcpy(slice.data, &value, sizeof(T));
+			return slice;
+		}
+		//makes this frame's writes visible when the memory is not host coherent
+		void Flush();
+		vk::Buffer Buffer() const { return *buffer; }
+		//0 unless the ring was created with eShaderDeviceAddress
+		vk::DeviceAddress DeviceAddress() const { return deviceAddress; }
+		vk::DeviceSize RegionSize() const { return regionSize; }
+		//how many default aligned allocations of size fit into one region, reserved bytes kept free
+		vk::DeviceSize Capacity(vk::DeviceSize size, vk::DeviceSize reserved = 0) const;
+		vk::DeviceSize PeakBytes() const { return peakBytes; }
+		void PrintStats(std::ostream& out) const;
+	private:
+		const vk::raii::Device*		device = nullptr;
+		GpuBuffer					buffer;
+		vk::DeviceAddress			deviceAddress = 0;
+		uint8_t*					mapped = nullptr;
+		vk::DeviceSize				regionSize = 0;
+		vk::DeviceSize				defaultAlignment = 1;
+		vk::DeviceSize				nonCoherentAtomSize = 1;
+		bool						coherent = true;
+		vk::DeviceSize				regionBegin = 0;
+		std::atomic<vk::DeviceSize>	head = 0;
+		vk::DeviceSize				peakBytes = 0;
+};
@@ -0,0 +1,474 @@
+//Converts a Wavefront OBJ into the .vmesh container described in src/mesh_format.h:
+//deduplicated vertices with quantized attributes, indices reordered for the vertex cache
+//(Forsyth's linear speed optimizer) and meshlets with bounding spheres.
+//usage: MeshConverter input.obj output.vmesh
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "mesh_format.h"
+
+namespace
+{
+	struct Vertex
+	{
+		glm::vec3	position{0.0f};
+		glm::vec3	normal{0.0f};
+		glm::vec2	uv{0.0f};
+	};
+
+	struct Mesh
+	{
+		std::vector<Vertex>		vertices;
+		std::vector<uint32_t>	indices;
+	};
+
+	//position/uv/normal indices of one face corner, -1 = missing
+	struct CornerKey
+	{
+		int		position	= -1;
+		int		uv			= -1;
+		int		normal		= -1;
+		bool operator==(const CornerKey&) const = default;
+	};
+
+	struct CornerKeyHash
+	{
+		size_t operator()(const CornerKey& key) const
+		{
+			uint64_t hash = static_cast<uint32_t>(key.position);
+			hash = hash * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(key.uv);
+			hash = hash * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(key.normal);
+			return static_cast<size_t>(hash ^ (hash >> 32));
+		}
+	};
+
+	//OBJ indices are 1 based, negative ones count back from the end
+	int ResolveIndex(const std::string& token, size_t count)
+	{
+		if(token.empty())
+			return -1;
+		int index = std::stoi(token);
+		int resolved = index < 0 ? static_cast<int>(count) + index : index - 1;
+		if(resolved < 0 || resolved >= static_cast<int>(count))
+			throw std::runtime_error("obj: index out of range: " + token);
+		return resolved;
+	}
+
+	Mesh LoadObj(const std::string& path)
+	{
+		std::ifstream file(path);
+		if(!file.is_open())
+			throw std::runtime_error("failed to open " + path);
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> uvs;
+		std::unordered_map<CornerKey, uint32_t, CornerKeyHash> corners;
+		Mesh mesh;
+		bool computeNormals = false;
+		std::string line;
+		std::vector<uint32_t> face;
+		while(std::getline(file, line))
+		{
+			std::istringstream stream(line);
+			std::string type;
+			stream >> type;
+			if(type == "v")
+			{
+				glm::vec3 p;
+				stream >> p.x >> p.y >> p.z;
+				positions.push_back(p);
+			}
+			else if(type == "vn")
+			{
+				glm::vec3 n;
+				stream >> n.x >> n.y >> n.z;
+				normals.push_back(n);
+			}
+			else if(type == "vt")
+			{
+				glm::vec2 t;
+				stream >> t.x >> t.y;
+				uvs.push_back(t);
+			}
+			else if(type == "f")
+			{
+				face.clear();
+				std::string corner;
+				while(stream >> corner)
+				{
+					//v, v/vt, v//vn or v/vt/vn
+					CornerKey key;
+					size_t first = corner.find('/');
+					key.position = ResolveIndex(corner.substr(0, first), positions.size());
+					if(first != std::string::npos)
+					{
+						size_t second = corner.find('/', first + 1);
+						key.uv = ResolveIndex(corner.substr(first + 1, second - first - 1), uvs.size());
+						if(second != std::string::npos)
+							key.normal = ResolveIndex(corner.substr(second + 1), normals.size());
+					}
+					auto [it, inserted] = corners.try_emplace(key, static_cast<uint32_t>(mesh.vertices.size()));
+					if(inserted)
+					{
+						Vertex vertex;
+						vertex.position = positions[key.position];
+						if(key.uv >= 0)
+							vertex.uv = uvs[key.uv];
+						if(key.normal >= 0)
+							vertex.normal = normals[key.normal];
+						else
+							computeNormals = true;
+						mesh.vertices.push_back(vertex);
+					}
+					face.push_back(it->second);
+				}
+				//polygons become triangle fans
+				for(size_t i = 2; i < face.size(); i++)
+					mesh.indices.insert(mesh.indices.end(), {face[0], face[i - 1], face[i]});
+			}
+		}
+		if(mesh.indices.empty())
+			throw std::runtime_error("obj: " + path + " has no faces");
+		//area weighted face normals for vertices the file has none for
+		if(computeNormals)
+		{
+			std::vector<glm::vec3> accumulated(mesh.vertices.size(), glm::vec3(0.0f));
+			for(size_t i = 0; i < mesh.indices.size(); i += 3)
+			{
+				const glm::vec3& a = mesh.vertices[mesh.indices[i]].position;
+				const glm::vec3& b = mesh.vertices[mesh.indices[i + 1]].position;
+				const glm::vec3& c = mesh.vertices[mesh.indices[i + 2]].position;
+				glm::vec3 n = glm::cross(b - a, c - a);
+				for(size_t k = 0; k < 3; k++)
+					accumulated[mesh.indices[i + k]] += n;
+			}
+			for(size_t i = 0; i < mesh.vertices.size(); i++)
+			{
+				if(glm::dot(mesh.vertices[i].normal, mesh.vertices[i].normal) == 0.0f && glm::dot(accumulated[i], accumulated[i]) > 0.0f)
+					mesh.vertices[i].normal = glm::normalize(accumulated[i]);
+			}
+		}
+		return mesh;
+	}
+
+	//Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+	constexpr int CACHE_SIZE = 32;
+
+	float VertexScore(int cachePosition, uint32_t remainingTriangles)
+	{
+		if(remainingTriangles == 0)
+			return -1.0f;
+		float score = 0.0f;
+		if(cachePosition >= 0)
+		{
+			//the last triangle's vertices get a fixed score so its neighbours are not preferred blindly
+			if(cachePosition < 3)
+				score = 0.75f;
+			else
+				score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / static_cast<float>(CACHE_SIZE - 3), 1.5f);
+		}
+		//favour vertices with few triangles left, finishing them frees cache slots
+		return score + 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+	}
+
+	std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		size_t triangleCount = indices.size() / 3;
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for(uint32_t index : indices)
+			adjacencyOffsets[index + 1]++;
+		for(size_t i = 0; i < vertexCount; i++)
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for(size_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		std::vector<uint32_t> remaining(vertexCount);
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for(size_t v = 0; v < vertexCount; v++)
+		{
+			remaining[v]	= adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+			vertexScore[v]	= VertexScore(-1, remaining[v]);
+		}
+		std::vector<float> triangleScore(triangleCount);
+		for(size_t t = 0; t < triangleCount; t++)
+			triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		std::vector<bool> emitted(triangleCount, false);
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> nextCache;
+		size_t scanCursor = 0;
+		int64_t best = -1;
+		for(size_t t = 0; t < triangleCount; t++)
+			if(best < 0 || triangleScore[t] > triangleScore[best])
+				best = static_cast<int64_t>(t);
+		while(best >= 0)
+		{
+			uint32_t triangle = static_cast<uint32_t>(best);
+			emitted[triangle] = true;
+			nextCache.clear();
+			for(int k = 0; k < 3; k++)
+			{
+				uint32_t v = indices[triangle * 3 + k];
+				result.push_back(v);
+				nextCache.push_back(v);
+				//drop the triangle from the vertex's live adjacency
+				uint32_t begin = adjacencyOffsets[v];
+				uint32_t end = begin + remaining[v];
+				for(uint32_t a = begin; a < end; a++)
+				{
+					if(adjacency[a] == triangle)
+					{
+						std::swap(adjacency[a], adjacency[end - 1]);
+						break;
+					}
+				}
+				remaining[v]--;
+			}
+			for(uint32_t v : cache)
+				if(std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+					nextCache.push_back(v);
+			//vertices pushed out of the cache lose their cache bonus
+			for(size_t i = CACHE_SIZE; i < nextCache.size(); i++)
+			{
+				uint32_t v = nextCache[i];
+				cachePosition[v]	= -1;
+				vertexScore[v]		= VertexScore(-1, remaining[v]);
+				for(uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + remaining[v]; a++)
+				{
+					uint32_t t = adjacency[a];
+					triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				}
+			}
+			nextCache.resize(std::min<size_t>(nextCache.size(), CACHE_SIZE));
+			cache.swap(nextCache);
+			for(size_t i = 0; i < cache.size(); i++)
+			{
+				cachePosition[cache[i]]	= static_cast<int>(i);
+				vertexScore[cache[i]]	= VertexScore(static_cast<int>(i), remaining[cache[i]]);
+			}
+			//the next triangle is almost always adjacent to the cache
+			best = -1;
+			for(uint32_t v : cache)
+			{
+				for(uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + remaining[v]; a++)
+				{
+					uint32_t t = adjacency[a];
+					triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+					if(best < 0 || triangleScore[t] > triangleScore[best])
+						best = t;
+				}
+			}
+			if(best < 0)
+			{
+				while(scanCursor < triangleCount && emitted[scanCursor])
+					scanCursor++;
+				if(scanCursor < triangleCount)
+					best = static_cast<int64_t>(scanCursor);
+			}
+		}
+		return result;
+	}
+
+	//average cache miss ratio of a FIFO cache, for the report only
+	double AverageCacheMissRatio(const std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize = 16)
+	{
+		std::vector<size_t> timestamps(vertexCount, 0);
+		size_t time = cacheSize + 1;
+		size_t misses = 0;
+		for(uint32_t index : indices)
+		{
+			if(time - timestamps[index] > cacheSize)
+			{
+				timestamps[index] = time++;
+				misses++;
+			}
+		}
+		return static_cast<double>(misses) / static_cast<double>(indices.size() / 3);
+	}
+
+	struct Meshlets
+	{
+		std::vector<MeshletDesc>	meshlets;
+		std::vector<uint32_t>		vertices;
+		std::vector<uint8_t>		triangles;
+	};
+
+	//greedy clusters in index order, which the cache optimizer already made spatially coherent
+	Meshlets BuildMeshlets(const Mesh& mesh)
+	{
+		Meshlets result;
+		std::vector<uint8_t> localIndex(mesh.vertices.size(), 0xff);
+		MeshletDesc current{};
+		auto flush = [&](){
+			if(current.triangleCount == 0)
+				return;
+			glm::vec3 minimum(std::numeric_limits<float>::max());
+			glm::vec3 maximum(std::numeric_limits<float>::lowest());
+			for(uint32_t i = 0; i < current.vertexCount; i++)
+			{
+				uint32_t v = result.vertices[current.vertexOffset + i];
+				minimum = glm::min(minimum, mesh.vertices[v].position);
+				maximum = glm::max(maximum, mesh.vertices[v].position);
+				localIndex[v] = 0xff;
+			}
+			glm::vec3 center = (minimum + maximum) * 0.5f;
+			float radius = 0.0f;
+			for(uint32_t i = 0; i < current.vertexCount; i++)
+				radius = std::max(radius, glm::length(mesh.vertices[result.vertices[current.vertexOffset + i]].position - center));
+			std::memcpy(current.center, &center, sizeof(current.center));
+			current.radius = radius;
+			result.meshlets.push_back(current);
+			current = {};
+			current.vertexOffset	= static_cast<uint32_t>(result.vertices.size());
+			current.triangleOffset	= static_cast<uint32_t>(result.triangles.size());
+		};
+		for(size_t i = 0; i < mesh.indices.size(); i += 3)
+		{
+			uint32_t newVertices = 0;
+			for(size_t k = 0; k < 3; k++)
+				if(localIndex[mesh.indices[i + k]] == 0xff)
+					newVertices++;
+			if(current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.triangleCount + 1 > MESHLET_MAX_TRIANGLES)
+				flush();
+			for(size_t k = 0; k < 3; k++)
+			{
+				uint32_t v = mesh.indices[i + k];
+				if(localIndex[v] == 0xff)
+				{
+					localIndex[v] = static_cast<uint8_t>(current.vertexCount++);
+					result.vertices.push_back(v);
+				}
+				result.triangles.push_back(localIndex[v]);
+			}
+			current.triangleCount++;
+		}
+		flush();
+		return result;
+	}
+
+	int16_t QuantizeSnorm16(float value)
+	{
+		return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	int8_t QuantizeSnorm8(float value)
+	{
+		return static_cast<int8_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 127.0f));
+	}
+
+	std::vector<PackedVertex> QuantizeVertices(const Mesh& mesh, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+		for(const Vertex& vertex : mesh.vertices)
+		{
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+		}
+		glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-20f));
+		std::vector<PackedVertex> packed(mesh.vertices.size());
+		for(size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			const Vertex& vertex = mesh.vertices[i];
+			glm::vec3 normalized = (vertex.position - boundsMin) / extent * 2.0f - 1.0f;
+			for(int k = 0; k < 3; k++)
+			{
+				packed[i].position[k]	= QuantizeSnorm16(normalized[k]);
+				packed[i].normal[k]		= QuantizeSnorm8(vertex.normal[k]);
+			}
+			packed[i].position[3]	= 0;
+			packed[i].normal[3]		= 0;
+			packed[i].uv[0]			= glm::packHalf1x16(vertex.uv.x);
+			packed[i].uv[1]			= glm::packHalf1x16(vertex.uv.y);
+		}
+		return packed;
+	}
+
+	void WriteMeshFile(const std::string& path, MeshFileHeader header, const std::array<std::pair<const void*, uint64_t>, static_cast<size_t>(MeshSection::Count)>& sections)
+	{
+		uint64_t offset = (sizeof(MeshFileHeader) + MESH_SECTION_ALIGNMENT - 1) / MESH_SECTION_ALIGNMENT * MESH_SECTION_ALIGNMENT;
+		for(size_t i = 0; i < sections.size(); i++)
+		{
+			header.sections[i].offset	= offset;
+			header.sections[i].size		= sections[i].second;
+			offset = (offset + sections[i].second + MESH_SECTION_ALIGNMENT - 1) / MESH_SECTION_ALIGNMENT * MESH_SECTION_ALIGNMENT;
+		}
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if(!file.is_open())
+			throw std::runtime_error("failed to open " + path + " for writing");
+		const char zeros[MESH_SECTION_ALIGNMENT] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		uint64_t written = sizeof(header);
+		for(size_t i = 0; i < sections.size(); i++)
+		{
+			file.write(zeros, static_cast<std::streamsize>(header.sections[i].offset - written));
+			file.write(static_cast<const char*>(sections[i].first), static_cast<std::streamsize>(sections[i].second));
+			written = header.sections[i].offset + sections[i].second;
+		}
+		if(!file)
+			throw std::runtime_error("failed to write " + path);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc != 3)
+	{
+		std::cerr << "usage: " << argv[0] << " input.obj output.vmesh" << std::endl;
+		return EXIT_FAILURE;
+	}
+	try
+	{
+		auto start = std::chrono::steady_clock::now();
+		Mesh mesh = LoadObj(argv[1]);
+		double missesBefore = AverageCacheMissRatio(mesh.indices, mesh.vertices.size());
+		mesh.indices = OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+		double missesAfter = AverageCacheMissRatio(mesh.indices, mesh.vertices.size());
+		Meshlets meshlets = BuildMeshlets(mesh);
+		glm::vec3 boundsMin, boundsMax;
+		std::vector<PackedVertex> vertices = QuantizeVertices(mesh, boundsMin, boundsMax);
+
+		MeshFileHeader header;
+		header.vertexCount	= static_cast<uint32_t>(vertices.size());
+		header.indexCount	= static_cast<uint32_t>(mesh.indices.size());
+		header.meshletCount	= static_cast<uint32_t>(meshlets.meshlets.size());
+		std::memcpy(header.boundsMin, &boundsMin, sizeof(header.boundsMin));
+		std::memcpy(header.boundsMax, &boundsMax, sizeof(header.boundsMax));
+		WriteMeshFile(argv[2], header, {{
+			{vertices.data(), vertices.size() * sizeof(PackedVertex)},
+			{mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t)},
+			{meshlets.meshlets.data(), meshlets.meshlets.size() * sizeof(MeshletDesc)},
+			{meshlets.vertices.data(), meshlets.vertices.size() * sizeof(uint32_t)},
+			{meshlets.triangles.data(), meshlets.triangles.size()}}});
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << argv[2] << ": " << header.vertexCount << " vertices, " << header.indexCount / 3 << " triangles, "
+				  << header.meshletCount << " meshlets, ACMR " << missesBefore << " -> " << missesAfter << ", " << ms << " ms" << std::endl;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
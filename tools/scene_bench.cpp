@@ -0,0 +1,190 @@
+//Microbenchmark of src/scene.h: a three level hierarchy of objects is animated, its transforms
+//updated and frustum culled against an orbiting camera every iteration, once per culling kernel.
+//--moving sets the percentage of roots spinning, only their subtrees are updated.
+//Every kernel has to produce the same visible list; the run fails when the best kernel's
+//update + cull average exceeds the budget.
+//usage: SceneBench [--objects N] [--iterations N] [--threads N] [--moving PERCENT] [--budget-ms X]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "scene.h"
+#include "thread_pool.h"
+
+namespace
+{
+	struct BenchOptions
+	{
+		uint32_t	objects		= 1'000'000;
+		uint32_t	iterations	= 100;
+		//0 = update and cull on the calling thread only
+		uint32_t	threads		= static_cast<uint32_t>(ThreadPool::DefaultThreadCount());
+		//percentage of roots animated each iteration
+		double		moving		= 100.0;
+		double		budgetMs	= 4.0;
+	};
+
+	struct Timing
+	{
+		double	totalMs	= 0.0;
+		double	maxMs	= 0.0;
+		void Add(double ms)
+		{
+			totalMs	+= ms;
+			maxMs	= std::max(maxMs, ms);
+		}
+	};
+
+	BenchOptions ParseArgs(int argc, char** argv)
+	{
+		BenchOptions options;
+		for(int i = 1; i < argc; i++)
+		{
+			std::string_view arg = argv[i];
+			if(i + 1 >= argc)
+				throw std::runtime_error("missing value for " + std::string(arg));
+			std::string value = argv[++i];
+			if(arg == "--objects")
+				options.objects = static_cast<uint32_t>(std::stoul(value));
+			else if(arg == "--iterations")
+				options.iterations = static_cast<uint32_t>(std::stoul(value));
+			else if(arg == "--threads")
+				options.threads = static_cast<uint32_t>(std::stoul(value));
+			else if(arg == "--moving")
+				options.moving = std::clamp(std::stod(value), 0.0, 100.0);
+			else if(arg == "--budget-ms")
+				options.budgetMs = std::stod(value);
+			else
+				throw std::runtime_error("unknown option: " + std::string(arg));
+		}
+		if(options.objects == 0 || options.iterations == 0)
+			throw std::runtime_error("--objects and --iterations must be greater than zero");
+		return options;
+	}
+
+	//1% roots spread over a 1000 unit cube, 9% groups around them, the rest objects around the groups
+	std::vector<Scene::Node> BuildScene(Scene& scene, uint32_t objects)
+	{
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		auto offset = [&](float extent){ return glm::translate(glm::mat4(1.0f), glm::vec3(unit(random), unit(random), unit(random)) * extent); };
+		uint32_t rootCount	= std::max(objects / 100, 1u);
+		uint32_t groupCount	= std::min(objects - rootCount, rootCount * 9);
+		scene.Reserve(objects);
+		std::vector<Scene::Node> roots;
+		for(uint32_t i = 0; i < rootCount; i++)
+			roots.push_back(scene.Add(offset(500.0f), 2.0f, 0));
+		std::vector<Scene::Node> groups;
+		for(uint32_t i = 0; i < groupCount; i++)
+			groups.push_back(scene.Add(offset(20.0f), 0.0f, Scene::NO_RENDER, glm::vec4(1.0f), roots[i % rootCount]));
+		for(uint32_t i = rootCount + groupCount; i < objects; i++)
+		{
+			Scene::Node parent = groups.empty() ? roots[i % rootCount] : groups[i % groupCount];
+			scene.Add(offset(5.0f) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f + 0.5f * std::abs(unit(random)))), 1.0f, 1, glm::vec4(1.0f), parent);
+		}
+		return roots;
+	}
+
+	glm::mat4 Camera(float angle)
+	{
+		glm::vec3 eye(700.0f * std::sin(angle), 150.0f, 700.0f * std::cos(angle));
+		return glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1500.0f) * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	double Milliseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		BenchOptions options = ParseArgs(argc, argv);
+		Scene scene;
+		std::vector<Scene::Node> roots = BuildScene(scene, options.objects);
+		size_t movingRoots = static_cast<size_t>(std::ceil(roots.size() * options.moving / 100.0));
+		std::unique_ptr<ThreadPool> pool = options.threads > 0 ? std::make_unique<ThreadPool>(options.threads) : nullptr;
+		scene.UpdateTransforms(pool.get());
+		std::cout << "scene: " << scene.Size() << " nodes in " << scene.LevelCount() << " levels, " << options.threads << " worker threads, "
+				  << options.iterations << " iterations, " << movingRoots << " of " << roots.size() << " roots moving, best kernel " << ToString(Scene::BestKernel()) << std::endl;
+
+		std::vector<CullKernel> kernels{CullKernel::Scalar};
+		if(Scene::BestKernel() != CullKernel::Scalar)
+			kernels.push_back(CullKernel::Sse);
+		if(Scene::BestKernel() == CullKernel::Avx2)
+			kernels.push_back(CullKernel::Avx2);
+		std::vector<Timing> updates(kernels.size());
+		std::vector<Timing> culls(kernels.size());
+		std::vector<std::vector<Scene::Node>> visible(kernels.size());
+		size_t visibleTotal = 0;
+		for(uint32_t iteration = 0; iteration < options.iterations; iteration++)
+		{
+			float angle = 0.01f * static_cast<float>(iteration);
+			glm::mat4 viewProjection = Camera(angle);
+			for(size_t k = 0; k < kernels.size(); k++)
+			{
+				//a spinning root changes every world transform below it
+				glm::mat4 spin = glm::rotate(glm::mat4(1.0f), angle + static_cast<float>(k), glm::vec3(0.0f, 1.0f, 0.0f));
+				for(size_t i = 0; i < movingRoots; i++)
+					scene.SetLocal(roots[i], glm::mat4(glm::vec4(spin[0]), glm::vec4(spin[1]), glm::vec4(spin[2]), glm::vec4(glm::vec3(scene.World(roots[i])[3]), 1.0f)));
+				auto start = std::chrono::steady_clock::now();
+				scene.UpdateTransforms(pool.get());
+				auto updated = std::chrono::steady_clock::now();
+				scene.Cull(viewProjection, visible[k], pool.get(), kernels[k]);
+				auto culled = std::chrono::steady_clock::now();
+				updates[k].Add(Milliseconds(updated - start));
+				culls[k].Add(Milliseconds(culled - updated));
+			}
+			//the same spin for every kernel once more, then the lists have to match
+			for(size_t i = 0; i < movingRoots; i++)
+				scene.SetLocal(roots[i], glm::mat4(glm::vec4(1.0f, 0.0f, 0.0f, 0.0f), glm::vec4(0.0f, 1.0f, 0.0f, 0.0f), glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+											   glm::vec4(glm::vec3(scene.World(roots[i])[3]), 1.0f)));
+			scene.UpdateTransforms(pool.get());
+			for(size_t k = 0; k < kernels.size(); k++)
+				scene.Cull(viewProjection, visible[k], pool.get(), kernels[k]);
+			for(size_t k = 1; k < kernels.size(); k++)
+			{
+				if(visible[k] != visible[0])
+				{
+					std::cerr << "kernel " << ToString(kernels[k]) << " disagrees with scalar: " << visible[k].size() << " vs " << visible[0].size() << " visible" << std::endl;
+					return 2;
+				}
+			}
+			visibleTotal += visible[0].size();
+		}
+
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "visible: " << visibleTotal / options.iterations << " of " << scene.Size() << " on average" << std::endl;
+		for(size_t k = 0; k < kernels.size(); k++)
+		{
+			std::cout << std::left << std::setw(8) << ToString(kernels[k]) << std::right
+					  << " update avg " << updates[k].totalMs / options.iterations << " ms, max " << updates[k].maxMs
+					  << " ms | cull avg " << culls[k].totalMs / options.iterations << " ms, max " << culls[k].maxMs << " ms" << std::endl;
+		}
+		double bestMs = (updates.back().totalMs + culls.back().totalMs) / options.iterations;
+		bool withinBudget = options.budgetMs <= 0.0 || bestMs <= options.budgetMs;
+		std::cout << "update + cull with " << ToString(kernels.back()) << ": " << bestMs << " ms per frame, budget " << options.budgetMs
+				  << " ms: " << (withinBudget ? "ok" : "over budget") << std::endl;
+		return withinBudget ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}